@@ -0,0 +1,70 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <vulkan_renderer.hpp>
+
+namespace GameEngine {
+
+// Startup options for --benchmark, filled in from the command line
+struct BenchmarkSettings {
+  bool enabled = false;
+  // Frames drawn before measuring starts, lets clocks and caches settle
+  uint32_t warmupFrames = 100;
+  uint32_t measuredFrames = 1000;
+  // Results are written to <outputPath>.json and <outputPath>.csv
+  std::string outputPath = "benchmark";
+};
+
+// All times in milliseconds
+struct BenchmarkFrame {
+  double cpuMs;
+  VulkanStuff::FrameStats stats;
+};
+
+struct MetricSummary {
+  size_t count = 0;
+  double mean = 0;
+  double p50 = 0;
+  double p95 = 0;
+  double p99 = 0;
+  double max = 0;
+};
+
+class Benchmark {
+public:
+  BenchmarkSettings settings;
+
+  uint32_t framesDrawn = 0;
+  // Measured frames that drew nothing, left out of the results
+  uint32_t skippedFrames = 0;
+  std::vector<BenchmarkFrame> frames;
+
+  Benchmark(BenchmarkSettings inputSettings);
+
+  uint32_t totalFrames();
+  bool isFinished();
+
+  // Scene state is a function of the frame number only, never of wall time,
+  // so every run renders exactly the same frames
+  float rotationForFrame(uint32_t frame);
+
+  // Skipped frames don't count towards warmupFrames or measuredFrames
+  void addFrame(double cpuMs, const VulkanStuff::FrameStats &stats);
+
+  static MetricSummary summarize(std::vector<double> samples);
+
+  // "warm" if the pipeline cache was loaded from disk, else "cold"
+  static const char *
+  pipelineCacheState(const VulkanStuff::VulkanRenderer &renderer);
+
+  // "dynamic_rendering" or "render_pass"
+  static const char *renderPath(const VulkanStuff::VulkanRenderer &renderer);
+
+  void report(const VulkanStuff::VulkanRenderer &renderer);
+  void writeJson(const VulkanStuff::VulkanRenderer &renderer,
+                 const std::vector<std::string> &names,
+                 const std::vector<MetricSummary> &summaries);
+  void writeCsv();
+};
+} // namespace GameEngine
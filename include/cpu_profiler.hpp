@@ -0,0 +1,121 @@
+#pragma once
+
+// Scoped CPU zones with Chrome trace / Perfetto export
+//
+//   void foo() {
+//     PROFILE_FUNCTION();
+//     { PROFILE_ZONE("inner work"); ... }
+//   }
+//
+// Every thread records into its own ring buffer, the only shared state is
+// touched once per thread on its first zone. Define DISABLE_CPU_PROFILER to
+// compile every zone out.
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#if defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#define PROFILE_USE_TSC 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define PROFILE_USE_TSC 1
+#else
+#define PROFILE_USE_TSC 0
+#endif
+
+#ifndef DISABLE_CPU_PROFILER
+#define ENABLE_CPU_PROFILER 1
+#else
+#define ENABLE_CPU_PROFILER 0
+#endif
+
+namespace Utils {
+
+// Times are raw profileNowTicks() values, converted to ns on export
+struct ProfileEvent {
+  // Must outlive the profiler, string literals and __func__ are expected
+  const char *name;
+  uint64_t startTicks;
+  uint64_t endTicks;
+};
+
+// Single producer ring, only the owning thread writes. Readers see every
+// event published before the writeIndex they load
+struct ProfileThreadBuffer {
+  static constexpr uint32_t CAPACITY = 1 << 16;
+
+  ProfileEvent events[CAPACITY];
+  std::atomic<uint64_t> writeIndex{0};
+  uint32_t threadIndex = 0;
+  std::string threadName;
+};
+
+// Reading steady_clock twice alone blows the per zone budget on some
+// systems, so x86 zones read the (invariant) TSC and writeChromeTrace
+// calibrates it against steady_clock
+inline uint64_t profileNowTicks() {
+#if PROFILE_USE_TSC
+  return __rdtsc();
+#else
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+#endif
+}
+
+// Registers the calling thread the first time it is called on that thread
+ProfileThreadBuffer *registerProfileThread();
+
+inline ProfileThreadBuffer *getProfileThreadBuffer() {
+  static thread_local ProfileThreadBuffer *buffer = registerProfileThread();
+  return buffer;
+}
+
+inline void recordProfileEvent(const char *name, uint64_t startTicks,
+                               uint64_t endTicks) {
+  ProfileThreadBuffer *buffer = getProfileThreadBuffer();
+  uint64_t index = buffer->writeIndex.load(std::memory_order_relaxed);
+  buffer->events[index & (ProfileThreadBuffer::CAPACITY - 1)] = {
+      name, startTicks, endTicks};
+  buffer->writeIndex.store(index + 1, std::memory_order_release);
+}
+
+// Shown as the thread's name in the trace viewer
+void setProfileThreadName(const std::string &name);
+
+// Writes every recorded zone still in the ring buffers as Chrome trace JSON,
+// open it in chrome://tracing or ui.perfetto.dev. The rings are read without
+// locking, so only the calling thread may still record zones. Call it once
+// every other thread that recorded was joined, e.g. after the job system
+// is destroyed
+void writeChromeTrace(const std::string &filePath);
+
+class ProfileZone {
+public:
+  const char *name;
+  uint64_t startTicks;
+
+  explicit ProfileZone(const char *zoneName)
+      : name{zoneName}, startTicks{profileNowTicks()} {}
+  ~ProfileZone() { recordProfileEvent(name, startTicks, profileNowTicks()); }
+
+  ProfileZone(const ProfileZone &) = delete;
+  void operator=(const ProfileZone &) = delete;
+};
+} // namespace Utils
+
+#if ENABLE_CPU_PROFILER
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_ZONE(name)                                                     \
+  Utils::ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define PROFILE_FUNCTION() PROFILE_ZONE(__func__)
+#else
+#define PROFILE_ZONE(name) ((void)0)
+#define PROFILE_FUNCTION() ((void)0)
+#endif
@@ -1,24 +1,53 @@
 #pragma once
 
 #include <SDL2/SDL.h>
+#include <benchmark.hpp>
+#include <input_events.hpp>
+#include <job_system.hpp>
 #include <iostream>
 #include <string>
 #include <utils.hpp>
 #include <vulkan_renderer.hpp>
 
 namespace GameEngine {
+
+// Startup options for the game loop, filled in from the command line
+struct GameSettings {
+  VulkanStuff::RendererSettings renderer;
+  // Stop after this many frames, 0 runs until the window is closed
+  uint32_t frameCount = 0;
+  // Headless only, the last frame is written here as a PPM on exit
+  std::string screenshotPath;
+  BenchmarkSettings benchmark;
+  // Job system threads including the main thread, 0 uses every core
+  uint32_t jobThreads = 0;
+};
+
 class Game {
 public:
   bool isRunning;
+  bool headless;
+  uint32_t frameCount;
+  std::string screenshotPath;
 
   SDL_Window *window;
+  // Created first, on the main thread, everything else may use it
+  Utils::JobSystem *jobSystem;
   VulkanStuff::VulkanRenderer *vulkanRenderer;
+  // Only set when running with --benchmark
+  Benchmark *benchmark;
+
+  InputEventQueue inputEvents;
+  // Rotation from this frame's key presses, applied once after dispatch
+  float pendingRotation = 0;
 
-  Game();
+  Game(GameSettings settings);
   ~Game();
 
   void run();
 
-  std::string getEvent();
+  // Polls SDL and runs the input subscribers
+  void processInput();
+  void onKeyDown(const InputEvent &event);
 };
 } // namespace GameEngine
\ No newline at end of file
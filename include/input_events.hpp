@@ -0,0 +1,74 @@
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace GameEngine {
+
+enum class InputEventType : uint8_t {
+  Quit,
+  KeyDown,
+  KeyUp,
+  MouseButtonDown,
+  MouseButtonUp,
+  WindowResized,
+  Count
+};
+
+// Plain data so the queue can be a fixed array, which payload fields are
+// meaningful depends on type
+struct InputEvent {
+  InputEventType type;
+  // steady_clock time when the event was polled, not when SDL queued it
+  uint64_t timestampNs;
+  // KeyDown / KeyUp
+  SDL_Keycode key;
+  uint16_t modifiers;
+  bool repeat;
+  // MouseButtonDown / MouseButtonUp
+  uint8_t mouseButton;
+  // Mouse position, or the new window size for WindowResized
+  int32_t x;
+  int32_t y;
+};
+
+constexpr uint32_t inputEventBit(InputEventType type) {
+  return 1u << static_cast<uint32_t>(type);
+}
+
+// Holds every event polled this frame. Subscribers are registered once at
+// startup, so polling and dispatching don't allocate
+class InputEventQueue {
+public:
+  static constexpr uint32_t CAPACITY = 256;
+
+  using Callback = std::function<void(const InputEvent &)>;
+
+  struct Subscriber {
+    // inputEventBit() of every type this subscriber wants
+    uint32_t typeMask;
+    Callback callback;
+  };
+
+  InputEvent events[CAPACITY];
+  uint32_t eventCount = 0;
+  // Events that didn't fit this frame, the newest ones are the ones lost
+  uint64_t droppedEvents = 0;
+
+  std::vector<Subscriber> subscribers;
+
+  void subscribe(uint32_t typeMask, Callback callback);
+
+  // Drops last frame's events and drains SDL's queue
+  void poll();
+  void push(const InputEvent &event);
+  // Calls the subscribers of every queued event, in the order polled
+  void dispatch() const;
+
+  const InputEvent *begin() const { return events; }
+  const InputEvent *end() const { return events + eventCount; }
+};
+} // namespace GameEngine
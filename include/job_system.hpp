@@ -0,0 +1,153 @@
+#pragma once
+
+// Work-stealing job scheduler
+//
+//   Utils::JobCounter counter;
+//   jobs.run(counter, [&] { decodeTexture(a); });
+//   jobs.run(counter, [&] { decodeTexture(b); });
+//   jobs.wait(counter);
+//
+//   jobs.parallelFor(objectCount, 64, [&](uint32_t begin, uint32_t end) {...});
+//
+// Every thread has its own deque. Owners push and pop at the back, idle
+// threads steal from the front of someone else's. A thread that waits on a
+// counter runs jobs until the counter hits zero, so jobs may wait on other
+// jobs. Thread 0 is the thread that created the JobSystem, the only one that
+// runs main thread jobs (SDL calls and anything else that must stay there).
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Utils {
+
+// Number of unfinished jobs started with it, done once it reads zero
+struct JobCounter {
+  std::atomic<uint32_t> pending{0};
+  // First exception one of its jobs threw, rethrown by wait() on this
+  // counter. Later ones are only logged
+  std::mutex errorMutex;
+  std::exception_ptr error;
+
+  bool isDone() const { return pending.load(std::memory_order_acquire) == 0; }
+};
+
+// Plain data so queuing a job never allocates
+struct Job {
+  void (*function)(void *data, uint32_t begin, uint32_t end);
+  void *data;
+  uint32_t begin;
+  uint32_t end;
+  JobCounter *counter;
+};
+
+struct JobQueue {
+  std::mutex mutex;
+  std::deque<Job> jobs;
+};
+
+class JobSystem {
+public:
+  // Queue per thread, index 0 is the main thread
+  std::vector<JobQueue *> queues;
+  std::vector<std::thread> threads;
+  // Jobs only the main thread may run
+  JobQueue mainThreadQueue;
+
+  // Lets idle workers sleep instead of spinning
+  std::mutex sleepMutex;
+  std::condition_variable wakeUp;
+  std::atomic<uint32_t> queuedJobs{0};
+  std::atomic<uint32_t> sleepingWorkers{0};
+  std::atomic<bool> stopping{false};
+
+  // Creates threadCount - 1 workers, the calling thread is the first thread
+  explicit JobSystem(uint32_t threadCount);
+  ~JobSystem();
+
+  JobSystem(const JobSystem &) = delete;
+  void operator=(const JobSystem &) = delete;
+
+  uint32_t threadCount() const {
+    return static_cast<uint32_t>(queues.size());
+  }
+  // Index of the calling thread, or threadCount() for outside threads
+  uint32_t currentThreadIndex() const;
+
+  // Raw job, counter may be null
+  void submit(const Job &job);
+  void submitToMainThread(const Job &job);
+
+  // Runs function on any thread. The callable is copied to the heap, so it
+  // can outlive the caller's stack frame
+  template <typename Function>
+  void run(JobCounter &counter, Function function) {
+    submit(makeHeapJob(counter, std::move(function)));
+  }
+  template <typename Function>
+  void runOnMainThread(JobCounter &counter, Function function) {
+    submitToMainThread(makeHeapJob(counter, std::move(function)));
+  }
+
+  // Splits [0, count) into ranges of at most grainSize and calls
+  // function(begin, end) on each, returns once all of them finished
+  template <typename Function>
+  void parallelFor(uint32_t count, uint32_t grainSize,
+                   const Function &function) {
+    if (count == 0) {
+      return;
+    }
+    grainSize = grainSize == 0 ? 1 : grainSize;
+    JobCounter counter;
+    Job job{};
+    job.function = [](void *data, uint32_t begin, uint32_t end) {
+      (*static_cast<const Function *>(data))(begin, end);
+    };
+    job.data = const_cast<Function *>(&function);
+    job.counter = &counter;
+    for (uint32_t begin = 0; begin < count; begin += grainSize) {
+      job.begin = begin;
+      job.end = count - begin < grainSize ? count : begin + grainSize;
+      submit(job);
+    }
+    wait(counter);
+  }
+
+  // Runs other jobs until the counter is done, then rethrows the first
+  // exception one of the counter's jobs threw. Exceptions of other
+  // counters' jobs stay with their counter
+  void wait(JobCounter &counter);
+
+  // Called by the main loop once per frame
+  void runMainThreadJobs();
+
+private:
+  template <typename Function>
+  static Job makeHeapJob(JobCounter &counter, Function function) {
+    Job job{};
+    job.function = [](void *data, uint32_t, uint32_t) {
+      std::unique_ptr<Function> heapFunction(static_cast<Function *>(data));
+      (*heapFunction)();
+    };
+    job.data = new Function(std::move(function));
+    job.counter = &counter;
+    return job;
+  }
+
+  void execute(const Job &job);
+  bool popJob(JobQueue &queue, Job &job, bool fromBack);
+  // Own queue first, then the main thread queue if allowed, then steals
+  bool findJob(uint32_t threadIndex, Job &job);
+  void workerLoop(uint32_t threadIndex);
+};
+
+// Task overhead and scaling from 1 thread to every core, for --job-benchmark
+void runJobBenchmark(uint32_t maxThreads);
+} // namespace Utils
@@ -0,0 +1,26 @@
+#pragma once
+#include <vulkan_dispatch.hpp>
+
+#include <string>
+#include <vector>
+
+namespace Utils {
+
+// A KTX2 texture as stored in the file, ready to be copied into an image of
+// its format without any conversion
+struct Ktx2Texture {
+  VkFormat format;
+  uint32_t width;
+  uint32_t height;
+  uint32_t mipLevels;
+  // Every level tightly packed, level 0 first
+  std::vector<uint8_t> data;
+  std::vector<VkDeviceSize> levelOffsets;
+};
+
+bool isKtx2Path(const std::string &path);
+
+// Only 2D textures without supercompression in one of the formats
+// getTextureBlockInfo knows. Throws if the file is anything else
+Ktx2Texture loadKtx2(const std::string &path);
+} // namespace Utils
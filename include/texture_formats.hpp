@@ -0,0 +1,34 @@
+#pragma once
+#include <vulkan_dispatch.hpp>
+
+#include <cstdint>
+
+// Texel block layouts of the texture formats the streamer loads, and CPU
+// decoders for the block compressed ones so a texture can still be shown
+// on devices that can't sample its format
+namespace Utils {
+
+struct TextureBlockInfo {
+  // Texels per block, 1x1 for uncompressed formats
+  uint32_t width;
+  uint32_t height;
+  uint32_t bytes;
+  bool compressed;
+};
+
+// False for formats the streamer doesn't know
+bool getTextureBlockInfo(VkFormat format, TextureBlockInfo &info);
+bool isSrgbFormat(VkFormat format);
+
+// Tightly packed byte size of one width x height level, partial blocks at
+// the edges count as whole ones
+VkDeviceSize textureLevelSize(VkFormat format, uint32_t width,
+                              uint32_t height);
+
+// BC1, BC7 and ETC2 (RGB, punchthrough alpha and EAC alpha)
+bool canDecodeToRGBA8(VkFormat format);
+// Decodes one level into tightly packed RGBA8, the values stay in the
+// source's color space
+void decodeToRGBA8(VkFormat format, const uint8_t *blocks, uint32_t width,
+                   uint32_t height, uint8_t *dst);
+} // namespace Utils
@@ -3,12 +3,13 @@
 
 // Main utils lib, can't include any game/application specific headers here
 #include <SDL2/SDL.h>
+#include <cpu_profiler.hpp>
 #include <fstream>
 #include <glm/glm.hpp>
 #include <iostream>
 #include <optional>
 #include <vector>
-#include <vulkan/vulkan.h>
+#include <vulkan_dispatch.hpp>
 
 struct VkSharedPoolInfoAMD {
   VkStructureType sType;
@@ -41,6 +42,12 @@ struct SwapChainSupportDetails {
 struct QueueFamilyIndices {
   std::optional<uint32_t> graphicsFamily;
   std::optional<uint32_t> presentFamily;
+  // Family with transfer but neither graphics nor compute, usually the DMA
+  // engines. Empty when the device has none
+  std::optional<uint32_t> transferFamily;
+  // Family with compute but not graphics, async compute. Empty when the
+  // device has none
+  std::optional<uint32_t> computeFamily;
 };
 
 SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device,
@@ -51,12 +58,37 @@ QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device,
 
 // Image functions
 VkImageView createImageView(VkDevice device, VkImage image, VkFormat format,
-                            VkImageAspectFlags aspectFlags);
+                            VkImageAspectFlags aspectFlags,
+                            uint32_t mipLevels = 1);
+
+// Levels of a full mip chain down to 1x1
+uint32_t mipLevelCount(uint32_t width, uint32_t height);
+// Byte size of all levels of an RGBA8 mip chain, tightly packed one after
+// another starting with level 0
+VkDeviceSize mipChainSize(uint32_t width, uint32_t height,
+                          uint32_t mipLevels);
+// 2x2 box filter from one RGBA8 level to the next, odd edges repeat their
+// last texel. SSE2 when available
+void downsampleRGBA8(const uint8_t *src, uint32_t srcWidth, uint32_t srcHeight,
+                     uint8_t *dst);
+// Fills levels 1 to mipLevels - 1 of a packed chain whose level 0 is set
+void generateMipChainRGBA8(uint8_t *pixels, uint32_t width, uint32_t height,
+                           uint32_t mipLevels);
 
 std::vector<char> readFile(std::string filePath);
 
+// Writes tightly packed 8 bit BGRA pixels as a binary PPM
+void writePPM(std::string filePath, const uint8_t *bgraPixels, uint32_t width,
+              uint32_t height);
+
 void showWindowFlags(int flags);
 
+// "immediate", "mailbox", "fifo" or "fifo_relaxed", as used on the command
+// line and in benchmark results
+const char *presentModeName(VkPresentModeKHR presentMode);
+// False if name is none of the above
+bool parsePresentMode(const std::string &name, VkPresentModeKHR &presentMode);
+
 //===========================
 // Input Structs
 
@@ -104,6 +136,18 @@ struct UniformBufferObject {
   glm::mat4 proj;
 };
 
+// Fragment stage push constants of every draw
+struct DrawPushConstants {
+  // Slot in the VulkanTextureTable
+  uint32_t textureIndex;
+};
+
+// Compute stage push constants of draw_args.comp
+struct DrawArgsConstants {
+  uint32_t firstDraw;
+  uint32_t drawCount;
+};
+
 struct Query {
   uint64_t value{};
   uint64_t availability{};
@@ -116,18 +160,6 @@ VkCommandBuffer beginSingleTimeCommands(VkDevice device,
 void endSingleTimeCommands(VkDevice device, VkCommandPool commandPool,
                            VkCommandBuffer commandBuffer, VkQueue submitQueue);
 
-// Buffer functions
-uint32_t findMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeFilter,
-                        VkMemoryPropertyFlags properties);
-
-void createBuffer(VkPhysicalDevice physicalDevice, VkDevice device,
-                  VkDeviceSize size, VkBufferUsageFlags usage,
-                  VkMemoryPropertyFlags properties, VkBuffer &buffer,
-                  VkDeviceMemory &bufferMemory);
-
-void copyBuffer(VkDevice device, VkCommandPool commandPool, VkQueue submitQueue,
-                VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
-
 std::vector<VkFramebuffer>
 createFramebuffers(VkDevice device,
                    std::vector<VkImageView> swapChainImageViews,
@@ -135,6 +167,9 @@ createFramebuffers(VkDevice device,
                    VkExtent2D swapChainExtent, VkImageView colorImageView);
 bool hasStencilComponent(VkFormat format);
 
+// The depth format every depth attachment, render pass and pipeline uses
+VkFormat findDepthFormat(VkPhysicalDevice physicalDevice);
+
 VkFormat findSupportedFormat(VkPhysicalDevice physicalDevice,
                              const std::vector<VkFormat> &candidates,
                              VkImageTiling tiling,
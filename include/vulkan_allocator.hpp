@@ -0,0 +1,131 @@
+#pragma once
+#include <vulkan_dispatch.hpp>
+
+#include <cstdint>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
+#include <utils.hpp>
+
+namespace VulkanStuff {
+
+struct VulkanMemoryBlock;
+
+// Where a resource's memory lives. Plain value, hand it back to
+// VulkanAllocator::free (or destroyBuffer / destroyImage) when done
+struct VulkanAllocation {
+  VkDeviceMemory memory = VK_NULL_HANDLE;
+  VkDeviceSize offset = 0;
+  VkDeviceSize size = 0;
+  // Host visible memory stays mapped, null otherwise
+  void *mapped = nullptr;
+  // Null for dedicated allocations
+  VulkanMemoryBlock *block = nullptr;
+  uint32_t order = 0;
+};
+
+// Binary buddy allocator over one VkDeviceMemory. Every allocation is a power
+// of two sized node at an offset that is a multiple of its size, so any power
+// of two alignment up to the node size comes for free
+struct VulkanMemoryBlock {
+  VkDeviceMemory memory;
+  VkDeviceSize size;
+  void *mapped;
+  // Index into VulkanAllocator::pools
+  uint32_t pool;
+  uint32_t maxOrder;
+  // Offsets of free nodes, indexed by order (node size MIN_NODE_SIZE << order)
+  std::vector<std::unordered_set<VkDeviceSize>> freeNodes;
+  VkDeviceSize freeBytes;
+  uint32_t allocationCount = 0;
+
+  // Returns false if no free node is big enough
+  bool allocate(uint32_t order, VkDeviceSize &offset);
+  void free(VkDeviceSize offset, uint32_t order);
+  VkDeviceSize largestFreeNode() const;
+};
+
+// Device memory sub-allocator. Resources are placed in large blocks per
+// memory type instead of getting a VkDeviceMemory each, big render targets
+// and anything the driver asks for get dedicated allocations
+class VulkanAllocator {
+public:
+  // From VulkanDevice ========
+  VkPhysicalDevice physicalDevice;
+  VkDevice device;
+  //===========================
+
+  static constexpr VkDeviceSize MIN_NODE_SIZE = 256;
+  static constexpr VkDeviceSize MAX_BLOCK_SIZE = 64ull << 20;
+
+  VkPhysicalDeviceMemoryProperties memoryProperties;
+  VkDeviceSize bufferImageGranularity;
+  // When bufferImageGranularity is bigger than MIN_NODE_SIZE, linear and
+  // optimal resources go to separate blocks so they can never share a page
+  bool separateOptimalBlocks;
+
+  // Blocks of one memory type and resource kind
+  struct MemoryPool {
+    uint32_t memoryType;
+    VkDeviceSize blockSize;
+    std::vector<VulkanMemoryBlock *> blocks;
+  };
+  // Indexed by memoryType * 2 + (optimal image ? 1 : 0)
+  std::vector<MemoryPool> pools;
+
+  // Allocations can come from any thread
+  std::mutex mutex;
+
+  // Statistics
+  uint64_t allocationCount = 0;
+  uint64_t dedicatedCount = 0;
+  VkDeviceSize allocatedBytes = 0;
+  VkDeviceSize dedicatedBytes = 0;
+
+  VulkanAllocator(VkPhysicalDevice inputPhysicalDevice, VkDevice inputDevice);
+  ~VulkanAllocator();
+
+  VulkanAllocator(const VulkanAllocator &) = delete;
+  void operator=(const VulkanAllocator &) = delete;
+
+  uint32_t findMemoryType(uint32_t typeBits, VkMemoryPropertyFlags properties);
+
+  // optimalImage picks the block kind, dedicated skips the blocks entirely.
+  // dedicatedBuffer / dedicatedImage are passed on as
+  // VkMemoryDedicatedAllocateInfo when the allocation ends up dedicated
+  VulkanAllocation allocate(const VkMemoryRequirements &requirements,
+                            VkMemoryPropertyFlags properties, bool optimalImage,
+                            bool dedicated,
+                            VkBuffer dedicatedBuffer = VK_NULL_HANDLE,
+                            VkImage dedicatedImage = VK_NULL_HANDLE);
+  void free(VulkanAllocation &allocation);
+
+  // Creates the resource, allocates and binds its memory. A buffer used by
+  // more than one of queueFamilies is shared concurrently between them
+  VulkanAllocation createBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
+                                VkMemoryPropertyFlags properties,
+                                VkBuffer &buffer,
+                                std::vector<uint32_t> queueFamilies = {});
+  VulkanAllocation createImage(const VkImageCreateInfo &imageInfo,
+                               VkMemoryPropertyFlags properties, VkImage &image,
+                               bool dedicated = false);
+  void destroyBuffer(VkBuffer &buffer, VulkanAllocation &allocation);
+  void destroyImage(VkImage &image, VulkanAllocation &allocation);
+
+  // Share of free block memory that is not in the largest free node of its
+  // block, 0 means all free memory is contiguous
+  double fragmentation();
+  void printStats();
+
+private:
+  VulkanAllocation allocateDedicated(const VkMemoryRequirements &requirements,
+                                     uint32_t memoryType, VkBuffer buffer,
+                                     VkImage image);
+  VulkanMemoryBlock *createBlock(MemoryPool &pool);
+  void destroyBlock(VulkanMemoryBlock *block);
+};
+
+// Random allocate / free stress run, for --alloc-benchmark
+void runAllocatorBenchmark(VulkanAllocator &allocator);
+} // namespace VulkanStuff
@@ -1,9 +1,11 @@
 #pragma once
-#include <vulkan/vulkan.h>
+#include <vulkan_dispatch.hpp>
 
 #include <vector>
 
 #include <utils.hpp>
+#include <vulkan_allocator.hpp>
+#include <vulkan_uploader.hpp>
 namespace VulkanStuff {
 class VulkanBuffer {
 public:
@@ -11,61 +13,30 @@ public:
   VkDevice device;
   VkPhysicalDevice physicalDevice;
   VkQueue graphicsQueue;
+  VulkanAllocator *allocator;
   //===========================
 
-  // From VulkanCommand =========
-  VkCommandPool commandPool;
+  // From VulkanRenderer =========
+  VulkanUploader *uploader;
   //============================
 
   // This is set first as VK_NULL_HANDLE, since we initially want to destroy
   // buffer, and VK_NULL_HANDLE is valid for vkDestroyBuffer when buffer in
   // unitialized
   VkBuffer vertexBuffer = VK_NULL_HANDLE;
-  VkDeviceMemory vertexBufferMemory = VK_NULL_HANDLE;
+  VulkanAllocation vertexBufferMemory{};
 
   VkBuffer indexBuffer = VK_NULL_HANDLE;
-  VkDeviceMemory indexBufferMemory = VK_NULL_HANDLE;
-
-  std::vector<VkBuffer> uniformBuffers;
-  std::vector<VkDeviceMemory> uniformBuffersMemory;
-
-  // Descriptor Stuff
-  VkDescriptorPool descriptorPool;
-  std::vector<VkDescriptorSet> descriptorSets;
-
-  // Stuff for second texture
-  VkBuffer secondUniformBuffers;
-  VkDeviceMemory secondUniformBuffersMemory;
-  VkDescriptorPool secondDescriptorPool;
-  VkDescriptorSet secondDescriptorSet;
-
-  // End of stuff for second texture
+  VulkanAllocation indexBufferMemory{};
 
   // Functions
 
   VulkanBuffer(VkPhysicalDevice inputPhysicalDevice, VkDevice inputDevice,
-               VkQueue inputGraphicsQueue, VkCommandPool inputCommandPool);
+               VkQueue inputGraphicsQueue, VulkanAllocator *inputAllocator,
+               VulkanUploader *inputUploader);
   ~VulkanBuffer();
 
   void createVertexBuffer(std::vector<Utils::Vertex> vertices);
   void createIndexBuffer(std::vector<uint16_t> indices);
-  void createUniformBuffers(int number);
-  void createDescriptorPool(int number);
-
-  // Static since generic and can be called regardless
-  static VkDescriptorSet
-  createDescriptorSet(VkDevice device,
-                      VkDescriptorSetLayout descriptorSetLayout,
-                      VkDescriptorPool pool);
-
-  static void writeDescritorSets(VkDevice device, VkDescriptorSet descritorSet,
-                                 VkBuffer uniformBuffer, VkImageView imageView,
-                                 VkSampler sampler);
-
-  void createDescriptorSets(int number,
-                            VkDescriptorSetLayout descriptorSetLayout,
-                            VkImageView textureImageView,
-                            VkSampler textureSampler,
-                            VkImageView secondTextureImageView);
 };
 } // namespace VulkanStuff
\ No newline at end of file
@@ -10,14 +10,36 @@ public:
   VkSurfaceKHR surface;
   // ==============================
 
+  // For one time commands (uploads, layout transitions, readback)
   VkCommandPool commandPool;
+  uint32_t graphicsFamily;
+
+  // Command pools of one frame slot. Every recording thread gets its own
+  // pool so threads never share one, and all of them are reset at once when
+  // the slot comes around again instead of buffer by buffer
+  struct FrameCommands {
+    VkCommandPool primaryPool;
+    std::vector<VkCommandPool> threadPools;
+    // One per recording thread, executed inside the render pass
+    std::vector<VkCommandBuffer> secondaryBuffers;
+  };
+
+  uint32_t threadCount;
+  std::vector<FrameCommands> frameCommands;
+  // Primary buffer of each frame slot
   std::vector<VkCommandBuffer> commandBuffers;
 
   VulkanCommand(VkPhysicalDevice inputPhysicalDevice, VkDevice inputDevice,
-                VkSurfaceKHR inputSurface, uint32_t number);
+                VkSurfaceKHR inputSurface, uint32_t number,
+                uint32_t inputThreadCount);
   ~VulkanCommand();
 
+  VkCommandPool createPool(VkCommandPoolCreateFlags flags);
   void createCommandPool();
   void createCommandBuffers(uint32_t number);
+  void freeCommandBuffers();
+
+  // Only once the slot's previous submission has finished
+  void resetFrame(uint32_t frameIndex);
 };
-} // namespace VulkanStuff
\ No newline at end of file
+} // namespace VulkanStuff
@@ -0,0 +1,87 @@
+#pragma once
+#include <vulkan_dispatch.hpp>
+
+#include <vector>
+
+#include <vulkan_syncobject.hpp>
+
+namespace VulkanStuff {
+
+// Schedules compute work on the compute queue so it overlaps the graphics
+// frame instead of running in line with it. Every submission signals the
+// compute timeline. The frame waits on it for the results it consumes, and
+// compute work that reads graphics results waits on the graphics timeline,
+// both as semaphore waits on the GPU, never on the CPU.
+//
+// Resources shared with the graphics queue need VK_SHARING_MODE_CONCURRENT
+// or explicit ownership transfers when the compute family is a different
+// one. Submits to the compute queue, so only use it from the render thread.
+class VulkanCompute {
+public:
+  // From VulkanDevice ========
+  VkDevice device;
+  VkQueue computeQueue;
+  uint32_t computeFamily;
+  //===========================
+
+  // From VulkanSyncObject =====
+  VulkanTimeline *computeTimeline;
+  VulkanTimeline *graphicsTimeline;
+  //===========================
+
+  struct FrameSlot {
+    // Reset as a whole once the slot comes around again
+    VkCommandPool commandPool;
+    std::vector<VkCommandBuffer> commandBuffers;
+    uint32_t usedCommandBuffers = 0;
+    // Compute timeline value of the slot's last submission
+    uint64_t lastValue = 0;
+  };
+  std::vector<FrameSlot> frameSlots;
+  uint32_t currentSlot = 0;
+
+  // What the current graphics frame has to wait for, 0 for nothing
+  uint64_t frameWaitValue = 0;
+  VkPipelineStageFlags2KHR frameWaitStages = 0;
+
+  // Statistics
+  uint64_t submissionCount = 0;
+
+  VulkanCompute(VkDevice inputDevice, VkQueue inputComputeQueue,
+                uint32_t inputComputeFamily,
+                VulkanTimeline *inputComputeTimeline,
+                VulkanTimeline *inputGraphicsTimeline, uint32_t slotCount);
+  ~VulkanCompute();
+
+  VulkanCompute(const VulkanCompute &) = delete;
+  void operator=(const VulkanCompute &) = delete;
+
+  // Starts a frame on slot frameIndex. Its command buffers are recycled,
+  // waiting only if its work from slotCount frames ago is still running
+  void beginFrame(uint32_t frameIndex);
+
+  // Records function(commandBuffer) and submits it right away. The work
+  // starts once the graphics timeline reaches waitGraphicsValue (0 for no
+  // wait) at waitStages. consumerStages are where the current frame reads
+  // the results, 0 if it doesn't. Returns the compute timeline value that
+  // signals completion, for later frames or other queues to wait on
+  template <typename Function>
+  uint64_t submit(const Function &function,
+                  VkPipelineStageFlags2KHR consumerStages,
+                  uint64_t waitGraphicsValue = 0,
+                  VkPipelineStageFlags2KHR waitStages =
+                      VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR) {
+    VkCommandBuffer commandBuffer = beginCommandBuffer();
+    function(commandBuffer);
+    return submitCommandBuffer(commandBuffer, consumerStages,
+                               waitGraphicsValue, waitStages);
+  }
+
+private:
+  VkCommandBuffer beginCommandBuffer();
+  uint64_t submitCommandBuffer(VkCommandBuffer commandBuffer,
+                               VkPipelineStageFlags2KHR consumerStages,
+                               uint64_t waitGraphicsValue,
+                               VkPipelineStageFlags2KHR waitStages);
+};
+} // namespace VulkanStuff
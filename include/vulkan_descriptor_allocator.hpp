@@ -0,0 +1,114 @@
+#pragma once
+#include <vulkan_dispatch.hpp>
+
+#include <unordered_map>
+#include <vector>
+
+#include <utils.hpp>
+
+namespace VulkanStuff {
+
+// Describes how a descriptor set of one layout is written from a plain
+// struct, see VulkanDescriptorAllocator::createTemplate
+struct DescriptorTemplate {
+  VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+  VkDescriptorUpdateTemplate updateTemplate = VK_NULL_HANDLE;
+  // Bytes of the struct the template reads, all of them go into the hash
+  size_t dataSize = 0;
+};
+
+// Hands out descriptor sets from chains of pools that grow instead of
+// running out.
+//
+// Transient sets come from the frame slot's own chain and only live until
+// the slot comes around again: beginFrame resets every pool of the slot at
+// once, nothing is freed one set at a time. Persistent sets come from a
+// chain that is only reset by resetPersistent. getSet hands out persistent
+// sets cached by template and data, so a binding that comes back every
+// frame is allocated and written once.
+//
+// Sets are written with descriptor update templates straight from the
+// caller's struct, no VkWriteDescriptorSet arrays are built per write. Not
+// thread safe.
+class VulkanDescriptorAllocator {
+public:
+  // Descriptors of each type a pool holds per set it can allocate
+  struct PoolRatio {
+    VkDescriptorType type;
+    float perSet;
+  };
+
+  // A new pool holds twice the sets of the one before, up to this
+  static constexpr uint32_t MAX_SETS_PER_POOL = 4096;
+
+  // From VulkanDevice ========
+  VkDevice device;
+  //===========================
+
+  std::vector<PoolRatio> ratios;
+  // Sets the next pool created holds
+  uint32_t setsPerPool;
+
+  // Pools in use, the last one is allocated from first
+  struct PoolChain {
+    std::vector<VkDescriptorPool> pools;
+  };
+  PoolChain persistentPools;
+  // Template data hash to the persistent set written with it
+  std::unordered_map<uint64_t, VkDescriptorSet> setCache;
+
+  std::vector<PoolChain> frameSlots;
+  uint32_t currentFrame = 0;
+
+  // Reset pools, reused before new ones are created
+  std::vector<VkDescriptorPool> freePools;
+
+  std::vector<DescriptorTemplate> templates;
+
+  // Statistics
+  uint32_t poolCount = 0;
+  uint64_t setsAllocated = 0;
+  uint64_t cacheHits = 0;
+
+  VulkanDescriptorAllocator(VkDevice inputDevice, uint32_t frameSlotCount,
+                            std::vector<PoolRatio> inputRatios,
+                            uint32_t initialSetsPerPool);
+  ~VulkanDescriptorAllocator();
+
+  VulkanDescriptorAllocator(const VulkanDescriptorAllocator &) = delete;
+  void operator=(const VulkanDescriptorAllocator &) = delete;
+
+  // entries read from a struct of dataSize bytes. The template lives as long
+  // as the allocator
+  DescriptorTemplate
+  createTemplate(VkDescriptorSetLayout layout,
+                 const std::vector<VkDescriptorUpdateTemplateEntry> &entries,
+                 size_t dataSize);
+
+  // Resets the slot's pools, only once the slot's previous submission has
+  // finished
+  void beginFrame(uint32_t frameIndex);
+  // Resets the persistent pools and forgets the cached sets, only once the
+  // device is done with them. Needed when a resource they point to goes away
+  void resetPersistent();
+
+  // A set of layout that stays valid until the current slot's next
+  // beginFrame
+  VkDescriptorSet allocateTransient(VkDescriptorSetLayout layout);
+  // A set of layout that stays valid as long as the allocator
+  VkDescriptorSet allocatePersistent(VkDescriptorSetLayout layout);
+
+  // A persistent set written from data, shared with every other getSet call
+  // that passes the same template and bytes until resetPersistent. Padding
+  // in data is hashed too, so clear it
+  VkDescriptorSet getSet(const DescriptorTemplate &descriptorTemplate,
+                         const void *data);
+
+  void write(VkDescriptorSet descriptorSet,
+             const DescriptorTemplate &descriptorTemplate, const void *data);
+
+private:
+  VkDescriptorSet allocate(PoolChain &chain, VkDescriptorSetLayout layout);
+  VkDescriptorPool takePool();
+};
+} // namespace VulkanStuff
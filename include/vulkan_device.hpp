@@ -1,15 +1,18 @@
 
 #pragma once
 
-#include <vulkan/vulkan.h>
+#include <vulkan_dispatch.hpp>
 
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_vulkan.h>
+#include <algorithm>
 #include <iostream>
 #include <set>
 #include <string>
 #include <utils.hpp>
 #include <vector>
+#include <vulkan_allocator.hpp>
+#include <vulkan_pipeline_cache.hpp>
 // For loading function pointers on lnx
 // #include <dlfcn.h>
 
@@ -26,6 +29,8 @@ class VulkanDevice {
 
 public:
   SDL_Window *window;
+  // No window means no surface or swapchain, frames go to offscreen images
+  bool headless;
   VkInstance instance;
 
   const std::vector<const char *> validationLayers = {
@@ -47,29 +52,63 @@ public:
       VK_KHR_SWAPCHAIN_EXTENSION_NAME,
       VK_KHR_SWAPCHAIN_MUTABLE_FORMAT_EXTENSION_NAME,
       VK_KHR_SHADER_NON_SEMANTIC_INFO_EXTENSION_NAME,
-      VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME};
+      VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME,
+      VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME};
 
-  VkSurfaceKHR surface;
+  VkSurfaceKHR surface = VK_NULL_HANDLE;
+
+  // Highest sample count up to 8x that both color and depth support, software
+  // drivers like lavapipe stop at 4x
+  VkSampleCountFlagBits msaaSamples = VK_SAMPLE_COUNT_1_BIT;
+
+  // VK_KHR_present_id and VK_KHR_present_wait, optional. With them the
+  // renderer can tell when a present reached the screen
+  bool presentWaitSupported = false;
+
+  // VK_KHR_dynamic_rendering, only when asked for at creation and the
+  // device has it. Frames then begin rendering with their attachments
+  // directly, no render pass or framebuffer objects
+  bool dynamicRendering = false;
 
   // Queues
   VkQueue graphicsQueue;
   VkQueue presentQueue;
+  // Uploads go here. A queue of a transfer only family when the device has
+  // one, else a second graphics queue, else graphicsQueue itself
+  VkQueue transferQueue;
+  // Compute work that overlaps the frame, picked the same way from compute
+  // families without graphics
+  VkQueue computeQueue;
+  uint32_t graphicsFamily;
+  uint32_t transferFamily;
+  uint32_t computeFamily;
 
   // queryPool values;
   float deviceTimestampPeriod;
 
+  std::string deviceName;
+
   void *m_vkLoader{nullptr};
 
   PFN_vkCreateInstance pfn_vkCreateInstance{nullptr};
   PFN_vkQuerySharedPoolPropertiesAMD pfn_vkQuerySharedPoolPropertiesAMD{
       nullptr};
+  // Every device level function plus which optional extensions loaded,
+  // filled in createLogicalDevice
+  VulkanDeviceDispatch dispatch{};
+  // Every buffer and image gets its memory from here
+  VulkanAllocator *allocator = nullptr;
+  // Every pipeline is built through this, loaded from and saved to
+  // PIPELINE_CACHE_PATH in the working directory
+  static constexpr const char *PIPELINE_CACHE_PATH = "pipeline_cache.bin";
+  VulkanPipelineCache *pipelineCache = nullptr;
   // PFN_vkQuerySharedPoolProperties pfn_vkQuerySharedPoolProperties { nullptr
   // };
   //=========
   //  Functions
   //=========
 
-  VulkanDevice(SDL_Window *sdlWindow);
+  VulkanDevice(SDL_Window *sdlWindow, bool requestDynamicRendering);
   ~VulkanDevice();
 
   // deleting copy constructors
@@ -115,10 +154,14 @@ public:
   // Device functions
   //
   void pickPhysicalDevice();
+  VkSampleCountFlagBits getMaxUsableSampleCount();
   void createLogicalDevice();
 
   bool isDeviceSuitable(VkPhysicalDevice device);
   bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+  bool checkDeviceFeatureSupport(VkPhysicalDevice device);
+  bool checkPresentWaitSupport(VkPhysicalDevice device);
+  bool checkDynamicRenderingSupport(VkPhysicalDevice device);
 };
 
 } // namespace VulkanStuff
\ No newline at end of file
@@ -0,0 +1,195 @@
+#pragma once
+
+// Every Vulkan function the engine calls, as function pointers loaded at
+// runtime instead of the loader's exported trampolines. Device functions
+// come straight from vkGetDeviceProcAddr, so draw and submit calls skip the
+// loader's per call dispatch.
+//
+// Include this instead of <vulkan/vulkan.h>. Adding a call to a new Vulkan
+// function means adding it to one of the lists below.
+
+#ifndef VK_NO_PROTOTYPES
+#define VK_NO_PROTOTYPES
+#endif
+#include <vulkan/vulkan.h>
+
+// With VK_NO_PROTOTYPES the loader's only export we still link against
+extern "C" VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL
+vkGetInstanceProcAddr(VkInstance instance, const char *pName);
+
+// Loaded with a null instance
+#define VULKAN_GLOBAL_FUNCTIONS(X)                                             \
+  X(vkCreateInstance)                                                          \
+  X(vkEnumerateInstanceLayerProperties)
+
+#define VULKAN_INSTANCE_FUNCTIONS(X)                                           \
+  X(vkCreateDevice)                                                            \
+  X(vkDestroyInstance)                                                         \
+  X(vkEnumerateDeviceExtensionProperties)                                      \
+  X(vkEnumeratePhysicalDevices)                                                \
+  X(vkGetDeviceProcAddr)                                                       \
+  X(vkGetPhysicalDeviceFeatures)                                               \
+  X(vkGetPhysicalDeviceFeatures2)                                              \
+  X(vkGetPhysicalDeviceFormatProperties)                                       \
+  X(vkGetPhysicalDeviceMemoryProperties)                                       \
+  X(vkGetPhysicalDeviceProperties)                                             \
+  X(vkGetPhysicalDeviceProperties2)                                            \
+  X(vkGetPhysicalDeviceQueueFamilyProperties)
+
+// VK_KHR_surface, missing from headless instances
+#define VULKAN_SURFACE_FUNCTIONS(X)                                            \
+  X(vkDestroySurfaceKHR)                                                       \
+  X(vkGetPhysicalDeviceSurfaceCapabilitiesKHR)                                 \
+  X(vkGetPhysicalDeviceSurfaceFormatsKHR)                                      \
+  X(vkGetPhysicalDeviceSurfacePresentModesKHR)                                 \
+  X(vkGetPhysicalDeviceSurfaceSupportKHR)
+
+// Core device functions, the device is unusable without any of them
+#define VULKAN_DEVICE_FUNCTIONS(X)                                             \
+  X(vkAllocateCommandBuffers)                                                  \
+  X(vkAllocateDescriptorSets)                                                  \
+  X(vkAllocateMemory)                                                          \
+  X(vkBeginCommandBuffer)                                                      \
+  X(vkBindBufferMemory)                                                        \
+  X(vkBindImageMemory)                                                         \
+  X(vkCmdBeginRenderPass)                                                      \
+  X(vkCmdBindDescriptorSets)                                                   \
+  X(vkCmdBindIndexBuffer)                                                      \
+  X(vkCmdBindPipeline)                                                         \
+  X(vkCmdBindVertexBuffers)                                                    \
+  X(vkCmdBlitImage)                                                            \
+  X(vkCmdClearColorImage)                                                      \
+  X(vkCmdCopyBuffer)                                                           \
+  X(vkCmdCopyBufferToImage)                                                    \
+  X(vkCmdCopyImageToBuffer)                                                    \
+  X(vkCmdDispatch)                                                             \
+  X(vkCmdDraw)                                                                 \
+  X(vkCmdDrawIndexed)                                                          \
+  X(vkCmdDrawIndexedIndirect)                                                  \
+  X(vkCmdEndRenderPass)                                                        \
+  X(vkCmdExecuteCommands)                                                      \
+  X(vkCmdPipelineBarrier)                                                      \
+  X(vkCmdPushConstants)                                                        \
+  X(vkCmdResetQueryPool)                                                       \
+  X(vkCmdSetScissor)                                                           \
+  X(vkCmdSetViewport)                                                          \
+  X(vkCmdWriteTimestamp)                                                       \
+  X(vkCreateBuffer)                                                            \
+  X(vkCreateCommandPool)                                                       \
+  X(vkCreateComputePipelines)                                                  \
+  X(vkCreateDescriptorPool)                                                    \
+  X(vkCreateDescriptorSetLayout)                                               \
+  X(vkCreateDescriptorUpdateTemplate)                                          \
+  X(vkCreateFramebuffer)                                                       \
+  X(vkCreateGraphicsPipelines)                                                 \
+  X(vkCreateImage)                                                             \
+  X(vkCreateImageView)                                                         \
+  X(vkCreatePipelineCache)                                                     \
+  X(vkCreatePipelineLayout)                                                    \
+  X(vkCreateQueryPool)                                                         \
+  X(vkCreateRenderPass)                                                        \
+  X(vkCreateSampler)                                                           \
+  X(vkCreateSemaphore)                                                         \
+  X(vkCreateShaderModule)                                                      \
+  X(vkDestroyBuffer)                                                           \
+  X(vkDestroyCommandPool)                                                      \
+  X(vkDestroyDescriptorPool)                                                   \
+  X(vkDestroyDescriptorSetLayout)                                              \
+  X(vkDestroyDescriptorUpdateTemplate)                                         \
+  X(vkDestroyDevice)                                                           \
+  X(vkDestroyFramebuffer)                                                      \
+  X(vkDestroyImage)                                                            \
+  X(vkDestroyImageView)                                                        \
+  X(vkDestroyPipeline)                                                         \
+  X(vkDestroyPipelineCache)                                                    \
+  X(vkDestroyPipelineLayout)                                                   \
+  X(vkDestroyQueryPool)                                                        \
+  X(vkDestroyRenderPass)                                                       \
+  X(vkDestroySampler)                                                          \
+  X(vkDestroySemaphore)                                                        \
+  X(vkDestroyShaderModule)                                                     \
+  X(vkDeviceWaitIdle)                                                          \
+  X(vkEndCommandBuffer)                                                        \
+  X(vkFreeCommandBuffers)                                                      \
+  X(vkFreeMemory)                                                              \
+  X(vkGetBufferMemoryRequirements2)                                            \
+  X(vkGetDeviceQueue)                                                          \
+  X(vkGetImageMemoryRequirements2)                                             \
+  X(vkGetPipelineCacheData)                                                    \
+  X(vkGetQueryPoolResults)                                                     \
+  X(vkGetSemaphoreCounterValue)                                                \
+  X(vkMapMemory)                                                               \
+  X(vkQueueSubmit)                                                             \
+  X(vkQueueWaitIdle)                                                           \
+  X(vkResetCommandPool)                                                        \
+  X(vkResetDescriptorPool)                                                     \
+  X(vkUpdateDescriptorSetWithTemplate)                                         \
+  X(vkUpdateDescriptorSets)                                                    \
+  X(vkWaitSemaphores)
+
+// Device extensions, each group has an availability flag in
+// VulkanDeviceDispatch that is only set when every function in it loaded
+#define VULKAN_SWAPCHAIN_FUNCTIONS(X)                                          \
+  X(vkAcquireNextImageKHR)                                                     \
+  X(vkCreateSwapchainKHR)                                                      \
+  X(vkDestroySwapchainKHR)                                                     \
+  X(vkGetSwapchainImagesKHR)                                                   \
+  X(vkQueuePresentKHR)
+
+#define VULKAN_SYNCHRONIZATION_2_FUNCTIONS(X) X(vkQueueSubmit2KHR)
+
+#define VULKAN_EXTENDED_DYNAMIC_STATE_3_FUNCTIONS(X)                           \
+  X(vkCmdSetRasterizationSamplesEXT)
+
+#define VULKAN_PRESENT_WAIT_FUNCTIONS(X) X(vkWaitForPresentKHR)
+
+#define VULKAN_DYNAMIC_RENDERING_FUNCTIONS(X)                                  \
+  X(vkCmdBeginRenderingKHR)                                                    \
+  X(vkCmdEndRenderingKHR)
+
+#define VULKAN_ALL_DEVICE_FUNCTIONS(X)                                         \
+  VULKAN_DEVICE_FUNCTIONS(X)                                                   \
+  VULKAN_SWAPCHAIN_FUNCTIONS(X)                                                \
+  VULKAN_SYNCHRONIZATION_2_FUNCTIONS(X)                                        \
+  VULKAN_EXTENDED_DYNAMIC_STATE_3_FUNCTIONS(X)                                 \
+  VULKAN_PRESENT_WAIT_FUNCTIONS(X)                                             \
+  VULKAN_DYNAMIC_RENDERING_FUNCTIONS(X)
+
+namespace VulkanStuff {
+
+// Function pointers of one logical device
+struct VulkanDeviceDispatch {
+#define VULKAN_DISPATCH_MEMBER(name) PFN_##name name = nullptr;
+  VULKAN_ALL_DEVICE_FUNCTIONS(VULKAN_DISPATCH_MEMBER)
+#undef VULKAN_DISPATCH_MEMBER
+
+  bool hasSwapchain = false;
+  bool hasSynchronization2 = false;
+  bool hasExtendedDynamicState3 = false;
+  bool hasPresentWait = false;
+  bool hasDynamicRendering = false;
+};
+
+// The pointers unqualified vkFoo(...) calls resolve to. They live in a
+// namespace so they can't interpose the loader's exported symbols
+namespace Dispatch {
+#define VULKAN_DISPATCH_DECLARE(name) extern PFN_##name name;
+VULKAN_GLOBAL_FUNCTIONS(VULKAN_DISPATCH_DECLARE)
+VULKAN_INSTANCE_FUNCTIONS(VULKAN_DISPATCH_DECLARE)
+VULKAN_SURFACE_FUNCTIONS(VULKAN_DISPATCH_DECLARE)
+VULKAN_ALL_DEVICE_FUNCTIONS(VULKAN_DISPATCH_DECLARE)
+#undef VULKAN_DISPATCH_DECLARE
+} // namespace Dispatch
+
+// Before vkCreateInstance
+void loadGlobalFunctions();
+void loadInstanceFunctions(VkInstance instance);
+// Throws if a core device function is missing, extension groups just get
+// their flag cleared
+VulkanDeviceDispatch loadDeviceDispatch(VkDevice device);
+// Points the unqualified calls at this device's table
+void bindDeviceDispatch(const VulkanDeviceDispatch &dispatch);
+
+} // namespace VulkanStuff
+
+using namespace VulkanStuff::Dispatch;
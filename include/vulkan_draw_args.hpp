@@ -0,0 +1,62 @@
+#pragma once
+#include <vulkan_dispatch.hpp>
+
+#include <utils.hpp>
+#include <vulkan_allocator.hpp>
+
+namespace VulkanStuff {
+
+// Builds the frame's indirect draw arguments with a compute shader, so the
+// draw list's geometry comes from the compute queue. One
+// VkDrawIndexedIndirectCommand per draw, in a region of the buffer per frame
+// slot. The buffer is shared concurrently between the graphics and compute
+// families, the frame waits on the compute timeline before it draws.
+class VulkanDrawArgs {
+public:
+  // From VulkanDevice ========
+  VkDevice device;
+  VulkanAllocator *allocator;
+  uint32_t graphicsFamily;
+  uint32_t computeFamily;
+  VkPipelineCache pipelineCache;
+  //===========================
+
+  // draw_args.comp's workgroup size
+  static constexpr uint32_t WORKGROUP_SIZE = 64;
+
+  // Set 0, the draw arguments as a storage buffer
+  VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+  VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+  VkPipeline pipeline = VK_NULL_HANDLE;
+
+  VkBuffer buffer = VK_NULL_HANDLE;
+  VulkanAllocation bufferMemory{};
+  uint32_t drawsPerRegion = 0;
+
+  VulkanDrawArgs(VkDevice inputDevice, VulkanAllocator *inputAllocator,
+                 uint32_t inputGraphicsFamily, uint32_t inputComputeFamily,
+                 VkPipelineCache inputPipelineCache);
+  ~VulkanDrawArgs();
+
+  VulkanDrawArgs(const VulkanDrawArgs &) = delete;
+  void operator=(const VulkanDrawArgs &) = delete;
+
+  // Room for drawCount draws in each of regionCount regions. Nothing may
+  // still read the old buffer
+  void createBuffer(uint32_t drawCount, uint32_t regionCount);
+  void destroyBuffer();
+
+  // Index of the region's first draw, in draws
+  uint32_t firstDraw(uint32_t frameIndex) const {
+    return frameIndex * drawsPerRegion;
+  }
+
+  // Dispatches the shader for drawCount draws of the frame slot's region.
+  // descriptorSet points set 0 at buffer
+  void record(VkCommandBuffer commandBuffer, VkDescriptorSet descriptorSet,
+              uint32_t frameIndex, uint32_t drawCount);
+
+private:
+  void createPipeline();
+};
+} // namespace VulkanStuff
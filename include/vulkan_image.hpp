@@ -1,12 +1,11 @@
 #pragma once
-#include <vulkan/vulkan.h>
+#include <vulkan_dispatch.hpp>
 
 #include <vector>
 
 #include <utils.hpp>
-
-// for loading stb image function objs
-#include <stb_image.h>
+#include <vulkan_allocator.hpp>
+#include <vulkan_uploader.hpp>
 
 namespace VulkanStuff {
 class VulkanImage {
@@ -15,57 +14,67 @@ public:
   VkDevice device;
   VkPhysicalDevice physicalDevice;
   VkQueue graphicsQueue;
+  VulkanAllocator *allocator;
   //===========================
 
-  // From VulkanCommand =========
-  VkCommandPool commandPool;
+  // From VulkanRenderer =========
+  VulkanUploader *uploader;
   //============================
 
   // From creation window
   VkExtent2D swapChainExtent;
 
-  VkImage textureImage;
-  VkDeviceMemory textureImageMemory;
-  VkImageView textureImageView;
+  // Shared by every streamed texture
   VkSampler textureSampler;
 
-  // Second texture
-  VkImage second_textureImage;
-  VkDeviceMemory second_textureImageMemory;
-  VkImageView second_textureImageView;
-
   // Depth image
   VkImage depthImage;
-  VkDeviceMemory depthImageMemory;
+  VulkanAllocation depthImageMemory{};
   VkImageView depthImageView;
+  VkFormat depthFormat;
 
   VkFormat swapchainFormat;
 
-  VkSampleCountFlagBits msaaSamples = VK_SAMPLE_COUNT_8_BIT;
+  VkSampleCountFlagBits msaaSamples;
   // Color image
   VkImage colorImage;
-  VkDeviceMemory colorImageMemory;
+  VulkanAllocation colorImageMemory{};
   VkImageView colorImageView;
 
 
   VulkanImage(VkPhysicalDevice inputPhysicalDevice, VkDevice inputDevice,
-              VkQueue inputGraphicsQueue, VkCommandPool inputCommandPool,
-              VkExtent2D inputExtent, VkFormat inputFormat);
+              VkQueue inputGraphicsQueue, VulkanAllocator *inputAllocator,
+              VulkanUploader *inputUploader,
+              VkExtent2D inputExtent, VkFormat inputFormat,
+              VkSampleCountFlagBits inputMsaaSamples);
   ~VulkanImage();
 
-  void createImage(uint32_t width, uint32_t height, VkFormat format,
+  // Explicit (external memory) images and render targets get a dedicated
+  // allocation, everything else is sub-allocated
+  void createImage(uint32_t width, uint32_t height, uint32_t mipLevels,
+                   VkFormat format,
                    VkImageTiling tiling, VkImageUsageFlags usage,
                    VkMemoryPropertyFlags properties, VkImage &image,
-                   VkDeviceMemory &imageMemory, bool isExplicit, VkSampleCountFlagBits numSamples);
-
+                   VulkanAllocation &imageMemory, bool isExplicit,
+                   VkSampleCountFlagBits numSamples, bool dedicated = false);
+
+  // Whether optimal tiling images of the format can be sampled with linear
+  // filtering
+  bool supportsSampling(VkFormat format);
+  // Whether vkCmdBlitImage can filter the format linearly, so
+  // generateMipmaps works for it
+  bool supportsLinearBlit(VkFormat format);
+  // Fills levels 1 to mipLevels - 1 from level 0 with a chain of blits,
+  // recorded into the uploader's current batch. Every level must be in
+  // SHADER_READ_ONLY_OPTIMAL and ends up there again
+  void generateMipmaps(VkImage image, uint32_t width, uint32_t height,
+                       uint32_t mipLevels);
+
+  // Recorded into the uploader's current batch, not submitted right away.
+  // Covers mips 0 to mipLevels - 1
   void transitionImageLayout(VkImage image, VkFormat format,
-                             VkImageLayout oldLayout, VkImageLayout newLayout);
-
-  void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width,
-                         uint32_t height);
-
-  void createTextureImage(const char *texPath, VkImage &image,
-                          VkDeviceMemory &imageMemory, bool isExplicit);
+                             uint32_t mipLevels, VkImageLayout oldLayout,
+                             VkImageLayout newLayout);
 
   void createTextureSampler();
 
@@ -10,28 +10,51 @@ public:
   VkDevice device;
   VkSurfaceKHR surface;
   VkQueue graphicsQueue;
+  VkSampleCountFlagBits msaaSamples;
+  bool dynamicRendering;
   //======================================
 
   // From VulkanSwapChain ===============================
   VkExtent2D swapChainExtent;
   VkFormat swapChainImageFormat;
   std::vector<VkImageView> swapChainImageViews;
+  VkImageLayout finalLayout;
   //    ============================================
 
+  // From VulkanTextureTable ==============
+  VkDescriptorSetLayout textureSetLayout;
+  //======================================
+
+  // From VulkanPipelineCache ==============
+  VkPipelineCache pipelineCache;
+  //======================================
+
   VkPipelineLayout pipelineLayout;
+  // Set 0, the per frame uniforms. Set 1 is the texture table
   VkDescriptorSetLayout descriptorSetLayout;
 
-  VulkanRenderPass *vulkanRenderPass;
+  // Null with dynamic rendering, the pipeline then only names its
+  // attachment formats
+  VulkanRenderPass *vulkanRenderPass = nullptr;
 
   VkPipeline graphicsPipeline;
 
+  // How long the last createGraphicsPipeline spent in
+  // vkCreateGraphicsPipelines, and the first one, at startup
+  double lastCreateMs = 0;
+  double startupCreateMs = -1;
+
   // Functions ============================
 
   VulkanPipeline(VkPhysicalDevice inputPhysicalDevice, VkDevice inputDevice,
                  VkSurfaceKHR inputSurface, VkQueue inputGraphicsQueue,
-                 VkExtent2D inputSwapChainExtent,
+                 VkSampleCountFlagBits inputMsaaSamples,
+                 bool inputDynamicRendering, VkExtent2D inputSwapChainExtent,
                  VkFormat inputSwapChainImageFormat,
-                 std::vector<VkImageView> inputSwapChainImageViews);
+                 std::vector<VkImageView> inputSwapChainImageViews,
+                 VkImageLayout inputFinalLayout,
+                 VkDescriptorSetLayout inputTextureSetLayout,
+                 VkPipelineCache inputPipelineCache);
   ~VulkanPipeline();
 
   void createDescriptorSetLayout();
@@ -0,0 +1,46 @@
+#pragma once
+#include <vulkan_dispatch.hpp>
+
+#include <string>
+
+#include <utils.hpp>
+
+namespace VulkanStuff {
+
+// A VkPipelineCache kept on disk between runs, so pipelines are compiled
+// once per driver and device instead of at every launch and swapchain
+// recreation.
+//
+// A blob is only handed to the driver when its header matches this device:
+// vendor and device ID and the driver's pipelineCacheUUID, which changes
+// with every driver update. Anything else starts an empty cache. The cache
+// is written back on destruction, through a temporary file that replaces
+// the old one in one rename.
+class VulkanPipelineCache {
+public:
+  // From VulkanDevice ========
+  VkPhysicalDevice physicalDevice;
+  VkDevice device;
+  //===========================
+
+  std::string filePath;
+  VkPipelineCache cache = VK_NULL_HANDLE;
+
+  // The blob on disk matched this device and was loaded
+  bool loadedFromDisk = false;
+  size_t loadedBytes = 0;
+
+  VulkanPipelineCache(VkPhysicalDevice inputPhysicalDevice,
+                      VkDevice inputDevice, std::string inputFilePath);
+  ~VulkanPipelineCache();
+
+  VulkanPipelineCache(const VulkanPipelineCache &) = delete;
+  void operator=(const VulkanPipelineCache &) = delete;
+
+  // False if the blob couldn't be written, the old file stays as it was
+  bool save();
+
+private:
+  bool isCompatible(const std::vector<char> &blob);
+};
+} // namespace VulkanStuff
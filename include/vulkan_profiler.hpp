@@ -0,0 +1,104 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <vulkan_dispatch.hpp>
+
+#include <utils.hpp>
+
+namespace VulkanStuff {
+
+struct GpuScopeResult {
+  const char *name;
+  // 0 for top level scopes, parents always come before their children
+  uint32_t depth;
+  double ms;
+};
+
+// Named, nestable GPU timestamp scopes. Every frame slot has its own query
+// pool, results for a slot are read back the next time the slot begins,
+// after its timeline value has been waited on, so readback never stalls
+class VulkanProfiler {
+public:
+  // From VulkanDevice ========
+  VkPhysicalDevice physicalDevice;
+  VkDevice device;
+  VkSurfaceKHR surface;
+  float timestampPeriod;
+  //===========================
+
+  static constexpr uint32_t MAX_SCOPES = 64;
+
+  struct ScopeRecord {
+    const char *name;
+    uint32_t depth;
+  };
+
+  struct FrameQueries {
+    VkQueryPool queryPool = VK_NULL_HANDLE;
+    // Scope i owns queries 2i (begin) and 2i+1 (end)
+    std::vector<ScopeRecord> scopes;
+    uint64_t frameNumber = 0;
+  };
+
+  bool supported = false;
+  // Timestamps only have timestampValidBits meaningful bits
+  uint64_t timestampMask = 0;
+
+  std::vector<FrameQueries> frames;
+  uint32_t currentSlot = 0;
+  uint64_t frameNumber = 0;
+  // Indices into the current slot's scopes, UINT32_MAX for dropped scopes
+  std::vector<uint32_t> scopeStack;
+  std::vector<Utils::Query> queryResults;
+
+  // Results of the most recently read back frame
+  std::vector<GpuScopeResult> lastResults;
+  uint64_t lastResultsFrame = 0;
+  bool lastResultsValid = false;
+
+  VulkanProfiler(VkPhysicalDevice inputPhysicalDevice, VkDevice inputDevice,
+                 VkSurfaceKHR inputSurface, float inputTimestampPeriod,
+                 uint32_t slotCount);
+  ~VulkanProfiler();
+
+  // deleting copy constructors
+  VulkanProfiler(const VulkanProfiler &) = delete;
+  void operator=(const VulkanProfiler &) = delete;
+
+  // Must be recorded outside a render pass, resets the slot's queries
+  void beginFrame(VkCommandBuffer commandBuffer, uint32_t slot);
+  void endFrame();
+
+  // Scope names must outlive the profiler, string literals are expected
+  void beginScope(VkCommandBuffer commandBuffer, const char *name);
+  void endScope(VkCommandBuffer commandBuffer);
+
+  // Forget everything recorded, for when frame slots get rebuilt
+  void resetSlots();
+
+  // Summed time of all scopes with this name in the last results, negative
+  // if there are none
+  double getScopeMs(const char *name);
+  void printReport();
+
+  void collectResults(uint32_t slot);
+};
+
+// Closes the scope when it goes out of scope
+class GpuScope {
+public:
+  VulkanProfiler *profiler;
+  VkCommandBuffer commandBuffer;
+
+  GpuScope(VulkanProfiler *inputProfiler, VkCommandBuffer inputCommandBuffer,
+           const char *name)
+      : profiler{inputProfiler}, commandBuffer{inputCommandBuffer} {
+    profiler->beginScope(commandBuffer, name);
+  }
+  ~GpuScope() { profiler->endScope(commandBuffer); }
+
+  GpuScope(const GpuScope &) = delete;
+  void operator=(const GpuScope &) = delete;
+};
+} // namespace VulkanStuff
@@ -2,94 +2,326 @@
 
 #include <SDL2/SDL.h>
 // #include <string>
-#include <vulkan/vulkan.h>
+#include <vulkan_dispatch.hpp>
 #include <vulkan_command.hpp>
 #include <vulkan_device.hpp>
 #include <vulkan_pipeline.hpp>
+#include <vulkan_profiler.hpp>
 #include <vulkan_swapchain.hpp>
 
 #include <vulkan_buffer.hpp>
+#include <vulkan_compute.hpp>
+#include <vulkan_descriptor_allocator.hpp>
+#include <vulkan_draw_args.hpp>
 #include <vulkan_image.hpp>
 #include <vulkan_syncobject.hpp>
+#include <vulkan_texture_streamer.hpp>
+#include <vulkan_texture_table.hpp>
+#include <vulkan_uniform_ring.hpp>
+#include <vulkan_uploader.hpp>
 
 #include <utils.hpp>
+#include <job_system.hpp>
 
 #define GLM_FORCE_RADIANS
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <chrono>
+#include <cmath>
+#include <deque>
 
 namespace VulkanStuff {
 
+// Startup options for the renderer, filled in from the command line
+struct RendererSettings {
+  // Number of frames the CPU may record ahead of the GPU (1 to
+  // VulkanRenderer::MAX_FRAMES_IN_FLIGHT)
+  uint32_t framesInFlight = 2;
+  // Render into offscreen images without a window or swapchain
+  bool headless = false;
+  // Slices the draw list is recorded in, each with its own command pool and
+  // secondary buffer per frame slot. 0 picks one per job system thread up to
+  // VulkanRenderer::MAX_RECORD_THREADS
+  uint32_t recordThreads = 0;
+  // Objects drawn each frame, laid out on a grid. Each has its own uniforms
+  uint32_t objectCount = 2;
+  VkPresentModeKHR presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+  // Swapchain images, 0 lets the swapchain pick minImageCount + 1
+  uint32_t swapchainImages = 0;
+  // One frame in flight, the fewest swapchain images and, with present
+  // wait, no new frame started before the last one reached the screen.
+  // Overrides framesInFlight and swapchainImages
+  bool lowLatency = false;
+  // Begin rendering with the frame's attachments instead of a render pass
+  // and framebuffers, if the device has VK_KHR_dynamic_rendering
+  bool dynamicRendering = false;
+};
+
+// One indexed draw of the frame's draw list. Its index range comes from
+// the draw arguments the compute pass writes for it
+struct DrawCommand {
+  // Dynamic offset of the object's uniforms in the uniform ring
+  uint32_t uniformOffset;
+  // Texture table slot, pushed as a constant
+  uint32_t textureIndex;
+};
+
+// Everything sized to a swapchain that was replaced. Frames in flight keep
+// rendering into it, so it is destroyed once the graphics timeline passes
+// timelineValue instead of waiting for the device to go idle
+struct RetiredSwapChain {
+  uint64_t timelineValue;
+  VulkanSwapChain::Retired swapChain;
+  std::vector<VkFramebuffer> framebuffers;
+  VkImage depthImage;
+  VulkanAllocation depthImageMemory;
+  VkImageView depthImageView;
+  VkImage colorImage;
+  VulkanAllocation colorImageMemory;
+  VkImageView colorImageView;
+  std::vector<VkSemaphore> renderFinishedSemaphores;
+};
+
+// Timings of the last drawFrame call, in milliseconds
+struct FrameStats {
+  // Blocked waiting for the frame slot's previous submission
+  double frameWaitMs = 0;
+  double acquireMs = 0;
+  double submitMs = 0;
+  double presentMs = 0;
+  // GPU time of the "frame" profiler scope from the frame slot's previous
+  // submission, so it trails the CPU side by framesInFlight frames
+  double gpuMs = 0;
+  bool gpuValid = false;
+  // From the input sample of a frame to when pollLatency saw it presented,
+  // or saw the GPU finish it without present wait. Completion is only
+  // checked once per frame, so this is an upper bound that can read up to a
+  // frame interval high. Trails the CPU side, and only valid in calls that
+  // saw a frame complete
+  double latencyBoundMs = 0;
+  bool latencyValid = false;
+  // Recording the frame's primary command buffer, secondaries included
+  double recordMs = 0;
+  // The swapchain was still out of date after recreating it, so nothing was
+  // drawn and the other timings are partial
+  bool skipped = false;
+};
+
+// A frame whose input to present latency is still being measured
+struct PendingLatency {
+  // 0 when the latency is measured to GPU completion instead
+  uint64_t presentId;
+  uint64_t timelineValue;
+  std::chrono::steady_clock::time_point inputTime;
+};
+
 class VulkanRenderer {
 public:
   SDL_Window *window;
 
-  VulkanDevice vulkanDevice{window};
-  VulkanSwapChain vulkanSwapChain{window, vulkanDevice.physicalDevice,
-                                  vulkanDevice.logicalDevice,
-                                  vulkanDevice.surface};
+  // Both built from RendererSettings in the constructor
+  VulkanDevice vulkanDevice;
+  VulkanSwapChain vulkanSwapChain;
 
-  
 
   // uint32_t currentImageIndex;
-  const int MAX_FRAMES_IN_FLIGHT = 2;
+  static constexpr uint32_t MAX_FRAMES_IN_FLIGHT = 4;
+  static constexpr uint32_t MAX_RECORD_THREADS = 8;
+  // Staging ring of the uploader, bigger uploads get a buffer of their own
+  static constexpr VkDeviceSize STAGING_SIZE = 32 * 1024 * 1024;
+  // Texture bytes uploaded per frame at most, apart from one texture
+  static constexpr VkDeviceSize TEXTURE_UPLOAD_BUDGET = 16 * 1024 * 1024;
+  // A resize is only acted on once the window stopped changing size for
+  // this long, unless the swapchain is out of date and can't present at all
+  static constexpr double RESIZE_SETTLE_MS = 50.0;
+  // How often a minimized window is checked for being restored or quit
+  static constexpr Uint32 MINIMIZED_POLL_MS = 16;
+  // Longest waitBeforeInput blocks for a present
+  static constexpr uint64_t PRESENT_WAIT_TIMEOUT_NS = 100000000;
+  static constexpr size_t MAX_PENDING_LATENCIES = 16;
 
+  // Every per-frame resource (command buffer, sync objects, uniform buffer,
+  // descriptor set) is indexed by currentFrame, never by currentImage, so
+  // the CPU can record frame N+1 while the GPU still works on frame N
+  uint32_t framesInFlight;
   uint32_t currentFrame = 0;
   uint32_t currentImage;
 
   VulkanCommand *vulkanCommand;
   VulkanSyncObject *vulkanSyncObject;
+  VulkanUploader *vulkanUploader;
+  // Compute work submitted during drawFrame overlaps the frame on the
+  // compute queue, the frame waits for whatever it consumes
+  VulkanCompute *vulkanCompute;
   VulkanBuffer *vulkanBuffer;
   VulkanImage *vulkanImage;
 
+  // Every texture of the frame, bound once as descriptor set 1
+  VulkanTextureTable *textureTable;
+
+  // Both textures stream in, drawn with a placeholder until resident
+  VulkanTextureStreamer *textureStreamer;
+  TextureHandle texture;
+  TextureHandle secondTexture;
+
   VulkanPipeline* vulkanPipeline;
 
+  // Descriptor sets come from here. Set 0 is cached across frames until the
+  // uniform ring is rebuilt
+  VulkanDescriptorAllocator *descriptorAllocator;
+  // Writes the pipeline's set 0 from a VkDescriptorBufferInfo
+  DescriptorTemplate uniformTemplate;
+  // This frame's set 0, draws only change its dynamic offset
+  VkDescriptorSet frameDescriptorSet = VK_NULL_HANDLE;
+
+  // Indirect draw arguments of every frame slot, written on the compute
+  // queue. The buffer is rebuilt with the frame resources
+  VulkanDrawArgs *drawArgs;
+  // Writes the draw args shader's set 0 from a VkDescriptorBufferInfo
+  DescriptorTemplate drawArgsTemplate;
+  // Where this frame's draw arguments start, draw i is at
+  // drawArgsOffset + i * sizeof(VkDrawIndexedIndirectCommand)
+  VkDeviceSize drawArgsOffset = 0;
+
+  // Per object uniforms of every frame slot, rebuilt with the frame resources
+  VulkanUniformRing *uniformRing = nullptr;
+  uint32_t objectCount;
+  // Where this frame's object uniforms start in the ring, object i is at
+  // objectUniformOffset + i * objectUniformStride
+  uint32_t objectUniformOffset = 0;
+  uint32_t objectUniformStride = 0;
+
+  VulkanProfiler *vulkanProfiler;
+
+  // The draw list is split into recordThreadCount slices, recorded as jobs
+  // into the slice's own secondary command buffer
+  uint32_t recordThreadCount;
+  Utils::JobSystem *jobSystem;
+  std::vector<DrawCommand> drawList;
+
+  // Empty with dynamic rendering
   std::vector<VkFramebuffer> swapChainFramebuffers;
+  // Oldest first, see releaseRetiredSwapChains
+  std::deque<RetiredSwapChain> retiredSwapChains;
+
+  // Pending submission of the frame being recorded, kept around so the
+  // vectors don't reallocate every frame
+  std::vector<VkCommandBufferSubmitInfoKHR> frameCommandBuffers;
+  std::vector<VkSemaphoreSubmitInfoKHR> frameWaitSemaphores;
 
   // Can be inputs from game =============
   std::vector<Utils::Vertex> vertices;
   std::vector<uint16_t> indices;
   float rotation = 0;
+  // Set by requestResize, the swapchain is recreated after a present once
+  // the resize events settle
+  bool framebufferResized = false;
+  std::chrono::steady_clock::time_point lastResizeRequest;
 
   //=====================================
 
-  VkQueryPool queryPool;
+  FrameStats lastFrameStats;
   //=====================================
 
-  VulkanRenderer(SDL_Window *sdlWindow);
+  // See RendererSettings::lowLatency. The settings it replaced come back
+  // when it is switched off
+  bool lowLatency = false;
+  uint32_t savedFramesInFlight;
+  uint32_t savedSwapchainImages;
+
+  // Present ids go through VK_KHR_present_id, so latency reaches the screen
+  bool usePresentWait;
+  uint64_t lastPresentId = 0;
+  // Oldest first, polled every frame
+  std::deque<PendingLatency> pendingLatencies;
+  // Stamped by waitBeforeInput
+  std::chrono::steady_clock::time_point inputSampleTime;
+
+  VulkanRenderer(SDL_Window *sdlWindow, RendererSettings settings,
+                 Utils::JobSystem *inputJobSystem);
   ~VulkanRenderer();
 
+  // The render pass contents come from secondary command buffers, see
+  // recordDrawList
   void beginRenderPass(VkCommandBuffer commandBuffer, uint32_t imageIndex);
   void endRenderPass(VkCommandBuffer commandBuffer);
+  // The dynamic rendering equivalents. The layout transitions the render
+  // pass did are explicit barriers here
+  void beginRendering(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+  void endRendering(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+
+  // Both are dynamic state, set after every pipeline bind
+  void setViewportAndScissor(VkCommandBuffer commandBuffer);
 
   void drawObjects(VkCommandBuffer commandBuffer);
   void drawFromVertices(VkCommandBuffer commandBuffer);
 
   void drawFromIndices(VkCommandBuffer commandBuffer);
 
-  void drawFromDescriptors(VkCommandBuffer commandBuffer, int imageIndex);
+  void buildDrawList();
+  // Submits the compute pass that writes the draw list's arguments, the
+  // frame waits for it before drawing
+  void dispatchDrawArgs(uint32_t frameIndex);
+  // Records the draw list on the recording threads and executes the
+  // secondary buffers from commandBuffer, which must be inside the render pass
+  void recordDrawList(VkCommandBuffer commandBuffer, uint32_t frameIndex,
+                      uint32_t imageIndex);
+  void recordDrawSlice(VkCommandBuffer secondaryBuffer, uint32_t imageIndex,
+                       uint32_t firstDraw, uint32_t drawCount);
 
   void clearColorImage();
 
   void beginDrawingCommandBuffer(VkCommandBuffer commandBuffer);
 
-  void endDrawingCommandBuffer(VkCommandBuffer commandBuffer,
-                               VkSemaphore imageAvailableSemaphore,
-                               VkSemaphore renderFinishedSemaphore,
-                               VkFence inFlightFence);
+  void endDrawingCommandBuffer(VkCommandBuffer commandBuffer);
+
+  // Everything the frame submits goes into one vkQueueSubmit2 call, other
+  // subsystems can add their command buffers and waits before submitFrame
+  void addFrameCommandBuffer(VkCommandBuffer commandBuffer);
+  void addFrameWaitSemaphore(VkSemaphore semaphore, uint64_t value,
+                             VkPipelineStageFlags2KHR stageMask);
+  void submitFrame(VkSemaphore imageAvailableSemaphore,
+                   VkSemaphore renderFinishedSemaphore);
 
-  void cleanupSwapChain();
+  // Called for every window resize event, bursts of them end up in one
+  // swapchain recreation
+  void requestResize();
   void recreateSwapChain();
+  // Destroys retired swapchains whose frames have finished, or all of them
+  // once the device is idle
+  void releaseRetiredSwapChains();
+  void destroyRetiredSwapChain(RetiredSwapChain &retired);
+  // Only needed when the swapchain comes back with another format
+  void recreateRenderPass();
 
   void recreateVertexBuffer(std::vector<Utils::Vertex> inputVertices);
 
-  void updateUniformBuffer(uint32_t currentImage);
+  void createFrameResources();
+  void cleanupFrameResources();
+  void setFramesInFlight(uint32_t number);
+
+  // Each goes through a swapchain recreation, no restart needed
+  void setPresentMode(VkPresentModeKHR presentMode);
+  void setSwapchainImageCount(uint32_t count);
+  void setLowLatency(bool enabled);
+
+  // Called right before the game samples input. In low latency mode blocks
+  // until the previous frame reached the screen, then stamps the time this
+  // frame's latency is measured from
+  void waitBeforeInput();
+  // Non blocking, puts the newest finished frame's latency bound into
+  // lastFrameStats. The time is taken here, not when the frame finished
+  void pollLatency();
+  // "present" or "gpu", what latencyBoundMs is measured to
+  const char *latencySource() const;
+
+  // Writes every object's uniforms into the frame slot's ring region
+  void updateUniformBuffer(uint32_t frameIndex);
 
   void drawFrame(uint32_t queryIndex);
 
-  void getQueryPoolTimes();
-  void resetQueryPool();
+  // Headless only, writes the most recently rendered image as a PPM
+  void saveLastFrame(const std::string &filePath);
 };
 } // namespace VulkanStuff
\ No newline at end of file
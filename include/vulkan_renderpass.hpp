@@ -1,7 +1,7 @@
 #pragma once
 
 #include <stdexcept>
-#include <vulkan/vulkan.h>
+#include <vulkan_dispatch.hpp>
 
 #include <utils.hpp>
 namespace VulkanStuff {
@@ -11,13 +11,18 @@ public:
   VkPhysicalDevice physicalDevice;
   VkDevice device;
 
+  VkSampleCountFlagBits msaaSamples;
+
   // From VulkanSwapChain;
   VkFormat swapChainImageFormat;
+  VkImageLayout finalLayout;
   // ====================
   VkRenderPass renderPass;
 
   VulkanRenderPass(VkPhysicalDevice inputPhysicalDevice, VkDevice inputDevice,
-                   VkFormat inputSwapChainImageFormat);
+                   VkSampleCountFlagBits inputMsaaSamples,
+                   VkFormat inputSwapChainImageFormat,
+                   VkImageLayout inputFinalLayout);
   ~VulkanRenderPass();
 
   void createRenderPass();
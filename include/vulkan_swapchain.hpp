@@ -3,10 +3,11 @@
 #include <algorithm>
 #include <limits>
 #include <vector>
-#include <vulkan/vulkan.h>
+#include <vulkan_dispatch.hpp>
 
 #include <SDL2/SDL_vulkan.h>
 #include <utils.hpp>
+#include <vulkan_allocator.hpp>
 namespace VulkanStuff {
 
 class VulkanSwapChain {
@@ -16,18 +17,48 @@ public:
   VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
   VkDevice device;
   VkSurfaceKHR surface;
+  VulkanAllocator *allocator;
   //======================================================
 
-  VkSwapchainKHR swapChain;
+  // Headless mode renders into a ring of offscreen images instead of a
+  // swapchain, acquire and present become no ops apart from the ring index
+  bool headless;
+  // Matches VulkanRenderer::MAX_FRAMES_IN_FLIGHT so a ring image is never
+  // rendered to while an earlier frame using it is still in flight
+  static constexpr uint32_t HEADLESS_IMAGE_COUNT = 4;
+  std::vector<VulkanAllocation> offscreenImagesMemory;
+  uint32_t nextOffscreenImage = 0;
+
+  // Layout the render pass leaves the final image in
+  VkImageLayout finalLayout;
+
+  // What createSwapChain asks for. A mode the surface lacks falls back to
+  // FIFO, which every surface has, and the image count is clamped to the
+  // surface's range. 0 images means minImageCount + 1
+  VkPresentModeKHR requestedPresentMode;
+  uint32_t requestedImageCount;
+
+  VkSwapchainKHR swapChain = VK_NULL_HANDLE;
+  VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
   uint32_t imageCount;
   std::vector<VkImage> swapChainImages;
   VkFormat swapChainImageFormat;
   VkExtent2D swapChainExtent;
   std::vector<VkImageView> swapChainImageViews;
 
+  // A swapchain replaced by recreateSwapChain. Frames still in flight may
+  // render into its images and its last presents may still be queued
+  struct Retired {
+    VkSwapchainKHR swapChain = VK_NULL_HANDLE;
+    std::vector<VkImageView> imageViews;
+  };
+
   // Functions
   VulkanSwapChain(SDL_Window *sdlWindow, VkPhysicalDevice inputPhysicalDevice,
-                  VkDevice inputDevice, VkSurfaceKHR inputSurface);
+                  VkDevice inputDevice, VkSurfaceKHR inputSurface,
+                  VulkanAllocator *inputAllocator,
+                  VkPresentModeKHR inputPresentMode,
+                  uint32_t inputImageCount);
   ~VulkanSwapChain();
 
   // Swapchain Config settings ========
@@ -41,8 +72,25 @@ public:
   //===================================
 
   void createSwapChain();
+  void createOffscreenImages();
 
   void createSwapChainImageViews();
+
+  void cleanupSwapChain();
+
+  // Builds the new swapchain with the current one as its oldSwapchain, so
+  // presentation carries on while it is created. Destroy the result with
+  // destroyRetired once the GPU is done with it. Not for headless mode
+  Retired recreateSwapChain();
+  void destroyRetired(Retired &retired);
+
+  VkResult acquireNextImage(VkSemaphore imageAvailableSemaphore,
+                            uint32_t *imageIndex);
+  // A presentId other than 0 is passed on through VK_KHR_present_id, ids
+  // have to grow with every present to the same swapchain
+  VkResult presentImage(VkQueue presentQueue,
+                        VkSemaphore renderFinishedSemaphore,
+                        uint32_t imageIndex, uint64_t presentId);
 };
 
 } // namespace VulkanStuff
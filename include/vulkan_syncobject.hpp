@@ -1,22 +1,79 @@
-
 #pragma once
+#include <cpu_profiler.hpp>
 #include <stdexcept>
 #include <vector>
-#include <vulkan/vulkan.h>
+#include <vulkan_dispatch.hpp>
 
 namespace VulkanStuff {
+
+// Wraps a timeline semaphore that counts submissions on one queue. Every
+// submission signals a new, higher value, so "is GPU work X done?" is a
+// compare against the counter instead of a fence per submission.
+class VulkanTimeline {
+public:
+  // From Vulkan Device ======
+  VkDevice device;
+  //  =========
+  VkSemaphore semaphore;
+
+  // Last value handed out to a submission on this queue
+  uint64_t submittedValue = 0;
+  // Last value the GPU was seen to reach, cached so repeated checks don't
+  // go to the driver
+  uint64_t completedValue = 0;
+
+  VulkanTimeline(VkDevice inputDevice);
+  ~VulkanTimeline();
+
+  VulkanTimeline(const VulkanTimeline &) = delete;
+  void operator=(const VulkanTimeline &) = delete;
+
+  // Value the next submission on this queue will signal
+  uint64_t nextValue();
+
+  // Non blocking read of the GPU counter
+  uint64_t queryCompletedValue();
+  bool isComplete(uint64_t value);
+
+  // Blocks until the GPU reaches value
+  void wait(uint64_t value);
+};
+
 class VulkanSyncObject {
 public:
   // From Vulkan Device ======
   VkDevice device;
   //  =========
+
+  // Binary semaphores are still needed for acquire and present, which don't
+  // accept timeline semaphores. Acquire semaphores go by frame slot, the
+  // slot's timeline wait proves the submission that waited on one is done
   std::vector<VkSemaphore> imageAvailableSemaphores;
+  // Present semaphores go by swapchain image. The timeline can't tell when
+  // a present consumed its wait, but getting the image back from acquire
+  // can, so one is only signalled again once its image was presented
   std::vector<VkSemaphore> renderFinishedSemaphores;
-  std::vector<VkFence> inFlightFences;
+
+  VulkanTimeline *graphicsTimeline;
+  // Counts submissions on the transfer queue, unused when uploads share the
+  // graphics queue
+  VulkanTimeline *transferTimeline;
+  // Counts submissions on the compute queue
+  VulkanTimeline *computeTimeline;
+
+  // Graphics timeline value signalled by the last submission of each frame
+  // slot, the slot can be reused once the timeline has passed it
+  std::vector<uint64_t> frameTimelineValues;
 
   VulkanSyncObject(VkDevice inputDevice, uint32_t number);
   ~VulkanSyncObject();
 
   void createSyncObjects(uint32_t number);
+  void cleanupSyncObjects();
+
+  void createPresentSemaphores(uint32_t imageCount);
+  // Hands the present semaphores over to the caller, which destroys them
+  // along with the swapchain they were presented to
+  std::vector<VkSemaphore> retirePresentSemaphores();
 };
-} // namespace VulkanStuff
\ No newline at end of file
+} // namespace VulkanStuff
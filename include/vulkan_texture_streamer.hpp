@@ -0,0 +1,169 @@
+#pragma once
+#include <vulkan_dispatch.hpp>
+
+#include <mutex>
+#include <queue>
+#include <string>
+#include <vector>
+
+#include <job_system.hpp>
+#include <ktx2_loader.hpp>
+#include <texture_formats.hpp>
+#include <vulkan_allocator.hpp>
+#include <vulkan_image.hpp>
+#include <vulkan_texture_table.hpp>
+#include <vulkan_uploader.hpp>
+
+// for loading stb image function objs
+#include <stb_image.h>
+
+namespace VulkanStuff {
+
+// Index into VulkanTextureStreamer::textures
+typedef uint32_t TextureHandle;
+
+// Loads textures in the background. Requests wait in a priority queue, a
+// limited number are decoded at a time on the job system, and update()
+// uploads the decoded ones through the uploader within a per frame byte
+// budget. Until a texture is resident draws index a placeholder, so nothing
+// ever waits for a load. Everything but the decode itself runs on the render
+// thread.
+//
+// .ktx2 files keep their block compressed format and mip chain when the
+// device can sample it, otherwise every level is decoded to RGBA8. Anything
+// else goes through stb_image.
+class VulkanTextureStreamer {
+public:
+  // From VulkanDevice ========
+  VkDevice device;
+  VulkanAllocator *allocator;
+  //===========================
+
+  // From VulkanRenderer =========
+  VulkanImage *vulkanImage;
+  VulkanUploader *uploader;
+  Utils::JobSystem *jobSystem;
+  VulkanTextureTable *textureTable;
+  //============================
+
+  enum class TextureState {
+    Queued,
+    // On a job system thread, or decoded and waiting for its upload
+    Decoding,
+    // Copy recorded, anything submitted after the uploader's batch sees it
+    Resident,
+    // Decode failed, keeps the placeholder
+    Failed
+  };
+
+  struct StreamedTexture {
+    std::string path;
+    int32_t priority;
+    TextureState state = TextureState::Queued;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t mipLevels = 1;
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    VkImage image = VK_NULL_HANDLE;
+    VulkanAllocation memory{};
+    VkImageView view = VK_NULL_HANDLE;
+    // Texture table slot, written once the texture is resident
+    uint32_t textureIndex = 0;
+  };
+  std::vector<StreamedTexture> textures;
+
+  // Higher priority first, then in request order
+  struct LoadRequest {
+    int32_t priority;
+    uint64_t sequence;
+    TextureHandle handle;
+
+    bool operator<(const LoadRequest &other) const {
+      if (priority != other.priority) {
+        return priority < other.priority;
+      }
+      return sequence > other.sequence;
+    }
+  };
+  std::priority_queue<LoadRequest> requestQueue;
+  uint64_t requestSequence = 0;
+
+  // Filled by decode jobs, drained by update()
+  struct DecodedTexture {
+    TextureHandle handle;
+    // Texels or blocks of format, decodedLevels mips packed one after
+    // another. Empty if the decode failed
+    std::vector<uint8_t> pixels;
+    uint32_t width;
+    uint32_t height;
+    uint32_t mipLevels;
+    uint32_t decodedLevels;
+    VkFormat format;
+    VkFormat viewFormat;
+    // Why the decode failed, if anyone said
+    std::string error;
+  };
+  std::mutex decodedMutex;
+  std::vector<DecodedTexture> decodedTextures;
+  // Render thread side, decoded textures left over by the upload budget
+  std::vector<DecodedTexture> readyTextures;
+
+  Utils::JobCounter decodeCounter;
+  // Decodes started and not yet uploaded, keeps low priority requests from
+  // being decoded ahead of ones that arrive later with a higher priority
+  uint32_t decodesInFlight = 0;
+  uint32_t maxDecodesInFlight;
+  // Staging bytes update() may spend per call, one texture always goes
+  VkDeviceSize uploadBudget;
+  // Mips are blitted on the GPU, otherwise decode jobs build the whole
+  // chain and it is uploaded with level 0
+  bool gpuMips;
+
+  // Grey checkerboard shown until a texture is resident
+  VkImage placeholderImage = VK_NULL_HANDLE;
+  VulkanAllocation placeholderMemory{};
+  VkImageView placeholderView = VK_NULL_HANDLE;
+  uint32_t placeholderIndex = 0;
+
+  // Statistics
+  uint32_t residentCount = 0;
+  uint64_t streamedBytes = 0;
+
+  VulkanTextureStreamer(VkDevice inputDevice, VulkanAllocator *inputAllocator,
+                        VulkanImage *inputVulkanImage,
+                        VulkanUploader *inputUploader,
+                        Utils::JobSystem *inputJobSystem,
+                        VulkanTextureTable *inputTextureTable,
+                        uint32_t inputMaxDecodesInFlight,
+                        VkDeviceSize inputUploadBudget);
+  ~VulkanTextureStreamer();
+
+  VulkanTextureStreamer(const VulkanTextureStreamer &) = delete;
+  void operator=(const VulkanTextureStreamer &) = delete;
+
+  // Queues a load, higher priorities are decoded first
+  TextureHandle request(const std::string &path, int32_t priority);
+  // Only matters while the texture is still queued
+  void setPriority(TextureHandle handle, int32_t priority);
+
+  // Starts decodes up to maxDecodesInFlight and uploads what finished
+  // decoding, call once per frame before the uploader's batch is closed
+  void update();
+
+  bool isResident(TextureHandle handle) const;
+  // The placeholder until the texture is resident
+  VkImageView getImageView(TextureHandle handle) const;
+  // Texture table slot to draw the texture with, the placeholder's until it
+  // is resident. Pick it per frame, a slot never changes once written
+  uint32_t getTextureIndex(TextureHandle handle) const;
+
+private:
+  void startDecode(TextureHandle handle);
+  // Run on the job system
+  void decodeImage(const std::string &path, bool buildMips,
+                   DecodedTexture &decoded);
+  void decodeKtx2(const std::string &path, DecodedTexture &decoded);
+  void uploadTexture(const DecodedTexture &decoded);
+  void createPlaceholder();
+};
+} // namespace VulkanStuff
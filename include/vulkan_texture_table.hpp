@@ -0,0 +1,50 @@
+#pragma once
+#include <vulkan_dispatch.hpp>
+
+#include <utils.hpp>
+
+namespace VulkanStuff {
+
+// Every texture in one descriptor set, an array of combined image samplers
+// the fragment shader indexes with the draw's push constant. The set is
+// bound once per command buffer, so switching textures between draws costs
+// nothing.
+//
+// The binding is partially bound and update after bind: slots are written
+// once, while command buffers that have the set bound may still be pending,
+// as long as none of them reads the slot being written. Slots are never
+// freed or rewritten.
+class VulkanTextureTable {
+public:
+  // Size of the textures array in simple_shader.frag
+  static constexpr uint32_t MAX_TEXTURES = 1024;
+
+  // From VulkanDevice ========
+  VkPhysicalDevice physicalDevice;
+  VkDevice device;
+  //===========================
+
+  // From VulkanImage =========
+  VkSampler sampler;
+  //===========================
+
+  VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+  VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+  VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+
+  // Slots handed out so far
+  uint32_t slotCount = 0;
+
+  VulkanTextureTable(VkPhysicalDevice inputPhysicalDevice, VkDevice inputDevice,
+                     VkSampler inputSampler);
+  ~VulkanTextureTable();
+
+  VulkanTextureTable(const VulkanTextureTable &) = delete;
+  void operator=(const VulkanTextureTable &) = delete;
+
+  // Writes imageView into the next free slot and returns its index. The view
+  // must stay alive, and in SHADER_READ_ONLY_OPTIMAL whenever a draw indexes
+  // it, for as long as the table. Throws when the table is full
+  uint32_t add(VkImageView imageView);
+};
+} // namespace VulkanStuff
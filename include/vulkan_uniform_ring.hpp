@@ -0,0 +1,69 @@
+#pragma once
+#include <vulkan_dispatch.hpp>
+
+#include <atomic>
+#include <vector>
+
+#include <utils.hpp>
+#include <vulkan_allocator.hpp>
+
+namespace VulkanStuff {
+
+// One persistently mapped uniform buffer split into a region per frame slot.
+// Allocating is an atomic pointer bump inside the current slot's region, and
+// draws point at their data with a UNIFORM_BUFFER_DYNAMIC offset, so per
+// object uniforms need neither their own memory nor their own descriptors
+class VulkanUniformRing {
+public:
+  // From VulkanDevice ========
+  VkPhysicalDevice physicalDevice;
+  VkDevice device;
+  VulkanAllocator *allocator;
+  //===========================
+
+  VkBuffer buffer = VK_NULL_HANDLE;
+  VulkanAllocation bufferMemory{};
+  // Mapped for the ring's whole lifetime
+  uint8_t *mapped = nullptr;
+
+  // minUniformBufferOffsetAlignment, every allocation starts on it
+  VkDeviceSize alignment;
+  VkDeviceSize regionSize;
+  uint32_t regionCount;
+
+  // Region allocations currently come from, and the next free offset in it
+  uint32_t currentRegion = 0;
+  std::atomic<VkDeviceSize> head{0};
+
+  struct Allocation {
+    // Offset into buffer, use as the dynamic offset
+    uint32_t offset;
+    void *data;
+  };
+
+  VulkanUniformRing(VkPhysicalDevice inputPhysicalDevice, VkDevice inputDevice,
+                    VulkanAllocator *inputAllocator, uint32_t inputRegionCount,
+                    VkDeviceSize bytesPerRegion);
+  ~VulkanUniformRing();
+
+  VulkanUniformRing(const VulkanUniformRing &) = delete;
+  void operator=(const VulkanUniformRing &) = delete;
+
+  VkDeviceSize alignUp(VkDeviceSize size) const {
+    return (size + alignment - 1) & ~(alignment - 1);
+  }
+
+  // Starts handing out the frame slot's region again, only once the slot's
+  // previous submission has finished reading it
+  void beginFrame(uint32_t frameIndex);
+
+  // Safe to call from several threads at once. Throws when the region is full
+  Allocation allocate(VkDeviceSize size);
+
+  template <typename T> T *allocate(uint32_t *offset) {
+    Allocation allocation = allocate(sizeof(T));
+    *offset = allocation.offset;
+    return static_cast<T *>(allocation.data);
+  }
+};
+} // namespace VulkanStuff
@@ -0,0 +1,169 @@
+#pragma once
+#include <vulkan_dispatch.hpp>
+
+#include <deque>
+#include <vector>
+
+#include <utils.hpp>
+#include <vulkan_allocator.hpp>
+#include <vulkan_syncobject.hpp>
+
+namespace VulkanStuff {
+
+// Batches uploads and layout transitions instead of submitting and waiting
+// for each one. Data is copied into a persistently mapped staging ring, the
+// copies are recorded into the current batch's command buffer, and the batch
+// rides along with the next frame's submission (or goes out on its own with
+// flush()). Staging space is handed back once the graphics timeline passes
+// the value of the submission that read it, nothing ever waits for the queue
+// to go idle. Submits to the graphics queue, so only use it from the render
+// thread.
+//
+// With a separate transfer queue the copies run there instead. The frame
+// then waits on the transfer timeline and, across queue families, acquires
+// ownership of everything the batch wrote. Upload destinations must not be
+// in use by the graphics queue, nothing orders the copy against it.
+class VulkanUploader {
+public:
+  // From VulkanDevice ========
+  VkDevice device;
+  VkQueue graphicsQueue;
+  uint32_t graphicsFamily;
+  VkQueue transferQueue;
+  uint32_t transferFamily;
+  VulkanAllocator *allocator;
+  //===========================
+
+  // From VulkanSyncObject =====
+  VulkanTimeline *graphicsTimeline;
+  VulkanTimeline *transferTimeline;
+  //===========================
+
+  // Copies run on their own queue, every batch is two submissions
+  bool separateQueue;
+
+  // Anything bigger than half the ring gets a staging buffer of its own
+  VkBuffer stagingBuffer = VK_NULL_HANDLE;
+  VulkanAllocation stagingMemory{};
+  VkDeviceSize stagingSize;
+  // Absolute byte positions, the ring offset is position % stagingSize.
+  // [stagingTail, stagingHead) is still waiting to be read by the GPU
+  uint64_t stagingHead = 0;
+  uint64_t stagingTail = 0;
+
+  struct Batch {
+    // Graphics queue side, acquires the uploads and holds record() work.
+    // The only command buffer without a separate queue
+    VkCommandPool commandPool;
+    VkCommandBuffer commandBuffer;
+    // Transfer queue side, the copies. Same as commandBuffer without a
+    // separate queue
+    VkCommandPool transferCommandPool = VK_NULL_HANDLE;
+    VkCommandBuffer transferCommandBuffer;
+    bool hasCopies = false;
+    // Graphics timeline value of the submission the batch went out with
+    uint64_t timelineValue = 0;
+    // Staging ring range the batch reads from
+    uint64_t stagingStart = 0;
+    uint64_t stagingEnd = 0;
+    // Oversized uploads, destroyed with the batch
+    std::vector<VkBuffer> tempBuffers;
+    std::vector<VulkanAllocation> tempMemory;
+  };
+
+  // What the frame adds to its submission for a closed batch
+  struct FrameUploads {
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    // Transfer timeline wait, null without a separate queue
+    VkSemaphore waitSemaphore = VK_NULL_HANDLE;
+    uint64_t waitValue = 0;
+    VkPipelineStageFlags2KHR waitStages = 0;
+  };
+
+  // Being recorded, null until the first upload after a submission
+  Batch *currentBatch = nullptr;
+  // Handed to the frame by endBatch, waiting for batchSubmitted
+  Batch *closedBatch = nullptr;
+  // Submitted, oldest first
+  std::deque<Batch *> inFlightBatches;
+  std::vector<Batch *> freeBatches;
+
+  // Makes the batch's writes visible to their consumers on the graphics
+  // queue, emitted once before record() work or at the end of the batch
+  // instead of after every copy. Across queue families these are the
+  // acquire halves of the ownership transfers
+  std::vector<VkBufferMemoryBarrier> visibleBufferBarriers;
+  std::vector<VkImageMemoryBarrier> visibleImageBarriers;
+  VkPipelineStageFlags visibleStages = 0;
+  // Separate queue only, recorded at the end of the transfer command buffer
+  std::vector<VkBufferMemoryBarrier> releaseBufferBarriers;
+  std::vector<VkImageMemoryBarrier> releaseImageBarriers;
+  // Consumers of the current batch's copies, the frame waits there
+  VkPipelineStageFlags consumerStages = 0;
+
+  // Statistics
+  uint64_t submittedBatches = 0;
+  uint64_t uploadedBytes = 0;
+
+  VulkanUploader(VkDevice inputDevice, VkQueue inputGraphicsQueue,
+                 uint32_t inputGraphicsFamily, VkQueue inputTransferQueue,
+                 uint32_t inputTransferFamily, VulkanAllocator *inputAllocator,
+                 VulkanTimeline *inputGraphicsTimeline,
+                 VulkanTimeline *inputTransferTimeline,
+                 VkDeviceSize inputStagingSize);
+  ~VulkanUploader();
+
+  VulkanUploader(const VulkanUploader &) = delete;
+  void operator=(const VulkanUploader &) = delete;
+
+  // Copies size bytes of data into dst. The write is visible to dstStage /
+  // dstAccess of anything submitted after the batch
+  void uploadBuffer(VkBuffer dst, VkDeviceSize dstOffset, const void *data,
+                    VkDeviceSize size, VkPipelineStageFlags dstStage,
+                    VkAccessFlags dstAccess);
+
+  // Replaces the first uploadedLevels mips of a color image with tightly
+  // packed texels (or blocks) of format, one level after another. All
+  // mipLevels end up SHADER_READ_ONLY_OPTIMAL for the fragment shader, the
+  // ones past uploadedLevels with undefined contents
+  void uploadImage(VkImage image, VkFormat format, uint32_t width,
+                   uint32_t height, const void *data, VkDeviceSize size,
+                   uint32_t mipLevels = 1, uint32_t uploadedLevels = 1);
+
+  // Records other work (layout transitions, clears) into the current batch
+  // on the graphics queue, after every upload made so far is visible
+  template <typename Function> void record(const Function &function) {
+    Batch *batch = beginBatch();
+    emitVisibleBarriers(batch);
+    function(batch->commandBuffer);
+  }
+
+  // Closes the current batch for the frame to submit, with a separate queue
+  // the copies already go out here. Empty if there is nothing to upload.
+  // Call batchSubmitted with the frame's timeline value once it has been
+  // submitted
+  FrameUploads endBatch();
+  void batchSubmitted(uint64_t timelineValue);
+
+  // Submits the current batch on its own, returns the graphics timeline
+  // value that signals its completion (or the last one if there was nothing
+  // to submit)
+  uint64_t flush();
+
+private:
+  Batch *beginBatch();
+  void emitVisibleBarriers(Batch *batch);
+  // Ends the batch's command buffers and submits the copies if they have a
+  // queue of their own
+  FrameUploads closeBatch(Batch *batch);
+  // Queues the barriers that hand a finished copy over to its consumers
+  void addHandoff(VkBufferMemoryBarrier *bufferBarrier,
+                  VkImageMemoryBarrier *imageBarrier,
+                  VkPipelineStageFlags dstStage, VkAccessFlags dstAccess);
+  // Returns ring space and temp buffers of batches the GPU is done with
+  void retireBatches();
+  // Reserves staging memory in the current batch, returns where to write
+  void *allocateStaging(VkDeviceSize size, VkDeviceSize alignment,
+                        VkBuffer &buffer, VkDeviceSize &offset);
+};
+} // namespace VulkanStuff
@@ -1,6 +1,11 @@
 #version 450
 
-layout(binding = 1) uniform sampler2D texSampler;
+// VulkanTextureTable, MAX_TEXTURES entries
+layout(set = 1, binding = 0) uniform sampler2D textures[1024];
+
+layout(push_constant) uniform DrawConstants {
+    uint textureIndex;
+} draw;
 
 layout(location = 0) in vec3 inColor;
 layout(location = 1) in vec2 fragTexCoord;
@@ -9,5 +14,5 @@ layout (location = 0) out vec4 outColor;
 
 void main() {
     //rgb, alpha
-    outColor = texture(texSampler, fragTexCoord);
+    outColor = texture(textures[draw.textureIndex], fragTexCoord);
 }
\ No newline at end of file
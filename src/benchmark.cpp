@@ -0,0 +1,231 @@
+#include <benchmark.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <numeric>
+
+namespace GameEngine {
+Benchmark::Benchmark(BenchmarkSettings inputSettings)
+    : settings{inputSettings} {
+  frames.reserve(settings.measuredFrames);
+  std::cout << "Benchmark: " << settings.warmupFrames << " warmup frames, "
+            << settings.measuredFrames << " measured frames\n";
+}
+
+uint32_t Benchmark::totalFrames() {
+  return settings.warmupFrames + settings.measuredFrames;
+}
+
+bool Benchmark::isFinished() { return framesDrawn >= totalFrames(); }
+
+float Benchmark::rotationForFrame(uint32_t frame) {
+  // Same step as holding W, one full turn every 400 frames
+  return frame * 0.01f;
+}
+
+void Benchmark::addFrame(double cpuMs, const VulkanStuff::FrameStats &stats) {
+  if (stats.skipped) {
+    if (framesDrawn >= settings.warmupFrames) {
+      skippedFrames++;
+    }
+    return;
+  }
+  if (framesDrawn >= settings.warmupFrames) {
+    frames.push_back({cpuMs, stats});
+  }
+  framesDrawn++;
+}
+
+MetricSummary Benchmark::summarize(std::vector<double> samples) {
+  MetricSummary summary{};
+  if (samples.empty()) {
+    return summary;
+  }
+
+  std::sort(samples.begin(), samples.end());
+
+  // Nearest rank percentile
+  auto percentile = [&](double p) {
+    size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * samples.size()));
+    return samples[std::clamp<size_t>(rank, 1, samples.size()) - 1];
+  };
+
+  summary.count = samples.size();
+  summary.mean = std::accumulate(samples.begin(), samples.end(), 0.0) /
+                 samples.size();
+  summary.p50 = percentile(50);
+  summary.p95 = percentile(95);
+  summary.p99 = percentile(99);
+  summary.max = samples.back();
+  return summary;
+}
+
+const char *
+Benchmark::pipelineCacheState(const VulkanStuff::VulkanRenderer &renderer) {
+  return renderer.vulkanDevice.pipelineCache->loadedFromDisk ? "warm"
+                                                             : "cold";
+}
+
+const char *Benchmark::renderPath(const VulkanStuff::VulkanRenderer &renderer) {
+  return renderer.vulkanDevice.dynamicRendering ? "dynamic_rendering"
+                                                : "render_pass";
+}
+
+void Benchmark::report(const VulkanStuff::VulkanRenderer &renderer) {
+  std::vector<std::string> names = {
+      "cpu_frame", "gpu_frame", "frame_wait",    "acquire",
+      "submit",    "present",   "latency_bound", "record"};
+  std::vector<std::vector<double>> samples(names.size());
+
+  for (const BenchmarkFrame &frame : frames) {
+    samples[0].push_back(frame.cpuMs);
+    if (frame.stats.gpuValid) {
+      samples[1].push_back(frame.stats.gpuMs);
+    }
+    samples[2].push_back(frame.stats.frameWaitMs);
+    samples[3].push_back(frame.stats.acquireMs);
+    samples[4].push_back(frame.stats.submitMs);
+    samples[5].push_back(frame.stats.presentMs);
+    if (frame.stats.latencyValid) {
+      samples[6].push_back(frame.stats.latencyBoundMs);
+    }
+    samples[7].push_back(frame.stats.recordMs);
+  }
+
+  std::vector<MetricSummary> summaries;
+  for (const std::vector<double> &metricSamples : samples) {
+    summaries.push_back(summarize(metricSamples));
+  }
+
+  std::cout << "=======================================\n";
+  std::cout << "Benchmark results (ms) on " << renderer.vulkanDevice.deviceName
+            << ", " << frames.size() << " frames, " << skippedFrames
+            << " skipped\n";
+  std::cout << std::left << std::setw(14) << "metric" << std::right
+            << std::setw(10) << "mean" << std::setw(10) << "p50"
+            << std::setw(10) << "p95" << std::setw(10) << "p99"
+            << std::setw(10) << "max" << "\n";
+  std::cout << std::fixed << std::setprecision(3);
+  for (size_t i = 0; i < names.size(); i++) {
+    std::cout << std::left << std::setw(14) << names[i] << std::right
+              << std::setw(10) << summaries[i].mean << std::setw(10)
+              << summaries[i].p50 << std::setw(10) << summaries[i].p95
+              << std::setw(10) << summaries[i].p99 << std::setw(10)
+              << summaries[i].max << "\n";
+  }
+  // Run twice to compare, the first run of a build starts cold
+  std::cout << "pipeline creation at startup "
+            << renderer.vulkanPipeline->startupCreateMs << " ("
+            << pipelineCacheState(renderer) << " pipeline cache)\n";
+  // Run once per mode to pick the tradeoff, latency is input to present
+  // only with present wait. Frames are polled for completion once per
+  // frame, so it is an upper bound up to a frame interval high
+  std::cout << "present mode "
+            << Utils::presentModeName(renderer.vulkanSwapChain.presentMode)
+            << ", " << renderer.vulkanSwapChain.imageCount
+            << " swapchain images, low latency "
+            << (renderer.lowLatency ? "on" : "off") << ", latency_bound to "
+            << renderer.latencySource()
+            << ", an upper bound polled once per frame\n";
+  // Run with and without --dynamic-rendering to compare the record times
+  std::cout << "render path " << renderPath(renderer) << "\n";
+  std::cout << std::defaultfloat;
+  std::cout << "=======================================\n";
+
+  writeJson(renderer, names, summaries);
+  writeCsv();
+}
+
+void Benchmark::writeJson(const VulkanStuff::VulkanRenderer &renderer,
+                          const std::vector<std::string> &names,
+                          const std::vector<MetricSummary> &summaries) {
+  std::string filePath = settings.outputPath + ".json";
+  std::ofstream file{filePath};
+  if (!file.is_open()) {
+    throw std::runtime_error("Failed to open file: " + filePath);
+  }
+
+  // Device names are plain ASCII, escaping quotes and backslashes is enough
+  std::string deviceName;
+  for (char c : renderer.vulkanDevice.deviceName) {
+    if (c == '"' || c == '\\') {
+      deviceName += '\\';
+    }
+    deviceName += c;
+  }
+
+  file << "{\n";
+  file << "  \"device\": \"" << deviceName << "\",\n";
+  file << "  \"headless\": "
+       << (renderer.vulkanSwapChain.headless ? "true" : "false") << ",\n";
+  file << "  \"width\": " << renderer.vulkanSwapChain.swapChainExtent.width
+       << ",\n";
+  file << "  \"height\": " << renderer.vulkanSwapChain.swapChainExtent.height
+       << ",\n";
+  file << "  \"frames_in_flight\": " << renderer.framesInFlight << ",\n";
+  file << "  \"present_mode\": \""
+       << Utils::presentModeName(renderer.vulkanSwapChain.presentMode)
+       << "\",\n";
+  file << "  \"swapchain_images\": " << renderer.vulkanSwapChain.imageCount
+       << ",\n";
+  file << "  \"low_latency\": " << (renderer.lowLatency ? "true" : "false")
+       << ",\n";
+  file << "  \"latency_source\": \"" << renderer.latencySource() << "\",\n";
+  file << "  \"latency_measurement\": \"upper_bound_polled_per_frame\",\n";
+  file << "  \"render_path\": \"" << renderPath(renderer) << "\",\n";
+  file << "  \"msaa_samples\": " << renderer.vulkanDevice.msaaSamples << ",\n";
+  file << "  \"warmup_frames\": " << settings.warmupFrames << ",\n";
+  file << "  \"measured_frames\": " << frames.size() << ",\n";
+  file << "  \"skipped_frames\": " << skippedFrames << ",\n";
+  file << "  \"pipeline_cache\": \"" << pipelineCacheState(renderer)
+       << "\",\n";
+  file << "  \"pipeline_create_ms\": " << std::fixed << std::setprecision(6)
+       << renderer.vulkanPipeline->startupCreateMs << ",\n";
+  file << "  \"metrics_ms\": {\n";
+  file << std::fixed << std::setprecision(6);
+  for (size_t i = 0; i < names.size(); i++) {
+    const MetricSummary &summary = summaries[i];
+    file << "    \"" << names[i] << "\": {\"count\": " << summary.count
+         << ", \"mean\": " << summary.mean << ", \"p50\": " << summary.p50
+         << ", \"p95\": " << summary.p95 << ", \"p99\": " << summary.p99
+         << ", \"max\": " << summary.max << "}"
+         << (i + 1 < names.size() ? "," : "") << "\n";
+  }
+  file << "  }\n";
+  file << "}\n";
+
+  std::cout << "Wrote " << filePath << "\n";
+}
+
+void Benchmark::writeCsv() {
+  std::string filePath = settings.outputPath + ".csv";
+  std::ofstream file{filePath};
+  if (!file.is_open()) {
+    throw std::runtime_error("Failed to open file: " + filePath);
+  }
+
+  // One row per measured frame, gpu_frame is empty until a result is back
+  // and latency_bound in frames that saw no earlier frame complete
+  file << "frame,cpu_frame,gpu_frame,frame_wait,acquire,submit,present,"
+          "latency_bound,record\n";
+  file << std::fixed << std::setprecision(6);
+  for (size_t i = 0; i < frames.size(); i++) {
+    const BenchmarkFrame &frame = frames[i];
+    file << i << "," << frame.cpuMs << ",";
+    if (frame.stats.gpuValid) {
+      file << frame.stats.gpuMs;
+    }
+    file << "," << frame.stats.frameWaitMs << "," << frame.stats.acquireMs
+         << "," << frame.stats.submitMs << "," << frame.stats.presentMs
+         << ",";
+    if (frame.stats.latencyValid) {
+      file << frame.stats.latencyBoundMs;
+    }
+    file << "," << frame.stats.recordMs << "\n";
+  }
+
+  std::cout << "Wrote " << filePath << "\n";
+}
+} // namespace GameEngine
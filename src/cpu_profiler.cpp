@@ -0,0 +1,130 @@
+#include <cpu_profiler.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace Utils {
+
+// Buffers are never freed, so a thread that exits still shows up in the
+// trace and its thread_local pointer can't dangle
+static std::mutex profileRegistryMutex;
+static std::vector<std::unique_ptr<ProfileThreadBuffer>> profileRegistry;
+
+// Pair of tick and steady_clock readings taken at startup, the export takes
+// a second pair to get the tick rate
+struct ProfileClockSample {
+  uint64_t ticks;
+  std::chrono::steady_clock::time_point time;
+};
+
+static ProfileClockSample sampleProfileClock() {
+  return {profileNowTicks(), std::chrono::steady_clock::now()};
+}
+
+static const ProfileClockSample profileEpoch = sampleProfileClock();
+
+ProfileThreadBuffer *registerProfileThread() {
+  std::lock_guard<std::mutex> lock(profileRegistryMutex);
+
+  profileRegistry.push_back(std::make_unique<ProfileThreadBuffer>());
+  ProfileThreadBuffer *buffer = profileRegistry.back().get();
+  buffer->threadIndex = static_cast<uint32_t>(profileRegistry.size());
+  buffer->threadName = "thread " + std::to_string(buffer->threadIndex);
+  return buffer;
+}
+
+void setProfileThreadName(const std::string &name) {
+  ProfileThreadBuffer *buffer = getProfileThreadBuffer();
+  std::lock_guard<std::mutex> lock(profileRegistryMutex);
+  buffer->threadName = name;
+}
+
+// Zone names are identifiers and literals, but keep the JSON valid anyway
+static void writeJsonString(std::ofstream &file, const std::string &value) {
+  file << '"';
+  for (char c : value) {
+    if (c == '"' || c == '\\') {
+      file << '\\' << c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      file << ' ';
+    } else {
+      file << c;
+    }
+  }
+  file << '"';
+}
+
+void writeChromeTrace(const std::string &filePath) {
+  std::ofstream file{filePath};
+  if (!file.is_open()) {
+    throw std::runtime_error("Failed to open file: " + filePath);
+  }
+
+  std::lock_guard<std::mutex> lock(profileRegistryMutex);
+
+  double nsPerTick = 1.0;
+#if PROFILE_USE_TSC
+  ProfileClockSample now = sampleProfileClock();
+  double elapsedNs = std::chrono::duration<double, std::nano>(
+                         now.time - profileEpoch.time)
+                         .count();
+  if (now.ticks > profileEpoch.ticks && elapsedNs > 0) {
+    nsPerTick = elapsedNs / (now.ticks - profileEpoch.ticks);
+  }
+#endif
+  // Zones from static initializers that ran before the epoch clamp to 0
+  auto toNs = [&](uint64_t ticks) -> uint64_t {
+    if (ticks <= profileEpoch.ticks) {
+      return 0;
+    }
+    return static_cast<uint64_t>((ticks - profileEpoch.ticks) * nsPerTick);
+  };
+
+  size_t eventCount = 0;
+  bool first = true;
+  file << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+
+  for (const std::unique_ptr<ProfileThreadBuffer> &buffer : profileRegistry) {
+    if (!first) {
+      file << ",\n";
+    }
+    first = false;
+    file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+         << buffer->threadIndex << ",\"args\":{\"name\":";
+    writeJsonString(file, buffer->threadName);
+    file << "}}";
+
+    // Only the newest CAPACITY events survive in the ring
+    uint64_t end = buffer->writeIndex.load(std::memory_order_acquire);
+    uint64_t begin =
+        end > ProfileThreadBuffer::CAPACITY ? end - ProfileThreadBuffer::CAPACITY
+                                            : 0;
+
+    for (uint64_t i = begin; i < end; i++) {
+      const ProfileEvent &event =
+          buffer->events[i & (ProfileThreadBuffer::CAPACITY - 1)];
+      uint64_t startNs = toNs(event.startTicks);
+      uint64_t endNs = std::max(startNs, toNs(event.endTicks));
+
+      // Chrome trace timestamps are microseconds, keep the ns as decimals
+      file << ",\n{\"name\":";
+      writeJsonString(file, event.name);
+      file << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->threadIndex
+           << ",\"ts\":" << startNs / 1000 << "." << std::setfill('0')
+           << std::setw(3) << startNs % 1000 << ",\"dur\":"
+           << (endNs - startNs) / 1000 << "." << std::setw(3)
+           << (endNs - startNs) % 1000 << std::setfill(' ') << "}";
+      eventCount++;
+    }
+  }
+  file << "\n]}\n";
+
+  std::cout << "Wrote " << eventCount << " profile zones to " << filePath
+            << "\n";
+}
+} // namespace Utils
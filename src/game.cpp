@@ -1,148 +1,196 @@
 #include "game.hpp"
 
 namespace GameEngine {
-Game::Game() {
-  if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_EVENTS) < 0) {
-    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Couldn't initialize SDL: %s",
-                 SDL_GetError());
+Game::Game(GameSettings settings)
+    : headless{settings.renderer.headless}, frameCount{settings.frameCount},
+      screenshotPath{settings.screenshotPath} {
+  PROFILE_FUNCTION();
+  Utils::setProfileThreadName("main");
+  window = nullptr;
+
+  uint32_t jobThreads = settings.jobThreads;
+  if (jobThreads == 0) {
+    jobThreads = std::max(std::thread::hardware_concurrency(), 1u);
   }
+  jobSystem = new Utils::JobSystem(jobThreads);
+  std::cout << "Job system threads: " << jobSystem->threadCount() << "\n";
+
+  // Headless runs on machines without a display, so don't touch SDL video
+  if (!headless) {
+    if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_EVENTS) < 0) {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Couldn't initialize SDL: %s",
+                   SDL_GetError());
+    }
+
+    window = SDL_CreateWindow("SDL Vulkan Sample", SDL_WINDOWPOS_CENTERED,
+                              SDL_WINDOWPOS_CENTERED, Utils::WIDTH,
+                              Utils::HEIGHT,
+                              SDL_WINDOW_VULKAN | SDL_WINDOW_RESIZABLE);
+  } else {
+    std::cout << "Running headless\n";
+  }
+
+  vulkanRenderer =
+      new VulkanStuff::VulkanRenderer(window, settings.renderer, jobSystem);
 
-  window = SDL_CreateWindow("SDL Vulkan Sample", SDL_WINDOWPOS_CENTERED,
-                            SDL_WINDOWPOS_CENTERED, Utils::WIDTH, Utils::HEIGHT,
-                            SDL_WINDOW_VULKAN | SDL_WINDOW_RESIZABLE);
+  benchmark = nullptr;
+  if (settings.benchmark.enabled) {
+    benchmark = new Benchmark(settings.benchmark);
+    frameCount = benchmark->totalFrames();
+  }
 
-  vulkanRenderer = new VulkanStuff::VulkanRenderer(window);
+  inputEvents.subscribe(inputEventBit(InputEventType::Quit),
+                        [this](const InputEvent &) { isRunning = false; });
+  inputEvents.subscribe(inputEventBit(InputEventType::KeyDown),
+                        [this](const InputEvent &event) { onKeyDown(event); });
+  inputEvents.subscribe(inputEventBit(InputEventType::WindowResized),
+                        [this](const InputEvent &) {
+                          vulkanRenderer->requestResize();
+                        });
 
   isRunning = true;
 }
 
 Game::~Game() {
+  delete benchmark;
   delete vulkanRenderer;
-  SDL_DestroyWindow(window);
+  delete jobSystem;
+  if (window != nullptr) {
+    SDL_DestroyWindow(window);
+  }
   SDL_Quit();
 }
 
 void Game::run() {
 
-  SDL_Event event;
+  uint32_t framesDrawn = 0;
 
-  //vulkanRenderer->resetQueryPool();
   while (isRunning) {
-    std::string event = getEvent();
-    // std::cout << "Eventer: " << event << "\n";
+    PROFILE_ZONE("frame");
+    auto frameStart = std::chrono::steady_clock::now();
+
+    // SDL and anything else queued for the main thread
+    jobSystem->runMainThreadJobs();
+    vulkanRenderer->waitBeforeInput();
+    if (!headless) {
+      processInput();
+    }
+
+    if (benchmark != nullptr) {
+      vulkanRenderer->rotation = benchmark->rotationForFrame(framesDrawn);
+    }
+
     vulkanRenderer->drawFrame(0);
+
+    if (benchmark != nullptr) {
+      benchmark->addFrame(
+          std::chrono::duration<double, std::milli>(
+              std::chrono::steady_clock::now() - frameStart)
+              .count(),
+          vulkanRenderer->lastFrameStats);
+    }
+
+    framesDrawn++;
+    if (frameCount != 0 && framesDrawn >= frameCount) {
+      isRunning = false;
+    }
     //vulkanRenderer->drawFrame(1);
 
-    // vulkanRenderer->getQueryPoolTimes();
 
    //exit(0);
 
     // SDL_Delay(10000);
     //   isRunning = false;
   }
+
+  if (benchmark != nullptr) {
+    if (benchmark->isFinished()) {
+      benchmark->report(*vulkanRenderer);
+    } else {
+      std::cout << "Benchmark stopped early, no results written\n";
+    }
+  }
+
+  if (!screenshotPath.empty()) {
+    vulkanRenderer->saveLastFrame(screenshotPath);
+  }
 }
 
-std::string Game::getEvent() {
-  std::string eventName = "NONE";
-  // Poll for events. SDL_PollEvent() returns 0 when there are no
-  // more events on the event queue, our while loop will exit when
-  // that occurs.
-
-  SDL_Event event;
-  while (SDL_PollEvent(&event)) {
-    switch (event.type) {
-    case SDL_KEYDOWN:
-
-      // Check the SDLKey values and move change the coords
-      switch (event.key.keysym.sym) {
-      case SDLK_ESCAPE:
-        eventName = "EXIT";
-        isRunning = false;
-        break;
-      case SDLK_LEFT:
-        eventName = "MOVE_LEFT";
-        break;
-      case SDLK_RIGHT:
-        eventName = "MOVE_RIGHT";
-        break;
-      case SDLK_UP:
-        eventName = "MOVE_UP";
-        break;
-      case SDLK_DOWN:
-        eventName = "MOVE_DOWN";
-        break;
-      case SDLK_e: {
-        eventName = "KEY_E";
-        std::cout << "Event: " << eventName << "\n";
-
-        // std::vector<Utils::Vertex> vertices = {
-        //     {{0.5f, -0.5f}, {1.0f, 0.0f, 0.0f}},
-        //     {{0.5f, 0.5f}, {0.0f, 1.0f, 0.0f}},
-        //     {{-0.5f, 0.5f}, {0.0f, 0.0f, 1.0f}}};
-
-        // vulkanRenderer->recreateVertexBuffer(vertices);
-        break;
-      }
-      case SDLK_q: {
-        eventName = "KEY_Q";
-        std::cout << "Event: " << eventName << "\n";
-
-        // std::vector<Utils::Vertex> vertices = {
-        //     {{-0.5f, -0.5f}, {1.0f, 0.0f, 0.0f}},
-        //     {{0.5f, 0.5f}, {0.0f, 1.0f, 0.0f}},
-        //     {{-0.5f, 0.5f}, {0.0f, 0.0f, 1.0f}}};
-
-        // vulkanRenderer->recreateVertexBuffer(vertices);
-        break;
-      }
-
-      case SDLK_w: {
-        eventName = "KEY_W";
-        std::cout << "Event: " << eventName << "\n";
-        vulkanRenderer->rotation += 0.01;
-        break;
-      }
-      case SDLK_s: {
-        eventName = "KEY_S";
-        std::cout << "Event: " << eventName << "\n";
-        vulkanRenderer->rotation -= 0.01;
-        break;
-      }
-      case SDLK_c: {
-        eventName = "KEY_C";
-        std::cout << "Event: " << eventName << "\n";
-        vulkanRenderer->clearColorImage();
-        break;
-      }
-      default:
-        eventName = "KEY_DOWN";
-        break;
-      }
-      break;
+void Game::processInput() {
+  PROFILE_FUNCTION();
+  inputEvents.poll();
+  inputEvents.dispatch();
 
-    case SDL_KEYUP:
-      eventName = "KEY_UP";
-      break;
+  if (pendingRotation != 0) {
+    vulkanRenderer->rotation += pendingRotation;
+    pendingRotation = 0;
+  }
+}
 
-    case SDL_MOUSEBUTTONDOWN:
-      eventName = "MOUSE_DOWN";
+void Game::onKeyDown(const InputEvent &event) {
+  switch (event.key) {
+  case SDLK_ESCAPE:
+    isRunning = false;
+    break;
+  case SDLK_w:
+    pendingRotation += 0.01f;
+    break;
+  case SDLK_s:
+    pendingRotation -= 0.01f;
+    break;
+  case SDLK_c:
+    vulkanRenderer->clearColorImage();
+    break;
+  case SDLK_F1:
+    vulkanRenderer->vulkanProfiler->printReport();
+    break;
+  // Number keys pick how many frames can be in flight. Low latency mode
+  // owns that and the swapchain depth until it is switched off
+  case SDLK_1:
+  case SDLK_2:
+  case SDLK_3:
+  case SDLK_4:
+    if (vulkanRenderer->lowLatency) {
+      std::cout << "Frames in flight are fixed in low latency mode\n";
       break;
-
-    case SDL_MOUSEBUTTONUP:
-      eventName = "MOUSE_UP";
+    }
+    vulkanRenderer->setFramesInFlight(event.key - SDLK_1 + 1);
+    break;
+  // F5 to F8 switch the present mode, L toggles low latency and the
+  // brackets change the swapchain depth
+  case SDLK_F5:
+    vulkanRenderer->setPresentMode(VK_PRESENT_MODE_IMMEDIATE_KHR);
+    break;
+  case SDLK_F6:
+    vulkanRenderer->setPresentMode(VK_PRESENT_MODE_MAILBOX_KHR);
+    break;
+  case SDLK_F7:
+    vulkanRenderer->setPresentMode(VK_PRESENT_MODE_FIFO_KHR);
+    break;
+  case SDLK_F8:
+    vulkanRenderer->setPresentMode(VK_PRESENT_MODE_FIFO_RELAXED_KHR);
+    break;
+  case SDLK_l:
+    vulkanRenderer->setLowLatency(!vulkanRenderer->lowLatency);
+    break;
+  case SDLK_LEFTBRACKET:
+    if (vulkanRenderer->lowLatency) {
+      std::cout << "Swapchain images are fixed in low latency mode\n";
       break;
-
-    case SDL_QUIT:
-      eventName = "EXIT";
-      isRunning = false;
-
-    default:
+    }
+    vulkanRenderer->setSwapchainImageCount(
+        std::max(vulkanRenderer->vulkanSwapChain.imageCount, 2u) - 1);
+    break;
+  case SDLK_RIGHTBRACKET:
+    if (vulkanRenderer->lowLatency) {
+      std::cout << "Swapchain images are fixed in low latency mode\n";
       break;
     }
+    vulkanRenderer->setSwapchainImageCount(
+        vulkanRenderer->vulkanSwapChain.imageCount + 1);
+    break;
+  default:
+    break;
   }
-
-  // std::cout << "Event: " << eventName << "\n";
-
-  return eventName;
 }
 } // namespace GameEngine
\ No newline at end of file
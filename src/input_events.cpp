@@ -0,0 +1,83 @@
+#include <input_events.hpp>
+
+#include <cpu_profiler.hpp>
+
+namespace GameEngine {
+
+void InputEventQueue::subscribe(uint32_t typeMask, Callback callback) {
+  subscribers.push_back({typeMask, std::move(callback)});
+}
+
+void InputEventQueue::push(const InputEvent &event) {
+  if (eventCount == CAPACITY) {
+    droppedEvents++;
+    return;
+  }
+  events[eventCount++] = event;
+}
+
+void InputEventQueue::poll() {
+  PROFILE_FUNCTION();
+  eventCount = 0;
+
+  SDL_Event sdlEvent;
+  while (SDL_PollEvent(&sdlEvent)) {
+    InputEvent event{};
+    event.timestampNs = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+
+    switch (sdlEvent.type) {
+    case SDL_QUIT:
+      event.type = InputEventType::Quit;
+      break;
+
+    case SDL_KEYDOWN:
+    case SDL_KEYUP:
+      event.type = sdlEvent.type == SDL_KEYDOWN ? InputEventType::KeyDown
+                                                : InputEventType::KeyUp;
+      event.key = sdlEvent.key.keysym.sym;
+      event.modifiers = sdlEvent.key.keysym.mod;
+      event.repeat = sdlEvent.key.repeat != 0;
+      break;
+
+    case SDL_MOUSEBUTTONDOWN:
+    case SDL_MOUSEBUTTONUP:
+      event.type = sdlEvent.type == SDL_MOUSEBUTTONDOWN
+                       ? InputEventType::MouseButtonDown
+                       : InputEventType::MouseButtonUp;
+      event.mouseButton = sdlEvent.button.button;
+      event.x = sdlEvent.button.x;
+      event.y = sdlEvent.button.y;
+      break;
+
+    case SDL_WINDOWEVENT:
+      if (sdlEvent.window.event != SDL_WINDOWEVENT_SIZE_CHANGED) {
+        continue;
+      }
+      event.type = InputEventType::WindowResized;
+      event.x = sdlEvent.window.data1;
+      event.y = sdlEvent.window.data2;
+      break;
+
+    default:
+      continue;
+    }
+
+    push(event);
+  }
+}
+
+void InputEventQueue::dispatch() const {
+  PROFILE_FUNCTION();
+  for (const InputEvent &event : *this) {
+    uint32_t bit = inputEventBit(event.type);
+    for (const Subscriber &subscriber : subscribers) {
+      if (subscriber.typeMask & bit) {
+        subscriber.callback(event);
+      }
+    }
+  }
+}
+} // namespace GameEngine
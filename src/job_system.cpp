@@ -0,0 +1,290 @@
+#include <job_system.hpp>
+
+#include <cpu_profiler.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+
+namespace Utils {
+
+// Which JobSystem thread the calling thread is, if any
+static thread_local const JobSystem *currentJobSystem = nullptr;
+static thread_local uint32_t currentJobThread = 0;
+
+// Keeps the first exception for the job's counter. Anything the counter
+// can't hand to a wait() is only logged
+static void logJobError(std::exception_ptr error, JobCounter *counter) {
+  if (counter != nullptr) {
+    std::lock_guard<std::mutex> lock(counter->errorMutex);
+    if (!counter->error) {
+      counter->error = error;
+      return;
+    }
+  }
+  try {
+    std::rethrow_exception(error);
+  } catch (const std::exception &exception) {
+    std::cout << "Job failed: " << exception.what() << "\n";
+  } catch (...) {
+    std::cout << "Job failed\n";
+  }
+}
+
+// Idle rounds a worker spins through before going to sleep, keeps the
+// latency low when jobs arrive back to back within a frame
+static constexpr uint32_t IDLE_SPINS = 64;
+
+JobSystem::JobSystem(uint32_t threadCount) {
+  threadCount = std::max(threadCount, 1u);
+  for (uint32_t i = 0; i < threadCount; i++) {
+    queues.push_back(new JobQueue());
+  }
+
+  currentJobSystem = this;
+  currentJobThread = 0;
+
+  for (uint32_t i = 1; i < threadCount; i++) {
+    threads.emplace_back(&JobSystem::workerLoop, this, i);
+  }
+}
+
+JobSystem::~JobSystem() {
+  {
+    std::lock_guard<std::mutex> lock(sleepMutex);
+    stopping = true;
+  }
+  wakeUp.notify_all();
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  for (JobQueue *queue : queues) {
+    delete queue;
+  }
+  if (currentJobSystem == this) {
+    currentJobSystem = nullptr;
+  }
+}
+
+uint32_t JobSystem::currentThreadIndex() const {
+  return currentJobSystem == this ? currentJobThread : threadCount();
+}
+
+void JobSystem::submit(const Job &job) {
+  if (job.counter != nullptr) {
+    job.counter->pending.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // Outside threads spread their jobs over the queues
+  uint32_t threadIndex = currentThreadIndex();
+  if (threadIndex == threadCount()) {
+    static std::atomic<uint32_t> nextQueue{0};
+    threadIndex = nextQueue.fetch_add(1, std::memory_order_relaxed) %
+                  threadCount();
+  }
+
+  JobQueue *queue = queues[threadIndex];
+  {
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    queue->jobs.push_back(job);
+  }
+  // Pairs with the sleepingWorkers increment in workerLoop, either the
+  // worker sees the job or this sees the sleeper
+  queuedJobs.fetch_add(1);
+  if (sleepingWorkers.load() > 0) {
+    { std::lock_guard<std::mutex> lock(sleepMutex); }
+    wakeUp.notify_one();
+  }
+}
+
+void JobSystem::submitToMainThread(const Job &job) {
+  if (job.counter != nullptr) {
+    job.counter->pending.fetch_add(1, std::memory_order_relaxed);
+  }
+  std::lock_guard<std::mutex> lock(mainThreadQueue.mutex);
+  mainThreadQueue.jobs.push_back(job);
+}
+
+void JobSystem::execute(const Job &job) {
+  try {
+    job.function(job.data, job.begin, job.end);
+  } catch (...) {
+    logJobError(std::current_exception(), job.counter);
+  }
+  if (job.counter != nullptr) {
+    job.counter->pending.fetch_sub(1, std::memory_order_release);
+  }
+}
+
+bool JobSystem::popJob(JobQueue &queue, Job &job, bool fromBack) {
+  std::lock_guard<std::mutex> lock(queue.mutex);
+  if (queue.jobs.empty()) {
+    return false;
+  }
+  if (fromBack) {
+    job = queue.jobs.back();
+    queue.jobs.pop_back();
+  } else {
+    job = queue.jobs.front();
+    queue.jobs.pop_front();
+  }
+  return true;
+}
+
+bool JobSystem::findJob(uint32_t threadIndex, Job &job) {
+  uint32_t count = threadCount();
+  if (threadIndex < count && popJob(*queues[threadIndex], job, true)) {
+    queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+  }
+  if (threadIndex == 0 && popJob(mainThreadQueue, job, false)) {
+    return true;
+  }
+  // Oldest jobs of the other queues first, those tend to be the biggest
+  for (uint32_t i = 1; i < count; i++) {
+    uint32_t victim = (threadIndex + i) % count;
+    if (popJob(*queues[victim], job, false)) {
+      queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+      return true;
+    }
+  }
+  return false;
+}
+
+void JobSystem::wait(JobCounter &counter) {
+  uint32_t threadIndex = currentThreadIndex();
+  Job job;
+  while (!counter.isDone()) {
+    if (findJob(threadIndex, job)) {
+      execute(job);
+    } else {
+      std::this_thread::yield();
+    }
+  }
+
+  std::exception_ptr error;
+  {
+    std::lock_guard<std::mutex> lock(counter.errorMutex);
+    std::swap(error, counter.error);
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+void JobSystem::runMainThreadJobs() {
+  Job job;
+  while (popJob(mainThreadQueue, job, false)) {
+    execute(job);
+  }
+}
+
+void JobSystem::workerLoop(uint32_t threadIndex) {
+  currentJobSystem = this;
+  currentJobThread = threadIndex;
+  setProfileThreadName("job worker " + std::to_string(threadIndex));
+
+  Job job;
+  uint32_t idleSpins = 0;
+  while (!stopping.load(std::memory_order_relaxed)) {
+    if (findJob(threadIndex, job)) {
+      execute(job);
+      idleSpins = 0;
+      continue;
+    }
+    if (++idleSpins < IDLE_SPINS) {
+      std::this_thread::yield();
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(sleepMutex);
+    sleepingWorkers.fetch_add(1);
+    wakeUp.wait(lock, [this] {
+      return stopping.load() || queuedJobs.load() > 0;
+    });
+    sleepingWorkers.fetch_sub(1);
+    idleSpins = 0;
+  }
+}
+
+//==============================================
+// --job-benchmark
+//==============================================
+
+// Fixed amount of floating point work, big enough that scheduling isn't
+// what gets measured
+static float benchmarkWork(uint32_t index) {
+  float value = static_cast<float>(index);
+  for (int i = 0; i < 32; i++) {
+    value = std::sqrt(value * 1.0001f + 1.0f);
+  }
+  return value;
+}
+
+void runJobBenchmark(uint32_t maxThreads) {
+  using Clock = std::chrono::steady_clock;
+  using Milliseconds = std::chrono::duration<double, std::milli>;
+
+  const uint32_t emptyJobs = 100000;
+  const uint32_t workItems = 1 << 20;
+  const uint32_t grainSize = 1024;
+
+  std::vector<float> results(workItems);
+  std::vector<uint32_t> threadCounts;
+  for (uint32_t threads = 1; threads < maxThreads; threads *= 2) {
+    threadCounts.push_back(threads);
+  }
+  threadCounts.push_back(maxThreads);
+
+  std::cout << "Job system benchmark: " << emptyJobs << " empty jobs, "
+            << workItems << " work items in ranges of " << grainSize << "\n";
+  std::cout << std::setw(8) << "threads" << std::setw(16) << "ns/empty job"
+            << std::setw(16) << "parallelFor ms" << std::setw(10) << "speedup"
+            << std::setw(12) << "efficiency" << "\n";
+
+  double singleThreadMs = 0;
+  for (uint32_t threads : threadCounts) {
+    JobSystem jobs(threads);
+
+    // Submit and drain empty jobs, what a job costs on its own
+    JobCounter counter;
+    Job emptyJob{};
+    emptyJob.function = [](void *, uint32_t, uint32_t) {};
+    emptyJob.counter = &counter;
+    auto emptyStart = Clock::now();
+    for (uint32_t i = 0; i < emptyJobs; i++) {
+      jobs.submit(emptyJob);
+    }
+    jobs.wait(counter);
+    double emptyNs =
+        std::chrono::duration<double, std::nano>(Clock::now() - emptyStart)
+            .count() /
+        emptyJobs;
+
+    // Best of a few runs, the first one also wakes the workers up
+    double bestMs = 0;
+    for (int run = 0; run < 5; run++) {
+      auto start = Clock::now();
+      jobs.parallelFor(workItems, grainSize, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) {
+          results[i] = benchmarkWork(i);
+        }
+      });
+      double ms = Milliseconds(Clock::now() - start).count();
+      bestMs = run == 0 ? ms : std::min(bestMs, ms);
+    }
+    if (threads == 1) {
+      singleThreadMs = bestMs;
+    }
+
+    double speedup = singleThreadMs / bestMs;
+    std::cout << std::fixed << std::setprecision(2) << std::setw(8) << threads
+              << std::setw(16) << emptyNs << std::setw(16) << bestMs
+              << std::setw(10) << speedup << std::setw(11)
+              << speedup / threads * 100 << "%\n";
+  }
+  std::cout.unsetf(std::ios::fixed);
+}
+} // namespace Utils
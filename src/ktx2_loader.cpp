@@ -0,0 +1,113 @@
+#include <ktx2_loader.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include <texture_formats.hpp>
+#include <utils.hpp>
+
+namespace Utils {
+
+static const uint8_t KTX2_IDENTIFIER[12] = {0xAB, 'K',  'T',  'X',
+                                            ' ',  '2',  '0',  0xBB,
+                                            '\r', '\n', 0x1A, '\n'};
+// Identifier, nine 32 bit header fields, then the 32 and 64 bit offsets and
+// lengths of the data format descriptor, key/values and supercompression
+// data
+static constexpr size_t KTX2_HEADER_SIZE = 80;
+static constexpr size_t KTX2_LEVEL_INDEX_ENTRY_SIZE = 24;
+
+static uint64_t readLittleEndian(const std::vector<char> &file, size_t offset,
+                                 uint32_t bytes) {
+  uint64_t value = 0;
+  for (uint32_t i = 0; i < bytes; i++) {
+    value |= static_cast<uint64_t>(static_cast<uint8_t>(file[offset + i]))
+             << (8 * i);
+  }
+  return value;
+}
+
+bool isKtx2Path(const std::string &path) {
+  const std::string extension = ".ktx2";
+  return path.size() >= extension.size() &&
+         path.compare(path.size() - extension.size(), extension.size(),
+                      extension) == 0;
+}
+
+Ktx2Texture loadKtx2(const std::string &path) {
+  std::vector<char> file = readFile(path);
+  if (file.size() < KTX2_HEADER_SIZE ||
+      memcmp(file.data(), KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0) {
+    throw std::runtime_error("failed to load " + path + ", not a KTX2 file!");
+  }
+
+  Ktx2Texture texture;
+  texture.format = static_cast<VkFormat>(readLittleEndian(file, 12, 4));
+  texture.width = static_cast<uint32_t>(readLittleEndian(file, 20, 4));
+  texture.height = static_cast<uint32_t>(readLittleEndian(file, 24, 4));
+  uint32_t depth = static_cast<uint32_t>(readLittleEndian(file, 28, 4));
+  uint32_t layerCount = static_cast<uint32_t>(readLittleEndian(file, 32, 4));
+  uint32_t faceCount = static_cast<uint32_t>(readLittleEndian(file, 36, 4));
+  uint32_t levelCount = static_cast<uint32_t>(readLittleEndian(file, 40, 4));
+  uint32_t supercompression =
+      static_cast<uint32_t>(readLittleEndian(file, 44, 4));
+
+  // Basis Universal files have no Vulkan format and need a transcoder
+  TextureBlockInfo blockInfo;
+  if (texture.format == VK_FORMAT_UNDEFINED ||
+      !getTextureBlockInfo(texture.format, blockInfo)) {
+    throw std::runtime_error("failed to load " + path +
+                             ", unsupported format!");
+  }
+  if (supercompression != 0) {
+    throw std::runtime_error("failed to load " + path +
+                             ", supercompression is not supported!");
+  }
+  if (texture.width == 0 || texture.height == 0 || depth > 1 ||
+      layerCount > 1 || faceCount != 1) {
+    throw std::runtime_error("failed to load " + path +
+                             ", only 2D textures are supported!");
+  }
+
+  // No levels means the loader should generate them, only level 0 is stored
+  texture.mipLevels = std::max(levelCount, 1u);
+  if (texture.mipLevels > mipLevelCount(texture.width, texture.height) ||
+      KTX2_HEADER_SIZE + texture.mipLevels * KTX2_LEVEL_INDEX_ENTRY_SIZE >
+          file.size()) {
+    throw std::runtime_error("failed to load " + path +
+                             ", broken level index!");
+  }
+
+  // The file stores the smallest level first, the level index is still
+  // ordered from level 0 down
+  VkDeviceSize totalSize = 0;
+  for (uint32_t level = 0; level < texture.mipLevels; level++) {
+    totalSize += textureLevelSize(texture.format,
+                                  std::max(texture.width >> level, 1u),
+                                  std::max(texture.height >> level, 1u));
+  }
+  texture.data.resize(static_cast<size_t>(totalSize));
+
+  VkDeviceSize offset = 0;
+  for (uint32_t level = 0; level < texture.mipLevels; level++) {
+    size_t entry = KTX2_HEADER_SIZE + level * KTX2_LEVEL_INDEX_ENTRY_SIZE;
+    uint64_t byteOffset = readLittleEndian(file, entry, 8);
+    uint64_t byteLength = readLittleEndian(file, entry + 8, 8);
+    VkDeviceSize levelSize = textureLevelSize(
+        texture.format, std::max(texture.width >> level, 1u),
+        std::max(texture.height >> level, 1u));
+    if (byteLength != levelSize || byteOffset > file.size() ||
+        byteLength > file.size() - byteOffset) {
+      throw std::runtime_error("failed to load " + path + ", broken level " +
+                               std::to_string(level) + "!");
+    }
+
+    memcpy(texture.data.data() + offset, file.data() + byteOffset,
+           static_cast<size_t>(levelSize));
+    texture.levelOffsets.push_back(offset);
+    offset += levelSize;
+  }
+  return texture;
+}
+} // namespace Utils
@@ -3,15 +3,109 @@
 int main(int argv, char **args) {
   std::cout << "Starting App Tho\n";
 
-  GameEngine::Game game;
+  GameEngine::GameSettings gameSettings{};
+  std::string tracePath;
+  bool jobBenchmark = false;
+  bool allocBenchmark = false;
 
-  try {
-    game.run();
-  } catch (const std::exception &e) {
+  for (int i = 1; i < argv; i++) {
+    std::string arg = args[i];
+    if (arg == "--frames-in-flight" && i + 1 < argv) {
+      gameSettings.renderer.framesInFlight =
+          static_cast<uint32_t>(std::atoi(args[++i]));
+    } else if (arg == "--record-threads" && i + 1 < argv) {
+      gameSettings.renderer.recordThreads =
+          static_cast<uint32_t>(std::atoi(args[++i]));
+    } else if (arg == "--job-threads" && i + 1 < argv) {
+      gameSettings.jobThreads = static_cast<uint32_t>(std::atoi(args[++i]));
+    } else if (arg == "--job-benchmark") {
+      jobBenchmark = true;
+    } else if (arg == "--alloc-benchmark") {
+      allocBenchmark = true;
+    } else if (arg == "--objects" && i + 1 < argv) {
+      gameSettings.renderer.objectCount =
+          static_cast<uint32_t>(std::atoi(args[++i]));
+    } else if (arg == "--present-mode" && i + 1 < argv) {
+      if (!Utils::parsePresentMode(args[++i],
+                                   gameSettings.renderer.presentMode)) {
+        std::cerr << "Unknown present mode: " << args[i]
+                  << ", expected immediate, mailbox, fifo or fifo_relaxed\n";
+      }
+    } else if (arg == "--swapchain-images" && i + 1 < argv) {
+      gameSettings.renderer.swapchainImages =
+          static_cast<uint32_t>(std::atoi(args[++i]));
+    } else if (arg == "--low-latency") {
+      gameSettings.renderer.lowLatency = true;
+    } else if (arg == "--dynamic-rendering") {
+      gameSettings.renderer.dynamicRendering = true;
+    } else if (arg == "--headless") {
+      gameSettings.renderer.headless = true;
+    } else if (arg == "--frames" && i + 1 < argv) {
+      gameSettings.frameCount = static_cast<uint32_t>(std::atoi(args[++i]));
+    } else if (arg == "--screenshot" && i + 1 < argv) {
+      gameSettings.screenshotPath = args[++i];
+    } else if (arg == "--benchmark") {
+      gameSettings.benchmark.enabled = true;
+    } else if (arg == "--warmup-frames" && i + 1 < argv) {
+      gameSettings.benchmark.warmupFrames =
+          static_cast<uint32_t>(std::atoi(args[++i]));
+    } else if (arg == "--benchmark-frames" && i + 1 < argv) {
+      gameSettings.benchmark.measuredFrames =
+          static_cast<uint32_t>(std::atoi(args[++i]));
+    } else if (arg == "--benchmark-output" && i + 1 < argv) {
+      gameSettings.benchmark.outputPath = args[++i];
+    } else if (arg == "--trace" && i + 1 < argv) {
+      tracePath = args[++i];
+    } else {
+      std::cerr << "Unknown argument: " << arg << "\n";
+    }
+  }
 
-    std::cerr << e.what() << '\n';
-    return EXIT_FAILURE;
+  // Needs neither a window nor a GPU
+  if (jobBenchmark) {
+    uint32_t threads = gameSettings.jobThreads;
+    if (threads == 0) {
+      threads = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    Utils::runJobBenchmark(threads);
+    return EXIT_SUCCESS;
   }
 
+  // Headless device, no window or swapchain needed
+  if (allocBenchmark) {
+    try {
+      VulkanStuff::VulkanDevice device(nullptr, false);
+      VulkanStuff::runAllocatorBenchmark(*device.allocator);
+    } catch (const std::exception &e) {
+      std::cerr << e.what() << '\n';
+      return EXIT_FAILURE;
+    }
     return EXIT_SUCCESS;
+  }
+
+  // Nothing can close a headless run, so give it an end
+  if (gameSettings.renderer.headless && gameSettings.frameCount == 0) {
+    gameSettings.frameCount = 1000;
+  }
+
+  int exitCode = EXIT_SUCCESS;
+  {
+    // Destroyed before the trace is written, which joins the job threads so
+    // nothing else writes to the profiler's rings any more
+    GameEngine::Game game(gameSettings);
+
+    try {
+      game.run();
+    } catch (const std::exception &e) {
+
+      std::cerr << e.what() << '\n';
+      exitCode = EXIT_FAILURE;
+    }
+  }
+
+  if (!tracePath.empty()) {
+    Utils::writeChromeTrace(tracePath);
+  }
+
+    return exitCode;
 }
\ No newline at end of file
@@ -0,0 +1,712 @@
+#include <texture_formats.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+namespace Utils {
+
+// Texels within a block are decoded row by row, 4x4 RGBA8
+typedef uint8_t BlockTexels[16][4];
+
+static uint8_t clampByte(int value) {
+  return static_cast<uint8_t>(std::min(std::max(value, 0), 255));
+}
+
+bool getTextureBlockInfo(VkFormat format, TextureBlockInfo &info) {
+  switch (format) {
+  case VK_FORMAT_R8G8B8A8_UNORM:
+  case VK_FORMAT_R8G8B8A8_SRGB:
+  case VK_FORMAT_A8B8G8R8_UNORM_PACK32:
+  case VK_FORMAT_A8B8G8R8_SRGB_PACK32:
+    info = {1, 1, 4, false};
+    return true;
+  case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+  case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+  case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+  case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+  case VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK:
+  case VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK:
+  case VK_FORMAT_ETC2_R8G8B8A1_UNORM_BLOCK:
+  case VK_FORMAT_ETC2_R8G8B8A1_SRGB_BLOCK:
+    info = {4, 4, 8, true};
+    return true;
+  case VK_FORMAT_BC7_UNORM_BLOCK:
+  case VK_FORMAT_BC7_SRGB_BLOCK:
+  case VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK:
+  case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK:
+    info = {4, 4, 16, true};
+    return true;
+  default:
+    return false;
+  }
+}
+
+bool isSrgbFormat(VkFormat format) {
+  switch (format) {
+  case VK_FORMAT_R8G8B8A8_SRGB:
+  case VK_FORMAT_A8B8G8R8_SRGB_PACK32:
+  case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+  case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+  case VK_FORMAT_BC7_SRGB_BLOCK:
+  case VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK:
+  case VK_FORMAT_ETC2_R8G8B8A1_SRGB_BLOCK:
+  case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK:
+    return true;
+  default:
+    return false;
+  }
+}
+
+VkDeviceSize textureLevelSize(VkFormat format, uint32_t width,
+                              uint32_t height) {
+  TextureBlockInfo info;
+  if (!getTextureBlockInfo(format, info)) {
+    throw std::runtime_error("failed to size texture level, unknown format!");
+  }
+  VkDeviceSize blocksWide = (width + info.width - 1) / info.width;
+  VkDeviceSize blocksHigh = (height + info.height - 1) / info.height;
+  return blocksWide * blocksHigh * info.bytes;
+}
+
+//===========================
+// BC1
+
+static void expandRGB565(uint16_t color, uint8_t *texel) {
+  uint32_t r = (color >> 11) & 31;
+  uint32_t g = (color >> 5) & 63;
+  uint32_t b = color & 31;
+  texel[0] = static_cast<uint8_t>((r << 3) | (r >> 2));
+  texel[1] = static_cast<uint8_t>((g << 2) | (g >> 4));
+  texel[2] = static_cast<uint8_t>((b << 3) | (b >> 2));
+  texel[3] = 255;
+}
+
+static void decodeBC1Block(const uint8_t *block, bool hasAlpha,
+                           BlockTexels texels) {
+  uint16_t color0 = static_cast<uint16_t>(block[0] | (block[1] << 8));
+  uint16_t color1 = static_cast<uint16_t>(block[2] | (block[3] << 8));
+
+  uint8_t palette[4][4];
+  expandRGB565(color0, palette[0]);
+  expandRGB565(color1, palette[1]);
+  for (uint32_t channel = 0; channel < 3; channel++) {
+    uint32_t a = palette[0][channel];
+    uint32_t b = palette[1][channel];
+    if (color0 > color1) {
+      palette[2][channel] = static_cast<uint8_t>((2 * a + b + 1) / 3);
+      palette[3][channel] = static_cast<uint8_t>((a + 2 * b + 1) / 3);
+    } else {
+      palette[2][channel] = static_cast<uint8_t>((a + b + 1) / 2);
+      palette[3][channel] = 0;
+    }
+  }
+  palette[2][3] = 255;
+  // Transparent black only in the three color mode of the RGBA formats
+  palette[3][3] = (color0 <= color1 && hasAlpha) ? 0 : 255;
+
+  uint32_t indices = block[4] | (block[5] << 8) | (block[6] << 16) |
+                     (static_cast<uint32_t>(block[7]) << 24);
+  for (uint32_t texel = 0; texel < 16; texel++) {
+    memcpy(texels[texel], palette[(indices >> (2 * texel)) & 3], 4);
+  }
+}
+
+//===========================
+// BC7
+
+struct BC7Mode {
+  uint8_t subsets;
+  uint8_t partitionBits;
+  uint8_t rotationBits;
+  uint8_t indexSelectionBits;
+  uint8_t colorBits;
+  uint8_t alphaBits;
+  // One p-bit per endpoint, or one shared by both endpoints of a subset
+  uint8_t endpointPBits;
+  uint8_t sharedPBits;
+  uint8_t indexBits;
+  uint8_t secondaryIndexBits;
+};
+
+static const BC7Mode BC7_MODES[8] = {
+    {3, 4, 0, 0, 4, 0, 1, 0, 3, 0}, {2, 6, 0, 0, 6, 0, 0, 1, 3, 0},
+    {3, 6, 0, 0, 5, 0, 0, 0, 2, 0}, {2, 6, 0, 0, 7, 0, 1, 0, 2, 0},
+    {1, 0, 2, 1, 5, 6, 0, 0, 2, 3}, {1, 0, 2, 0, 7, 8, 0, 0, 2, 2},
+    {1, 0, 0, 0, 7, 7, 1, 0, 4, 0}, {2, 6, 0, 0, 5, 5, 1, 0, 2, 0}};
+
+static const uint8_t BC7_PARTITIONS_2[64][16] = {
+    {0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1},
+    {0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1},
+    {0, 1, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1},
+    {0, 0, 0, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 1, 1, 1},
+    {0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 1, 1},
+    {0, 0, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1, 1, 1, 1, 1},
+    {0, 0, 0, 1, 0, 0, 1, 1, 0, 1, 1, 1, 1, 1, 1, 1},
+    {0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 1, 0, 1, 1, 1},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 1},
+    {0, 0, 1, 1, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1},
+    {0, 0, 0, 0, 0, 0, 0, 1, 0, 1, 1, 1, 1, 1, 1, 1},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 1, 1, 1},
+    {0, 0, 0, 1, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1},
+    {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1},
+    {0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1},
+    {0, 0, 0, 0, 1, 0, 0, 0, 1, 1, 1, 0, 1, 1, 1, 1},
+    {0, 1, 1, 1, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 1, 1, 1, 0},
+    {0, 1, 1, 1, 0, 0, 1, 1, 0, 0, 0, 1, 0, 0, 0, 0},
+    {0, 0, 1, 1, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0},
+    {0, 0, 0, 0, 1, 0, 0, 0, 1, 1, 0, 0, 1, 1, 1, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 1, 1, 0, 0},
+    {0, 1, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 0, 1},
+    {0, 0, 1, 1, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 0},
+    {0, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 1, 0, 0},
+    {0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0},
+    {0, 0, 1, 1, 0, 1, 1, 0, 0, 1, 1, 0, 1, 1, 0, 0},
+    {0, 0, 0, 1, 0, 1, 1, 1, 1, 1, 1, 0, 1, 0, 0, 0},
+    {0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0},
+    {0, 1, 1, 1, 0, 0, 0, 1, 1, 0, 0, 0, 1, 1, 1, 0},
+    {0, 0, 1, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 1, 0, 0},
+    {0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1},
+    {0, 0, 0, 0, 1, 1, 1, 1, 0, 0, 0, 0, 1, 1, 1, 1},
+    {0, 1, 0, 1, 1, 0, 1, 0, 0, 1, 0, 1, 1, 0, 1, 0},
+    {0, 0, 1, 1, 0, 0, 1, 1, 1, 1, 0, 0, 1, 1, 0, 0},
+    {0, 0, 1, 1, 1, 1, 0, 0, 0, 0, 1, 1, 1, 1, 0, 0},
+    {0, 1, 0, 1, 0, 1, 0, 1, 1, 0, 1, 0, 1, 0, 1, 0},
+    {0, 1, 1, 0, 1, 0, 0, 1, 0, 1, 1, 0, 1, 0, 0, 1},
+    {0, 1, 0, 1, 1, 0, 1, 0, 1, 0, 1, 0, 0, 1, 0, 1},
+    {0, 1, 1, 1, 0, 0, 1, 1, 1, 1, 0, 0, 1, 1, 1, 0},
+    {0, 0, 0, 1, 0, 0, 1, 1, 1, 1, 0, 0, 1, 0, 0, 0},
+    {0, 0, 1, 1, 0, 0, 1, 0, 0, 1, 0, 0, 1, 1, 0, 0},
+    {0, 0, 1, 1, 1, 0, 1, 1, 1, 1, 0, 1, 1, 1, 0, 0},
+    {0, 1, 1, 0, 1, 0, 0, 1, 1, 0, 0, 1, 0, 1, 1, 0},
+    {0, 0, 1, 1, 1, 1, 0, 0, 1, 1, 0, 0, 0, 0, 1, 1},
+    {0, 1, 1, 0, 0, 1, 1, 0, 1, 0, 0, 1, 1, 0, 0, 1},
+    {0, 0, 0, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 0, 0, 0},
+    {0, 1, 0, 0, 1, 1, 1, 0, 0, 1, 0, 0, 0, 0, 0, 0},
+    {0, 0, 1, 0, 0, 1, 1, 1, 0, 0, 1, 0, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 1, 1, 0, 0, 1, 0},
+    {0, 0, 0, 0, 0, 1, 0, 0, 1, 1, 1, 0, 0, 1, 0, 0},
+    {0, 1, 1, 0, 1, 1, 0, 0, 1, 0, 0, 1, 0, 0, 1, 1},
+    {0, 0, 1, 1, 0, 1, 1, 0, 1, 1, 0, 0, 1, 0, 0, 1},
+    {0, 1, 1, 0, 0, 0, 1, 1, 1, 0, 0, 1, 1, 1, 0, 0},
+    {0, 0, 1, 1, 1, 0, 0, 1, 1, 1, 0, 0, 0, 1, 1, 0},
+    {0, 1, 1, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 0, 0, 1},
+    {0, 1, 1, 0, 0, 0, 1, 1, 0, 0, 1, 1, 1, 0, 0, 1},
+    {0, 1, 1, 1, 1, 1, 1, 0, 1, 0, 0, 0, 0, 0, 0, 1},
+    {0, 0, 0, 1, 1, 0, 0, 0, 1, 1, 1, 0, 0, 1, 1, 1},
+    {0, 0, 0, 0, 1, 1, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1},
+    {0, 0, 1, 1, 0, 0, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0},
+    {0, 0, 1, 0, 0, 0, 1, 0, 1, 1, 1, 0, 1, 1, 1, 0},
+    {0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 1, 1, 0, 1, 1, 1}};
+
+static const uint8_t BC7_PARTITIONS_3[64][16] = {
+    {0, 0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 1, 2, 2, 2, 2},
+    {0, 0, 0, 1, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 2, 1},
+    {0, 0, 0, 0, 2, 0, 0, 1, 2, 2, 1, 1, 2, 2, 1, 1},
+    {0, 2, 2, 2, 0, 0, 2, 2, 0, 0, 1, 1, 0, 1, 1, 1},
+    {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2},
+    {0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 2, 2, 0, 0, 2, 2},
+    {0, 0, 2, 2, 0, 0, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1},
+    {0, 0, 1, 1, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1},
+    {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2},
+    {0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2},
+    {0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2},
+    {0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2},
+    {0, 1, 1, 2, 0, 1, 1, 2, 0, 1, 1, 2, 0, 1, 1, 2},
+    {0, 1, 2, 2, 0, 1, 2, 2, 0, 1, 2, 2, 0, 1, 2, 2},
+    {0, 0, 1, 1, 0, 1, 1, 2, 1, 1, 2, 2, 1, 2, 2, 2},
+    {0, 0, 1, 1, 2, 0, 0, 1, 2, 2, 0, 0, 2, 2, 2, 0},
+    {0, 0, 0, 1, 0, 0, 1, 1, 0, 1, 1, 2, 1, 1, 2, 2},
+    {0, 1, 1, 1, 0, 0, 1, 1, 2, 0, 0, 1, 2, 2, 0, 0},
+    {0, 0, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1, 2, 2},
+    {0, 0, 2, 2, 0, 0, 2, 2, 0, 0, 2, 2, 1, 1, 1, 1},
+    {0, 1, 1, 1, 0, 1, 1, 1, 0, 2, 2, 2, 0, 2, 2, 2},
+    {0, 0, 0, 1, 0, 0, 0, 1, 2, 2, 2, 1, 2, 2, 2, 1},
+    {0, 0, 0, 0, 0, 0, 1, 1, 0, 1, 2, 2, 0, 1, 2, 2},
+    {0, 0, 0, 0, 1, 1, 0, 0, 2, 2, 1, 0, 2, 2, 1, 0},
+    {0, 1, 2, 2, 0, 1, 2, 2, 0, 0, 1, 1, 0, 0, 0, 0},
+    {0, 0, 1, 2, 0, 0, 1, 2, 1, 1, 2, 2, 2, 2, 2, 2},
+    {0, 1, 1, 0, 1, 2, 2, 1, 1, 2, 2, 1, 0, 1, 1, 0},
+    {0, 0, 0, 0, 0, 1, 1, 0, 1, 2, 2, 1, 1, 2, 2, 1},
+    {0, 0, 2, 2, 1, 1, 0, 2, 1, 1, 0, 2, 0, 0, 2, 2},
+    {0, 1, 1, 0, 0, 1, 1, 0, 2, 0, 0, 2, 2, 2, 2, 2},
+    {0, 0, 1, 1, 0, 1, 2, 2, 0, 1, 2, 2, 0, 0, 1, 1},
+    {0, 0, 0, 0, 2, 0, 0, 0, 2, 2, 1, 1, 2, 2, 2, 1},
+    {0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 2, 2, 2},
+    {0, 2, 2, 2, 0, 0, 2, 2, 0, 0, 1, 2, 0, 0, 1, 1},
+    {0, 0, 1, 1, 0, 0, 1, 2, 0, 0, 2, 2, 0, 2, 2, 2},
+    {0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0},
+    {0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 0, 0, 0, 0},
+    {0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0},
+    {0, 1, 2, 0, 2, 0, 1, 2, 1, 2, 0, 1, 0, 1, 2, 0},
+    {0, 0, 1, 1, 2, 2, 0, 0, 1, 1, 2, 2, 0, 0, 1, 1},
+    {0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 0, 0, 0, 0, 1, 1},
+    {0, 1, 0, 1, 0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2},
+    {0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 2, 1, 2, 1, 2, 1},
+    {0, 0, 2, 2, 1, 1, 2, 2, 0, 0, 2, 2, 1, 1, 2, 2},
+    {0, 0, 2, 2, 0, 0, 1, 1, 0, 0, 2, 2, 0, 0, 1, 1},
+    {0, 2, 2, 0, 1, 2, 2, 1, 0, 2, 2, 0, 1, 2, 2, 1},
+    {0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2, 0, 1, 0, 1},
+    {0, 0, 0, 0, 2, 1, 2, 1, 2, 1, 2, 1, 2, 1, 2, 1},
+    {0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 2, 2, 2, 2},
+    {0, 2, 2, 2, 0, 1, 1, 1, 0, 2, 2, 2, 0, 1, 1, 1},
+    {0, 0, 0, 2, 1, 1, 1, 2, 0, 0, 0, 2, 1, 1, 1, 2},
+    {0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1, 2},
+    {0, 2, 2, 2, 0, 1, 1, 1, 0, 1, 1, 1, 0, 2, 2, 2},
+    {0, 0, 0, 2, 1, 1, 1, 2, 1, 1, 1, 2, 0, 0, 0, 2},
+    {0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 2, 2},
+    {0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 1, 2},
+    {0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 2, 2, 2, 2, 2, 2},
+    {0, 0, 2, 2, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 2, 2},
+    {0, 0, 2, 2, 1, 1, 2, 2, 1, 1, 2, 2, 0, 0, 2, 2},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2},
+    {0, 0, 0, 2, 0, 0, 0, 1, 0, 0, 0, 2, 0, 0, 0, 1},
+    {0, 2, 2, 2, 1, 2, 2, 2, 0, 2, 2, 2, 1, 2, 2, 2},
+    {0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2},
+    {0, 1, 1, 1, 2, 0, 1, 1, 2, 2, 0, 1, 2, 2, 2, 0}};
+
+// Texels whose index drops its top bit, texel 0 always does for subset 0
+static const uint8_t BC7_ANCHORS_2[64] = {
+    15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+    15, 2,  8,  2,  2,  8,  8,  15, 2,  8,  2,  2,  8,  8,  2,  2,
+    15, 15, 6,  8,  2,  8,  15, 15, 2,  8,  2,  2,  2,  15, 15, 6,
+    6,  2,  6,  8,  15, 15, 2,  2,  15, 15, 15, 15, 15, 2,  2,  15};
+
+static const uint8_t BC7_ANCHORS_3_SECOND[64] = {
+    3,  3,  15, 15, 8,  3,  15, 15, 8,  8,  6,  6,  6,  5,  3,  3,
+    3,  3,  8,  15, 3,  3,  6,  10, 5,  8,  8,  6,  8,  5,  15, 15,
+    8,  15, 3,  5,  6,  10, 8,  15, 15, 3,  15, 5,  15, 15, 15, 15,
+    3,  15, 5,  5,  5,  8,  5,  10, 5,  10, 8,  13, 15, 12, 3,  3};
+
+static const uint8_t BC7_ANCHORS_3_THIRD[64] = {
+    15, 8,  8,  3,  15, 15, 3,  8,  15, 15, 15, 15, 15, 15, 15, 8,
+    15, 8,  15, 3,  15, 8,  15, 8,  3,  15, 6,  10, 15, 15, 10, 8,
+    15, 3,  15, 10, 10, 8,  9,  10, 6,  15, 8,  15, 3,  6,  6,  8,
+    15, 3,  15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 3,  15, 15, 8};
+
+static const uint8_t BC7_WEIGHTS_2[4] = {0, 21, 43, 64};
+static const uint8_t BC7_WEIGHTS_3[8] = {0, 9, 18, 27, 37, 46, 55, 64};
+static const uint8_t BC7_WEIGHTS_4[16] = {0,  4,  9,  13, 17, 21, 26, 30,
+                                          34, 38, 43, 47, 51, 55, 60, 64};
+
+// Reads a BC7 block least significant bit first
+struct BlockBitReader {
+  const uint8_t *data;
+  uint32_t position;
+
+  uint32_t read(uint32_t count) {
+    uint32_t value = 0;
+    for (uint32_t i = 0; i < count; i++) {
+      uint32_t bit = position + i;
+      value |= ((data[bit >> 3] >> (bit & 7)) & 1u) << i;
+    }
+    position += count;
+    return value;
+  }
+};
+
+static const uint8_t *bc7Weights(uint32_t indexBits) {
+  if (indexBits == 2) {
+    return BC7_WEIGHTS_2;
+  }
+  return indexBits == 3 ? BC7_WEIGHTS_3 : BC7_WEIGHTS_4;
+}
+
+static void decodeBC7Block(const uint8_t *block, BlockTexels texels) {
+  uint32_t mode = 0;
+  while (mode < 8 && !(block[0] & (1u << mode))) {
+    mode++;
+  }
+  // Reserved mode, decodes to transparent black
+  if (mode == 8) {
+    memset(texels, 0, sizeof(BlockTexels));
+    return;
+  }
+
+  const BC7Mode &info = BC7_MODES[mode];
+  BlockBitReader bits{block, mode + 1};
+  uint32_t partition = bits.read(info.partitionBits);
+  uint32_t rotation = bits.read(info.rotationBits);
+  uint32_t indexSelection = bits.read(info.indexSelectionBits);
+
+  // All reds first, then greens, blues and alphas
+  uint32_t endpointCount = info.subsets * 2u;
+  uint32_t endpoints[6][4] = {};
+  for (uint32_t channel = 0; channel < 4; channel++) {
+    uint32_t channelBits = channel < 3 ? info.colorBits : info.alphaBits;
+    for (uint32_t endpoint = 0; endpoint < endpointCount; endpoint++) {
+      endpoints[endpoint][channel] = bits.read(channelBits);
+    }
+  }
+
+  uint32_t colorPrecision = info.colorBits;
+  uint32_t alphaPrecision = info.alphaBits;
+  if (info.endpointPBits || info.sharedPBits) {
+    uint32_t pBits[6];
+    for (uint32_t endpoint = 0; endpoint < endpointCount; endpoint++) {
+      if (info.endpointPBits) {
+        pBits[endpoint] = bits.read(1);
+      } else if (endpoint % 2 == 0) {
+        pBits[endpoint] = pBits[endpoint + 1] = bits.read(1);
+      }
+    }
+    for (uint32_t endpoint = 0; endpoint < endpointCount; endpoint++) {
+      for (uint32_t channel = 0; channel < 4; channel++) {
+        endpoints[endpoint][channel] =
+            (endpoints[endpoint][channel] << 1) | pBits[endpoint];
+      }
+    }
+    colorPrecision++;
+    if (alphaPrecision > 0) {
+      alphaPrecision++;
+    }
+  }
+
+  // Top bits are repeated into the low ones
+  for (uint32_t endpoint = 0; endpoint < endpointCount; endpoint++) {
+    for (uint32_t channel = 0; channel < 4; channel++) {
+      uint32_t precision = channel < 3 ? colorPrecision : alphaPrecision;
+      uint32_t &value = endpoints[endpoint][channel];
+      if (precision == 0) {
+        value = 255;
+        continue;
+      }
+      value <<= 8 - precision;
+      value |= value >> precision;
+    }
+  }
+
+  const uint8_t *subsetOf = nullptr;
+  if (info.subsets == 2) {
+    subsetOf = BC7_PARTITIONS_2[partition];
+  } else if (info.subsets == 3) {
+    subsetOf = BC7_PARTITIONS_3[partition];
+  }
+  auto isAnchor = [&](uint32_t texel) {
+    if (texel == 0) {
+      return true;
+    }
+    if (info.subsets == 2) {
+      return texel == BC7_ANCHORS_2[partition];
+    }
+    if (info.subsets == 3) {
+      return texel == BC7_ANCHORS_3_SECOND[partition] ||
+             texel == BC7_ANCHORS_3_THIRD[partition];
+    }
+    return false;
+  };
+
+  uint32_t primary[16];
+  uint32_t secondary[16] = {};
+  for (uint32_t texel = 0; texel < 16; texel++) {
+    primary[texel] = bits.read(info.indexBits - (isAnchor(texel) ? 1 : 0));
+  }
+  if (info.secondaryIndexBits) {
+    for (uint32_t texel = 0; texel < 16; texel++) {
+      secondary[texel] =
+          bits.read(info.secondaryIndexBits - (texel == 0 ? 1 : 0));
+    }
+  }
+
+  // Mode 4 picks which of its index sets is the 3 bit one for color
+  const uint8_t *colorWeights = bc7Weights(info.indexBits);
+  const uint8_t *alphaWeights = colorWeights;
+  const uint32_t *colorIndices = primary;
+  const uint32_t *alphaIndices = primary;
+  if (info.secondaryIndexBits) {
+    alphaWeights = bc7Weights(info.secondaryIndexBits);
+    alphaIndices = secondary;
+    if (indexSelection) {
+      std::swap(colorWeights, alphaWeights);
+      std::swap(colorIndices, alphaIndices);
+    }
+  }
+
+  for (uint32_t texel = 0; texel < 16; texel++) {
+    uint32_t subset = subsetOf != nullptr ? subsetOf[texel] : 0;
+    const uint32_t *e0 = endpoints[subset * 2];
+    const uint32_t *e1 = endpoints[subset * 2 + 1];
+    uint32_t colorWeight = colorWeights[colorIndices[texel]];
+    uint32_t alphaWeight = alphaWeights[alphaIndices[texel]];
+    for (uint32_t channel = 0; channel < 4; channel++) {
+      uint32_t weight = channel < 3 ? colorWeight : alphaWeight;
+      texels[texel][channel] = static_cast<uint8_t>(
+          ((64 - weight) * e0[channel] + weight * e1[channel] + 32) >> 6);
+    }
+    if (rotation > 0) {
+      std::swap(texels[texel][3], texels[texel][rotation - 1]);
+    }
+  }
+}
+
+//===========================
+// ETC2
+
+static const int ETC_MODIFIERS[8][4] = {
+    {2, 8, -2, -8},       {5, 17, -5, -17},     {9, 29, -9, -29},
+    {13, 42, -13, -42},   {18, 60, -18, -60},   {24, 80, -24, -80},
+    {33, 106, -33, -106}, {47, 183, -47, -183}};
+
+static const int ETC_DISTANCES[8] = {3, 6, 11, 16, 23, 32, 41, 64};
+
+static const int EAC_MODIFIERS[16][8] = {
+    {-3, -6, -9, -15, 2, 5, 8, 14}, {-3, -7, -10, -13, 2, 6, 9, 12},
+    {-2, -5, -8, -13, 1, 4, 7, 12}, {-2, -4, -6, -13, 1, 3, 5, 12},
+    {-3, -6, -8, -12, 2, 5, 7, 11}, {-3, -7, -9, -11, 2, 6, 8, 10},
+    {-4, -7, -8, -11, 3, 6, 7, 10}, {-3, -5, -8, -11, 2, 4, 7, 10},
+    {-2, -6, -8, -10, 1, 5, 7, 9},  {-2, -5, -8, -10, 1, 4, 7, 9},
+    {-2, -4, -8, -10, 1, 3, 7, 9},  {-2, -5, -7, -10, 1, 4, 6, 9},
+    {-3, -4, -7, -10, 2, 3, 6, 9},  {-1, -2, -3, -10, 0, 1, 2, 9},
+    {-4, -6, -8, -9, 3, 5, 7, 8},   {-3, -5, -7, -9, 2, 4, 6, 8}};
+
+static uint32_t readBigEndian32(const uint8_t *data) {
+  return (static_cast<uint32_t>(data[0]) << 24) | (data[1] << 16) |
+         (data[2] << 8) | data[3];
+}
+
+static int extend4(uint32_t value) { return static_cast<int>(value * 17); }
+static int extend5(uint32_t value) {
+  return static_cast<int>((value << 3) | (value >> 2));
+}
+static int extend6(uint32_t value) {
+  return static_cast<int>((value << 2) | (value >> 4));
+}
+static int extend7(uint32_t value) {
+  return static_cast<int>((value << 1) | (value >> 6));
+}
+
+static void setTexel(uint8_t *texel, const int *color, uint8_t alpha) {
+  texel[0] = clampByte(color[0]);
+  texel[1] = clampByte(color[1]);
+  texel[2] = clampByte(color[2]);
+  texel[3] = alpha;
+}
+
+// Punchthrough blocks without the opaque bit turn index 2 transparent
+static void decodeETC2ColorBlock(const uint8_t *block, bool punchthrough,
+                                 BlockTexels texels) {
+  uint32_t high = readBigEndian32(block);
+  uint32_t low = readBigEndian32(block + 4);
+  bool diffBit = (high >> 1) & 1;
+  bool flip = high & 1;
+  bool differential = punchthrough || diffBit;
+  bool transparent = punchthrough && !diffBit;
+
+  // Pixel indices run down the columns, the top bits in the upper half
+  auto pixelIndex = [&](uint32_t x, uint32_t y) {
+    uint32_t pixel = x * 4 + y;
+    return (((low >> (pixel + 16)) & 1) << 1) | ((low >> pixel) & 1);
+  };
+  auto setPaintTexels = [&](const int paint[4][3]) {
+    for (uint32_t y = 0; y < 4; y++) {
+      for (uint32_t x = 0; x < 4; x++) {
+        uint32_t index = pixelIndex(x, y);
+        if (transparent && index == 2) {
+          memset(texels[y * 4 + x], 0, 4);
+        } else {
+          setTexel(texels[y * 4 + x], paint[index], 255);
+        }
+      }
+    }
+  };
+
+  int base[2][3];
+  if (!differential) {
+    for (uint32_t channel = 0; channel < 3; channel++) {
+      uint32_t shift = 28 - channel * 8;
+      base[0][channel] = extend4((high >> shift) & 15);
+      base[1][channel] = extend4((high >> (shift - 4)) & 15);
+    }
+  } else {
+    int values[3];
+    int deltas[3];
+    for (uint32_t channel = 0; channel < 3; channel++) {
+      uint32_t shift = 27 - channel * 8;
+      values[channel] = static_cast<int>((high >> shift) & 31);
+      int delta = static_cast<int>((high >> (shift - 3)) & 7);
+      deltas[channel] = delta >= 4 ? delta - 8 : delta;
+    }
+
+    if (values[0] + deltas[0] < 0 || values[0] + deltas[0] > 31) {
+      // T mode
+      int paint[4][3];
+      uint32_t r1 = (((high >> 27) & 3) << 2) | ((high >> 24) & 3);
+      int color1[3] = {extend4(r1), extend4((high >> 20) & 15),
+                       extend4((high >> 16) & 15)};
+      int color2[3] = {extend4((high >> 12) & 15), extend4((high >> 8) & 15),
+                       extend4((high >> 4) & 15)};
+      int distance = ETC_DISTANCES[(((high >> 2) & 3) << 1) | (high & 1)];
+      for (uint32_t channel = 0; channel < 3; channel++) {
+        paint[0][channel] = color1[channel];
+        paint[1][channel] = color2[channel] + distance;
+        paint[2][channel] = color2[channel];
+        paint[3][channel] = color2[channel] - distance;
+      }
+      setPaintTexels(paint);
+      return;
+    }
+
+    if (values[1] + deltas[1] < 0 || values[1] + deltas[1] > 31) {
+      // H mode
+      int paint[4][3];
+      uint32_t r1 = (high >> 27) & 15;
+      uint32_t g1 = (((high >> 24) & 7) << 1) | ((high >> 20) & 1);
+      uint32_t b1 = (((high >> 19) & 1) << 3) | ((high >> 15) & 7);
+      uint32_t r2 = (high >> 11) & 15;
+      uint32_t g2 = (high >> 7) & 15;
+      uint32_t b2 = (high >> 3) & 15;
+      uint32_t order = ((r1 << 8) | (g1 << 4) | b1) >=
+                       ((r2 << 8) | (g2 << 4) | b2);
+      int distance = ETC_DISTANCES[(((high >> 2) & 1) << 2) |
+                                   ((high & 1) << 1) | order];
+      int color1[3] = {extend4(r1), extend4(g1), extend4(b1)};
+      int color2[3] = {extend4(r2), extend4(g2), extend4(b2)};
+      for (uint32_t channel = 0; channel < 3; channel++) {
+        paint[0][channel] = color1[channel] + distance;
+        paint[1][channel] = color1[channel] - distance;
+        paint[2][channel] = color2[channel] + distance;
+        paint[3][channel] = color2[channel] - distance;
+      }
+      setPaintTexels(paint);
+      return;
+    }
+
+    if (values[2] + deltas[2] < 0 || values[2] + deltas[2] > 31) {
+      // Planar mode, always opaque
+      int origin[3] = {
+          extend6((high >> 25) & 63),
+          extend7((((high >> 24) & 1) << 6) | ((high >> 17) & 63)),
+          extend6((((high >> 16) & 1) << 5) | (((high >> 11) & 3) << 3) |
+                  ((high >> 7) & 7))};
+      int horizontal[3] = {
+          extend6((((high >> 2) & 31) << 1) | (high & 1)),
+          extend7((low >> 25) & 127), extend6((low >> 19) & 63)};
+      int vertical[3] = {extend6((low >> 13) & 63), extend7((low >> 6) & 127),
+                         extend6(low & 63)};
+      for (uint32_t y = 0; y < 4; y++) {
+        for (uint32_t x = 0; x < 4; x++) {
+          int color[3];
+          for (uint32_t channel = 0; channel < 3; channel++) {
+            int xi = static_cast<int>(x);
+            int yi = static_cast<int>(y);
+            color[channel] =
+                (xi * (horizontal[channel] - origin[channel]) +
+                 yi * (vertical[channel] - origin[channel]) +
+                 4 * origin[channel] + 2) >>
+                2;
+          }
+          setTexel(texels[y * 4 + x], color, 255);
+        }
+      }
+      return;
+    }
+
+    for (uint32_t channel = 0; channel < 3; channel++) {
+      base[0][channel] = extend5(static_cast<uint32_t>(values[channel]));
+      base[1][channel] =
+          extend5(static_cast<uint32_t>(values[channel] + deltas[channel]));
+    }
+  }
+
+  // Individual and differential modes, two 2x4 or 4x2 sub-blocks
+  uint32_t tables[2] = {(high >> 5) & 7, (high >> 2) & 7};
+  for (uint32_t y = 0; y < 4; y++) {
+    for (uint32_t x = 0; x < 4; x++) {
+      uint32_t subBlock = flip ? (y >= 2) : (x >= 2);
+      uint32_t index = pixelIndex(x, y);
+      if (transparent && index == 2) {
+        memset(texels[y * 4 + x], 0, 4);
+        continue;
+      }
+      int modifier = ETC_MODIFIERS[tables[subBlock]][index];
+      if (transparent && index == 0) {
+        modifier = 0;
+      }
+      int color[3] = {base[subBlock][0] + modifier,
+                      base[subBlock][1] + modifier,
+                      base[subBlock][2] + modifier};
+      setTexel(texels[y * 4 + x], color, 255);
+    }
+  }
+}
+
+static void decodeEACAlphaBlock(const uint8_t *block, BlockTexels texels) {
+  int base = block[0];
+  int multiplier = block[1] >> 4;
+  const int *modifiers = EAC_MODIFIERS[block[1] & 15];
+
+  uint64_t indices = 0;
+  for (uint32_t i = 2; i < 8; i++) {
+    indices = (indices << 8) | block[i];
+  }
+  // 3 bit indices running down the columns, first one on top
+  for (uint32_t pixel = 0; pixel < 16; pixel++) {
+    uint32_t index = (indices >> (45 - 3 * pixel)) & 7;
+    uint32_t x = pixel / 4;
+    uint32_t y = pixel % 4;
+    texels[y * 4 + x][3] = clampByte(base + modifiers[index] * multiplier);
+  }
+}
+
+//===========================
+
+bool canDecodeToRGBA8(VkFormat format) {
+  TextureBlockInfo info;
+  return getTextureBlockInfo(format, info) && info.compressed;
+}
+
+void decodeToRGBA8(VkFormat format, const uint8_t *blocks, uint32_t width,
+                   uint32_t height, uint8_t *dst) {
+  TextureBlockInfo info;
+  if (!canDecodeToRGBA8(format) || !getTextureBlockInfo(format, info)) {
+    throw std::runtime_error("failed to decode texture, unknown format!");
+  }
+
+  uint32_t blocksWide = (width + 3) / 4;
+  uint32_t blocksHigh = (height + 3) / 4;
+  BlockTexels texels;
+  for (uint32_t blockY = 0; blockY < blocksHigh; blockY++) {
+    for (uint32_t blockX = 0; blockX < blocksWide; blockX++) {
+      switch (format) {
+      case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+      case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+        decodeBC1Block(blocks, false, texels);
+        break;
+      case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+      case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+        decodeBC1Block(blocks, true, texels);
+        break;
+      case VK_FORMAT_BC7_UNORM_BLOCK:
+      case VK_FORMAT_BC7_SRGB_BLOCK:
+        decodeBC7Block(blocks, texels);
+        break;
+      case VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK:
+      case VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK:
+        decodeETC2ColorBlock(blocks, false, texels);
+        break;
+      case VK_FORMAT_ETC2_R8G8B8A1_UNORM_BLOCK:
+      case VK_FORMAT_ETC2_R8G8B8A1_SRGB_BLOCK:
+        decodeETC2ColorBlock(blocks, true, texels);
+        break;
+      default:
+        // ETC2 with EAC alpha, the alpha block comes first
+        decodeETC2ColorBlock(blocks + 8, false, texels);
+        decodeEACAlphaBlock(blocks, texels);
+        break;
+      }
+      blocks += info.bytes;
+
+      // Blocks hanging over the edge are cut off
+      uint32_t columns = std::min(4u, width - blockX * 4);
+      uint32_t rows = std::min(4u, height - blockY * 4);
+      for (uint32_t y = 0; y < rows; y++) {
+        size_t texel = static_cast<size_t>(blockY * 4 + y) * width + blockX * 4;
+        memcpy(dst + texel * 4, texels[y * 4], columns * 4);
+      }
+    }
+  }
+}
+} // namespace Utils
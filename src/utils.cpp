@@ -1,5 +1,13 @@
 #include <utils.hpp>
 
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) ||                                    \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define UTILS_HAS_SSE2 1
+#include <emmintrin.h>
+#endif
+
 namespace Utils {
 
 SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device,
@@ -55,6 +63,25 @@ QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device,
       indices.graphicsFamily = i;
     }
 
+    VkQueueFlags transferOnly = queueFamilies[i].queueFlags &
+                                (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT |
+                                 VK_QUEUE_TRANSFER_BIT);
+    if (transferOnly == VK_QUEUE_TRANSFER_BIT &&
+        !indices.transferFamily.has_value()) {
+      indices.transferFamily = i;
+    }
+
+    if ((queueFamilies[i].queueFlags & VK_QUEUE_COMPUTE_BIT) &&
+        !(queueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) &&
+        !indices.computeFamily.has_value()) {
+      indices.computeFamily = i;
+    }
+
+    // Headless rendering has no surface, nothing gets presented
+    if (surface == VK_NULL_HANDLE) {
+      continue;
+    }
+
     // Find if the device supports window system and present images to the
     // surface we created
     VkBool32 presentSupport = false;
@@ -68,6 +95,11 @@ QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device,
     }
   }
 
+  // Headless mode "presents" on the graphics queue
+  if (surface == VK_NULL_HANDLE) {
+    indices.presentFamily = indices.graphicsFamily;
+  }
+
   std::cout << "graphicsFamily: " << indices.graphicsFamily.value()
             << " presentFamily: " << indices.presentFamily.value() << "\n";
 
@@ -75,7 +107,8 @@ QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device,
 }
 
 VkImageView createImageView(VkDevice device, VkImage image, VkFormat format,
-                            VkImageAspectFlags aspectFlags) {
+                            VkImageAspectFlags aspectFlags,
+                            uint32_t mipLevels) {
   VkImageViewCreateInfo viewInfo{};
   viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
   viewInfo.image = image;
@@ -99,7 +132,7 @@ VkImageView createImageView(VkDevice device, VkImage image, VkFormat format,
   // targets without any mipmapping levels or multiple layers.
   viewInfo.subresourceRange.aspectMask = aspectFlags;
   viewInfo.subresourceRange.baseMipLevel = 0;
-  viewInfo.subresourceRange.levelCount = 1;
+  viewInfo.subresourceRange.levelCount = mipLevels;
   viewInfo.subresourceRange.baseArrayLayer = 0;
   viewInfo.subresourceRange.layerCount = 1;
 
@@ -111,6 +144,84 @@ VkImageView createImageView(VkDevice device, VkImage image, VkFormat format,
   return imageView;
 }
 
+uint32_t mipLevelCount(uint32_t width, uint32_t height) {
+  uint32_t levels = 1;
+  for (uint32_t size = std::max(width, height); size > 1; size /= 2) {
+    levels++;
+  }
+  return levels;
+}
+
+VkDeviceSize mipChainSize(uint32_t width, uint32_t height,
+                          uint32_t mipLevels) {
+  VkDeviceSize size = 0;
+  for (uint32_t level = 0; level < mipLevels; level++) {
+    size += static_cast<VkDeviceSize>(std::max(width >> level, 1u)) *
+            std::max(height >> level, 1u) * 4;
+  }
+  return size;
+}
+
+void downsampleRGBA8(const uint8_t *src, uint32_t srcWidth, uint32_t srcHeight,
+                     uint8_t *dst) {
+  uint32_t dstWidth = std::max(srcWidth / 2, 1u);
+  uint32_t dstHeight = std::max(srcHeight / 2, 1u);
+
+  for (uint32_t y = 0; y < dstHeight; y++) {
+    const uint8_t *row0 = src + static_cast<size_t>(2 * y) * srcWidth * 4;
+    const uint8_t *row1 =
+        src + static_cast<size_t>(std::min(2 * y + 1, srcHeight - 1)) *
+                  srcWidth * 4;
+    uint8_t *dstRow = dst + static_cast<size_t>(y) * dstWidth * 4;
+
+    uint32_t x = 0;
+#ifdef UTILS_HAS_SSE2
+    // Two output texels per step from four input texels of both rows
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i rounding = _mm_set1_epi16(2);
+    for (; x + 1 < dstWidth && 2 * x + 4 <= srcWidth; x += 2) {
+      __m128i top =
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(row0 + 8 * x));
+      __m128i bottom =
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(row1 + 8 * x));
+      // Vertical sums as 16 bit channels, texels 0 1 and texels 2 3
+      __m128i left = _mm_add_epi16(_mm_unpacklo_epi8(top, zero),
+                                   _mm_unpacklo_epi8(bottom, zero));
+      __m128i right = _mm_add_epi16(_mm_unpackhi_epi8(top, zero),
+                                    _mm_unpackhi_epi8(bottom, zero));
+      // Horizontal sums land in the low halves
+      left = _mm_add_epi16(left, _mm_srli_si128(left, 8));
+      right = _mm_add_epi16(right, _mm_srli_si128(right, 8));
+      __m128i sum = _mm_unpacklo_epi64(left, right);
+      sum = _mm_srli_epi16(_mm_add_epi16(sum, rounding), 2);
+      _mm_storel_epi64(reinterpret_cast<__m128i *>(dstRow + 4 * x),
+                       _mm_packus_epi16(sum, sum));
+    }
+#endif
+    for (; x < dstWidth; x++) {
+      uint32_t x0 = 2 * x;
+      uint32_t x1 = std::min(2 * x + 1, srcWidth - 1);
+      for (uint32_t channel = 0; channel < 4; channel++) {
+        uint32_t sum = row0[x0 * 4 + channel] + row0[x1 * 4 + channel] +
+                       row1[x0 * 4 + channel] + row1[x1 * 4 + channel];
+        dstRow[x * 4 + channel] = static_cast<uint8_t>((sum + 2) / 4);
+      }
+    }
+  }
+}
+
+void generateMipChainRGBA8(uint8_t *pixels, uint32_t width, uint32_t height,
+                           uint32_t mipLevels) {
+  uint8_t *level = pixels;
+  for (uint32_t i = 1; i < mipLevels; i++) {
+    uint32_t levelWidth = std::max(width >> (i - 1), 1u);
+    uint32_t levelHeight = std::max(height >> (i - 1), 1u);
+    uint8_t *next = level + static_cast<size_t>(levelWidth) * levelHeight * 4;
+    downsampleRGBA8(level, levelWidth, levelHeight, next);
+    level = next;
+  }
+}
+
 std::vector<char> readFile(std::string filePath) {
 
   // std::ios::ate means seek the end immediatly
@@ -134,6 +245,28 @@ std::vector<char> readFile(std::string filePath) {
   return buffer;
 }
 
+void writePPM(std::string filePath, const uint8_t *bgraPixels, uint32_t width,
+              uint32_t height) {
+  std::ofstream file{filePath, std::ios::binary};
+  if (!file.is_open()) {
+    throw std::runtime_error("Failed to open file: " + filePath);
+  }
+
+  file << "P6\n" << width << " " << height << "\n255\n";
+
+  // PPM only stores RGB, drop alpha and swizzle from BGRA
+  std::vector<char> row(width * 3);
+  for (uint32_t y = 0; y < height; y++) {
+    const uint8_t *src = bgraPixels + y * width * 4;
+    for (uint32_t x = 0; x < width; x++) {
+      row[x * 3 + 0] = static_cast<char>(src[x * 4 + 2]);
+      row[x * 3 + 1] = static_cast<char>(src[x * 4 + 1]);
+      row[x * 3 + 2] = static_cast<char>(src[x * 4 + 0]);
+    }
+    file.write(row.data(), row.size());
+  }
+}
+
 void showWindowFlags(int flags) {
 
   printf("\nFLAGS ENABLED: ( %d )\n", flags);
@@ -167,6 +300,33 @@ void showWindowFlags(int flags) {
   printf("=======================\n");
 }
 
+const char *presentModeName(VkPresentModeKHR presentMode) {
+  switch (presentMode) {
+  case VK_PRESENT_MODE_IMMEDIATE_KHR:
+    return "immediate";
+  case VK_PRESENT_MODE_MAILBOX_KHR:
+    return "mailbox";
+  case VK_PRESENT_MODE_FIFO_KHR:
+    return "fifo";
+  case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+    return "fifo_relaxed";
+  default:
+    return "unknown";
+  }
+}
+
+bool parsePresentMode(const std::string &name, VkPresentModeKHR &presentMode) {
+  for (VkPresentModeKHR mode :
+       {VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR,
+        VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR}) {
+    if (name == presentModeName(mode)) {
+      presentMode = mode;
+      return true;
+    }
+  }
+  return false;
+}
+
 VkCommandBuffer beginSingleTimeCommands(VkDevice device,
                                         VkCommandPool commandPool) {
   // First need to allocate a temporary command buffer
@@ -209,75 +369,6 @@ void endSingleTimeCommands(VkDevice device, VkCommandPool commandPool,
   vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
 }
 
-uint32_t findMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeFilter,
-                        VkMemoryPropertyFlags properties) {
-  VkPhysicalDeviceMemoryProperties memProperties;
-
-  vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
-
-  for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
-    // typeFiler specifies the bit field of memory types that are suitable
-    // can find index of suitable memory by iterating over all memoryTypes and
-    // checking if the bit is set to 1
-
-    // need to also look at special features of the memory, like being able to
-    // map so we can write to it from CPU so look for a bitwise match
-
-    if (typeFilter & (1 << i) && (memProperties.memoryTypes[i].propertyFlags &
-                                  properties) == properties) {
-      return i;
-    }
-  }
-  throw std::runtime_error("Failed to find memory type!");
-}
-
-void createBuffer(VkPhysicalDevice physicalDevice, VkDevice device,
-                  VkDeviceSize size, VkBufferUsageFlags usage,
-                  VkMemoryPropertyFlags properties, VkBuffer &buffer,
-                  VkDeviceMemory &bufferMemory) {
-  VkBufferCreateInfo bufferInfo{};
-  bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-  bufferInfo.size = size;
-  bufferInfo.usage = usage;
-  bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-  if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
-    throw std::runtime_error("failed to create vertex buffer!");
-  }
-
-  // After this buffer has been created, but doesn't have memory inside
-  // First step of allocating memory to buffer requires querying its memory
-  // requirements
-  VkMemoryRequirements memRequirements;
-  vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
-
-  VkMemoryAllocateInfo allocInfo{};
-  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  allocInfo.allocationSize = memRequirements.size;
-  allocInfo.memoryTypeIndex = findMemoryType(
-      physicalDevice, memRequirements.memoryTypeBits, properties);
-
-  if (vkAllocateMemory(device, &allocInfo, nullptr, &bufferMemory) !=
-      VK_SUCCESS) {
-    throw std::runtime_error("failed to allocate vertex buffer memory!");
-  }
-  vkBindBufferMemory(device, buffer, bufferMemory, 0);
-}
-
-void copyBuffer(VkDevice device, VkCommandPool commandPool, VkQueue submitQueue,
-                VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
-
-  VkCommandBuffer commandBuffer = beginSingleTimeCommands(device, commandPool);
-
-  VkBufferCopy copyRegion{};
-  copyRegion.srcOffset = 0; // Optional
-  copyRegion.dstOffset = 0; // Optional
-  copyRegion.size = size;
-  vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
-
-  endSingleTimeCommands(device, commandPool, commandBuffer, submitQueue);
-}
-
 std::vector<VkFramebuffer>
 createFramebuffers(VkDevice device,
                    std::vector<VkImageView> swapChainImageViews,
@@ -333,4 +424,12 @@ VkFormat findSupportedFormat(VkPhysicalDevice physicalDevice,
   throw std::runtime_error("failed to find supported format!");
 }
 
+VkFormat findDepthFormat(VkPhysicalDevice physicalDevice) {
+  return findSupportedFormat(
+      physicalDevice,
+      {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT,
+       VK_FORMAT_D24_UNORM_S8_UINT},
+      VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
+}
+
 } // namespace Utils
\ No newline at end of file
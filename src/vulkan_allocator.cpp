@@ -0,0 +1,529 @@
+#include <vulkan_allocator.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+
+namespace VulkanStuff {
+
+// Blocks never get smaller than this, even on tiny heaps
+static constexpr VkDeviceSize MIN_BLOCK_SIZE = 1ull << 20;
+
+static uint32_t orderForSize(VkDeviceSize size) {
+  uint32_t order = 0;
+  VkDeviceSize nodeSize = VulkanAllocator::MIN_NODE_SIZE;
+  while (nodeSize < size) {
+    nodeSize <<= 1;
+    order++;
+  }
+  return order;
+}
+
+//==============================================
+// VulkanMemoryBlock
+//==============================================
+
+bool VulkanMemoryBlock::allocate(uint32_t order, VkDeviceSize &offset) {
+  // Smallest free node that fits, then split it down to the wanted size
+  uint32_t nodeOrder = order;
+  while (nodeOrder <= maxOrder && freeNodes[nodeOrder].empty()) {
+    nodeOrder++;
+  }
+  if (nodeOrder > maxOrder) {
+    return false;
+  }
+
+  auto node = freeNodes[nodeOrder].begin();
+  offset = *node;
+  freeNodes[nodeOrder].erase(node);
+  while (nodeOrder > order) {
+    nodeOrder--;
+    // Keep the lower half, the upper half becomes a free buddy
+    freeNodes[nodeOrder].insert(offset +
+                                (VulkanAllocator::MIN_NODE_SIZE << nodeOrder));
+  }
+
+  freeBytes -= VulkanAllocator::MIN_NODE_SIZE << order;
+  allocationCount++;
+  return true;
+}
+
+void VulkanMemoryBlock::free(VkDeviceSize offset, uint32_t order) {
+  freeBytes += VulkanAllocator::MIN_NODE_SIZE << order;
+  allocationCount--;
+
+  // Merge with the buddy for as long as it is free as well
+  while (order < maxOrder) {
+    VkDeviceSize buddy = offset ^ (VulkanAllocator::MIN_NODE_SIZE << order);
+    if (freeNodes[order].erase(buddy) == 0) {
+      break;
+    }
+    offset = std::min(offset, buddy);
+    order++;
+  }
+  freeNodes[order].insert(offset);
+}
+
+VkDeviceSize VulkanMemoryBlock::largestFreeNode() const {
+  for (uint32_t order = maxOrder + 1; order-- > 0;) {
+    if (!freeNodes[order].empty()) {
+      return VulkanAllocator::MIN_NODE_SIZE << order;
+    }
+  }
+  return 0;
+}
+
+//==============================================
+// VulkanAllocator
+//==============================================
+
+VulkanAllocator::VulkanAllocator(VkPhysicalDevice inputPhysicalDevice,
+                                 VkDevice inputDevice)
+    : physicalDevice{inputPhysicalDevice}, device{inputDevice} {
+  vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+  VkPhysicalDeviceProperties deviceProperties;
+  vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+  bufferImageGranularity = deviceProperties.limits.bufferImageGranularity;
+  separateOptimalBlocks = bufferImageGranularity > MIN_NODE_SIZE;
+
+  pools.resize(memoryProperties.memoryTypeCount * 2);
+  for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+    // An eighth of the heap at most, so small heaps (like the 256MB host
+    // visible device local one) don't get swallowed by a single block
+    VkDeviceSize heapSize =
+        memoryProperties.memoryHeaps[memoryProperties.memoryTypes[i].heapIndex]
+            .size;
+    VkDeviceSize blockSize = MAX_BLOCK_SIZE;
+    while (blockSize > MIN_BLOCK_SIZE && blockSize > heapSize / 8) {
+      blockSize >>= 1;
+    }
+
+    for (uint32_t kind = 0; kind < 2; kind++) {
+      pools[i * 2 + kind].memoryType = i;
+      pools[i * 2 + kind].blockSize = blockSize;
+    }
+  }
+}
+
+VulkanAllocator::~VulkanAllocator() {
+  for (MemoryPool &pool : pools) {
+    for (VulkanMemoryBlock *block : pool.blocks) {
+      if (block->allocationCount != 0) {
+        std::cout << "VulkanAllocator: " << block->allocationCount
+                  << " allocations still alive in memory type "
+                  << pool.memoryType << "\n";
+      }
+      destroyBlock(block);
+    }
+    pool.blocks.clear();
+  }
+  if (dedicatedCount != 0) {
+    std::cout << "VulkanAllocator: " << dedicatedCount
+              << " dedicated allocations still alive\n";
+  }
+}
+
+uint32_t VulkanAllocator::findMemoryType(uint32_t typeBits,
+                                         VkMemoryPropertyFlags properties) {
+  for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+    if (typeBits & (1 << i) &&
+        (memoryProperties.memoryTypes[i].propertyFlags & properties) ==
+            properties) {
+      return i;
+    }
+  }
+  throw std::runtime_error("Failed to find memory type!");
+}
+
+VulkanAllocation
+VulkanAllocator::allocate(const VkMemoryRequirements &requirements,
+                          VkMemoryPropertyFlags properties, bool optimalImage,
+                          bool dedicated, VkBuffer dedicatedBuffer,
+                          VkImage dedicatedImage) {
+  uint32_t memoryType =
+      findMemoryType(requirements.memoryTypeBits, properties);
+  MemoryPool &pool =
+      pools[memoryType * 2 + (separateOptimalBlocks && optimalImage ? 1 : 0)];
+
+  // Nodes are aligned to their own size, so rounding up to the alignment
+  // handles both
+  VkDeviceSize nodeSize = std::max(requirements.size, requirements.alignment);
+  if (dedicated || nodeSize > pool.blockSize / 2) {
+    return allocateDedicated(requirements, memoryType, dedicatedBuffer,
+                             dedicatedImage);
+  }
+  uint32_t order = orderForSize(nodeSize);
+
+  std::lock_guard<std::mutex> lock(mutex);
+
+  VulkanAllocation allocation{};
+  VkDeviceSize offset = 0;
+  VulkanMemoryBlock *block = nullptr;
+  for (VulkanMemoryBlock *candidate : pool.blocks) {
+    if (candidate->freeBytes >= (MIN_NODE_SIZE << order) &&
+        candidate->allocate(order, offset)) {
+      block = candidate;
+      break;
+    }
+  }
+  if (block == nullptr) {
+    block = createBlock(pool);
+    if (!block->allocate(order, offset)) {
+      throw std::runtime_error("failed to sub-allocate from a new block!");
+    }
+  }
+
+  allocation.memory = block->memory;
+  allocation.offset = offset;
+  allocation.size = MIN_NODE_SIZE << order;
+  allocation.block = block;
+  allocation.order = order;
+  if (block->mapped != nullptr) {
+    allocation.mapped = static_cast<uint8_t *>(block->mapped) + offset;
+  }
+
+  allocationCount++;
+  allocatedBytes += allocation.size;
+  return allocation;
+}
+
+VulkanAllocation
+VulkanAllocator::allocateDedicated(const VkMemoryRequirements &requirements,
+                                   uint32_t memoryType, VkBuffer buffer,
+                                   VkImage image) {
+  VkMemoryDedicatedAllocateInfo dedicatedInfo{};
+  dedicatedInfo.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+  dedicatedInfo.buffer = buffer;
+  dedicatedInfo.image = image;
+
+  VkMemoryAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  allocInfo.allocationSize = requirements.size;
+  allocInfo.memoryTypeIndex = memoryType;
+  if (buffer != VK_NULL_HANDLE || image != VK_NULL_HANDLE) {
+    allocInfo.pNext = &dedicatedInfo;
+  }
+
+  VulkanAllocation allocation{};
+  allocation.size = requirements.size;
+  if (vkAllocateMemory(device, &allocInfo, nullptr, &allocation.memory) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to allocate dedicated memory!");
+  }
+  if (memoryProperties.memoryTypes[memoryType].propertyFlags &
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+    if (vkMapMemory(device, allocation.memory, 0, VK_WHOLE_SIZE, 0,
+                    &allocation.mapped) != VK_SUCCESS) {
+      throw std::runtime_error("failed to map dedicated memory!");
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(mutex);
+  dedicatedCount++;
+  dedicatedBytes += allocation.size;
+  return allocation;
+}
+
+void VulkanAllocator::free(VulkanAllocation &allocation) {
+  if (allocation.memory == VK_NULL_HANDLE) {
+    return;
+  }
+
+  if (allocation.block == nullptr) {
+    // Freeing implicitly unmaps
+    vkFreeMemory(device, allocation.memory, nullptr);
+    std::lock_guard<std::mutex> lock(mutex);
+    dedicatedCount--;
+    dedicatedBytes -= allocation.size;
+    allocation = VulkanAllocation{};
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex);
+  VulkanMemoryBlock *block = allocation.block;
+  block->free(allocation.offset, allocation.order);
+  allocationCount--;
+  allocatedBytes -= allocation.size;
+
+  // Give empty blocks back, but keep one per pool around so a resource that
+  // gets recreated every frame doesn't hit vkAllocateMemory each time
+  MemoryPool &pool = pools[block->pool];
+  if (block->allocationCount == 0 && pool.blocks.size() > 1) {
+    pool.blocks.erase(std::find(pool.blocks.begin(), pool.blocks.end(), block));
+    destroyBlock(block);
+  }
+  allocation = VulkanAllocation{};
+}
+
+VulkanMemoryBlock *VulkanAllocator::createBlock(MemoryPool &pool) {
+  VkMemoryAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  allocInfo.allocationSize = pool.blockSize;
+  allocInfo.memoryTypeIndex = pool.memoryType;
+
+  VulkanMemoryBlock *block = new VulkanMemoryBlock();
+  block->size = pool.blockSize;
+  block->mapped = nullptr;
+  block->pool = static_cast<uint32_t>(&pool - pools.data());
+  if (vkAllocateMemory(device, &allocInfo, nullptr, &block->memory) !=
+      VK_SUCCESS) {
+    delete block;
+    throw std::runtime_error("failed to allocate memory block!");
+  }
+  if (memoryProperties.memoryTypes[pool.memoryType].propertyFlags &
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+    if (vkMapMemory(device, block->memory, 0, VK_WHOLE_SIZE, 0,
+                    &block->mapped) != VK_SUCCESS) {
+      vkFreeMemory(device, block->memory, nullptr);
+      delete block;
+      throw std::runtime_error("failed to map memory block!");
+    }
+  }
+
+  // The whole block starts out as one free node
+  block->maxOrder = orderForSize(block->size);
+  block->freeNodes.resize(block->maxOrder + 1);
+  block->freeNodes[block->maxOrder].insert(0);
+  block->freeBytes = block->size;
+
+  pool.blocks.push_back(block);
+  return block;
+}
+
+void VulkanAllocator::destroyBlock(VulkanMemoryBlock *block) {
+  vkFreeMemory(device, block->memory, nullptr);
+  delete block;
+}
+
+VulkanAllocation
+VulkanAllocator::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
+                              VkMemoryPropertyFlags properties,
+                              VkBuffer &buffer,
+                              std::vector<uint32_t> queueFamilies) {
+  VkBufferCreateInfo bufferInfo{};
+  bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  bufferInfo.size = size;
+  bufferInfo.usage = usage;
+  bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+  // Concurrent sharing needs distinct families
+  std::sort(queueFamilies.begin(), queueFamilies.end());
+  queueFamilies.erase(std::unique(queueFamilies.begin(), queueFamilies.end()),
+                      queueFamilies.end());
+  if (queueFamilies.size() > 1) {
+    bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+    bufferInfo.queueFamilyIndexCount =
+        static_cast<uint32_t>(queueFamilies.size());
+    bufferInfo.pQueueFamilyIndices = queueFamilies.data();
+  }
+
+  if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create buffer!");
+  }
+
+  // The driver can ask for a dedicated allocation along with the size
+  VkMemoryDedicatedRequirements dedicatedRequirements{};
+  dedicatedRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+  VkMemoryRequirements2 memRequirements{};
+  memRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+  memRequirements.pNext = &dedicatedRequirements;
+  VkBufferMemoryRequirementsInfo2 requirementsInfo{};
+  requirementsInfo.sType =
+      VK_STRUCTURE_TYPE_BUFFER_MEMORY_REQUIREMENTS_INFO_2;
+  requirementsInfo.buffer = buffer;
+  vkGetBufferMemoryRequirements2(device, &requirementsInfo, &memRequirements);
+
+  bool dedicated = dedicatedRequirements.prefersDedicatedAllocation ||
+                   dedicatedRequirements.requiresDedicatedAllocation;
+  VulkanAllocation allocation =
+      allocate(memRequirements.memoryRequirements, properties, false,
+               dedicated, buffer, VK_NULL_HANDLE);
+  vkBindBufferMemory(device, buffer, allocation.memory, allocation.offset);
+  return allocation;
+}
+
+VulkanAllocation VulkanAllocator::createImage(const VkImageCreateInfo &imageInfo,
+                                              VkMemoryPropertyFlags properties,
+                                              VkImage &image, bool dedicated) {
+  if (vkCreateImage(device, &imageInfo, nullptr, &image) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create image!");
+  }
+
+  VkMemoryDedicatedRequirements dedicatedRequirements{};
+  dedicatedRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+  VkMemoryRequirements2 memRequirements{};
+  memRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+  memRequirements.pNext = &dedicatedRequirements;
+  VkImageMemoryRequirementsInfo2 requirementsInfo{};
+  requirementsInfo.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2;
+  requirementsInfo.image = image;
+  vkGetImageMemoryRequirements2(device, &requirementsInfo, &memRequirements);
+
+  dedicated = dedicated || dedicatedRequirements.prefersDedicatedAllocation ||
+              dedicatedRequirements.requiresDedicatedAllocation;
+  VulkanAllocation allocation = allocate(
+      memRequirements.memoryRequirements, properties,
+      imageInfo.tiling == VK_IMAGE_TILING_OPTIMAL, dedicated, VK_NULL_HANDLE,
+      image);
+  vkBindImageMemory(device, image, allocation.memory, allocation.offset);
+  return allocation;
+}
+
+void VulkanAllocator::destroyBuffer(VkBuffer &buffer,
+                                    VulkanAllocation &allocation) {
+  vkDestroyBuffer(device, buffer, nullptr);
+  buffer = VK_NULL_HANDLE;
+  free(allocation);
+}
+
+void VulkanAllocator::destroyImage(VkImage &image,
+                                   VulkanAllocation &allocation) {
+  vkDestroyImage(device, image, nullptr);
+  image = VK_NULL_HANDLE;
+  free(allocation);
+}
+
+double VulkanAllocator::fragmentation() {
+  std::lock_guard<std::mutex> lock(mutex);
+  VkDeviceSize freeBytes = 0;
+  VkDeviceSize largestFree = 0;
+  for (MemoryPool &pool : pools) {
+    for (VulkanMemoryBlock *block : pool.blocks) {
+      freeBytes += block->freeBytes;
+      largestFree += block->largestFreeNode();
+    }
+  }
+  if (freeBytes == 0) {
+    return 0.0;
+  }
+  return 1.0 - static_cast<double>(largestFree) / freeBytes;
+}
+
+void VulkanAllocator::printStats() {
+  std::lock_guard<std::mutex> lock(mutex);
+  std::cout << "VulkanAllocator: " << allocationCount << " sub-allocations ("
+            << allocatedBytes / 1024 << " KB), " << dedicatedCount
+            << " dedicated (" << dedicatedBytes / 1024 << " KB)\n";
+  for (MemoryPool &pool : pools) {
+    if (pool.blocks.empty()) {
+      continue;
+    }
+    VkDeviceSize freeBytes = 0;
+    for (VulkanMemoryBlock *block : pool.blocks) {
+      freeBytes += block->freeBytes;
+    }
+    std::cout << "  memory type " << pool.memoryType << ": "
+              << pool.blocks.size() << " x " << pool.blockSize / (1024 * 1024)
+              << " MB blocks, " << freeBytes / 1024 << " KB free\n";
+  }
+}
+
+//==============================================
+// --alloc-benchmark
+//==============================================
+
+void runAllocatorBenchmark(VulkanAllocator &allocator) {
+  using Clock = std::chrono::steady_clock;
+  using Seconds = std::chrono::duration<double>;
+
+  const uint32_t liveAllocations = 1000;
+  const uint32_t operations = 100000;
+  const uint32_t rawAllocations = 200;
+  const double minSize = 256;
+  const double maxSize = 1 << 20;
+
+  // Any device local type, only memory is allocated, no resources
+  VkMemoryRequirements requirements{};
+  requirements.memoryTypeBits = ~0u;
+  requirements.alignment = 256;
+
+  // Sizes spread evenly in log space, lots of small and some big ones like a
+  // real mix of buffers and textures
+  std::mt19937 random(1234);
+  std::uniform_real_distribution<double> logSize(std::log(minSize),
+                                                 std::log(maxSize));
+  auto randomSize = [&] {
+    return static_cast<VkDeviceSize>(std::exp(logSize(random)));
+  };
+
+  std::cout << "Allocator benchmark: " << liveAllocations
+            << " live allocations, " << operations
+            << " random free + allocate pairs, " << minSize << " B to "
+            << maxSize / (1024 * 1024) << " MB\n";
+
+  std::vector<VulkanAllocation> allocations(liveAllocations);
+  std::vector<VkDeviceSize> requested(liveAllocations);
+  VkDeviceSize requestedBytes = 0;
+  for (uint32_t i = 0; i < liveAllocations; i++) {
+    requirements.size = requested[i] = randomSize();
+    requestedBytes += requested[i];
+    allocations[i] = allocator.allocate(
+        requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false, false);
+  }
+
+  std::uniform_int_distribution<uint32_t> pick(0, liveAllocations - 1);
+  auto start = Clock::now();
+  for (uint32_t i = 0; i < operations; i++) {
+    uint32_t slot = pick(random);
+    allocator.free(allocations[slot]);
+    requestedBytes -= requested[slot];
+    requirements.size = requested[slot] = randomSize();
+    requestedBytes += requested[slot];
+    allocations[slot] = allocator.allocate(
+        requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false, false);
+  }
+  double seconds = Seconds(Clock::now() - start).count();
+
+  VkDeviceSize blockBytes = 0;
+  uint32_t blockCount = 0;
+  for (VulkanAllocator::MemoryPool &pool : allocator.pools) {
+    blockCount += static_cast<uint32_t>(pool.blocks.size());
+    blockBytes += pool.blocks.size() * pool.blockSize;
+  }
+
+  std::cout << std::fixed << std::setprecision(2);
+  std::cout << "  sub-allocator: " << operations / seconds / 1e6
+            << " M free + allocate pairs/s, "
+            << seconds * 1e9 / operations << " ns each\n";
+  std::cout << "  " << blockCount << " blocks, " << requestedBytes / 1e6
+            << " MB requested in " << blockBytes / 1e6 << " MB ("
+            << 100.0 * requestedBytes / blockBytes << "% utilization), "
+            << 100.0 * allocator.fragmentation()
+            << "% of free memory fragmented\n";
+
+  for (VulkanAllocation &allocation : allocations) {
+    allocator.free(allocation);
+  }
+
+  // The same sizes straight from vkAllocateMemory, fewer of them since
+  // drivers only guarantee maxMemoryAllocationCount (4096) live allocations
+  VkMemoryAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  allocInfo.memoryTypeIndex = allocator.findMemoryType(
+      ~0u, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  std::vector<VkDeviceMemory> rawMemory(rawAllocations);
+  start = Clock::now();
+  for (uint32_t i = 0; i < rawAllocations; i++) {
+    allocInfo.allocationSize = randomSize();
+    if (vkAllocateMemory(allocator.device, &allocInfo, nullptr,
+                         &rawMemory[i]) != VK_SUCCESS) {
+      throw std::runtime_error("failed to allocate benchmark memory!");
+    }
+  }
+  for (uint32_t i = 0; i < rawAllocations; i++) {
+    vkFreeMemory(allocator.device, rawMemory[i], nullptr);
+  }
+  double rawSeconds = Seconds(Clock::now() - start).count();
+
+  std::cout << "  vkAllocateMemory: " << rawAllocations / rawSeconds / 1e6
+            << " M allocate + free pairs/s, "
+            << rawSeconds * 1e9 / rawAllocations << " ns each ("
+            << (rawSeconds / rawAllocations) / (seconds / operations)
+            << "x slower)\n";
+  std::cout.unsetf(std::ios::fixed);
+}
+} // namespace VulkanStuff
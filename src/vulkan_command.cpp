@@ -1,48 +1,101 @@
-
 #include <vulkan_command.hpp>
 
 namespace VulkanStuff {
 VulkanCommand::VulkanCommand(VkPhysicalDevice inputPhysicalDevice,
                              VkDevice inputDevice, VkSurfaceKHR inputSurface,
-                             uint32_t number)
+                             uint32_t number, uint32_t inputThreadCount)
     : physicalDevice{inputPhysicalDevice}, surface{inputSurface},
-      device{inputDevice} {
+      device{inputDevice}, threadCount{inputThreadCount} {
   createCommandPool();
   createCommandBuffers(number);
 }
 VulkanCommand::~VulkanCommand() {
+  freeCommandBuffers();
   vkDestroyCommandPool(device, commandPool, nullptr);
 }
 
-void VulkanCommand::createCommandPool() {
-  Utils::QueueFamilyIndices queueFamilyIndices =
-      Utils::findQueueFamilies(physicalDevice, surface);
-
+VkCommandPool VulkanCommand::createPool(VkCommandPoolCreateFlags flags) {
   VkCommandPoolCreateInfo poolInfo{};
   poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-  poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-  poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
+  poolInfo.flags = flags;
+  poolInfo.queueFamilyIndex = graphicsFamily;
 
-  if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool) !=
-      VK_SUCCESS) {
+  VkCommandPool pool;
+  if (vkCreateCommandPool(device, &poolInfo, nullptr, &pool) != VK_SUCCESS) {
     throw std::runtime_error("failed to create command pool!");
   }
+  return pool;
+}
+
+void VulkanCommand::createCommandPool() {
+  Utils::QueueFamilyIndices queueFamilyIndices =
+      Utils::findQueueFamilies(physicalDevice, surface);
+  graphicsFamily = queueFamilyIndices.graphicsFamily.value();
+
+  commandPool = createPool(VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
 }
 
 void VulkanCommand::createCommandBuffers(uint32_t number) {
 
+  frameCommands.resize(number);
   commandBuffers.resize(number);
 
-  VkCommandBufferAllocateInfo allocInfo{};
-  allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-  allocInfo.commandPool = commandPool;
-  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-  allocInfo.commandBufferCount = (uint32_t)commandBuffers.size();
+  for (uint32_t i = 0; i < number; i++) {
+    FrameCommands &frame = frameCommands[i];
 
-  if (vkAllocateCommandBuffers(device, &allocInfo, commandBuffers.data()) !=
-      VK_SUCCESS) {
-    throw std::runtime_error("failed to allocate command buffers!");
+    // Reset as a whole every frame, so no per buffer reset bit
+    frame.primaryPool = createPool(VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = frame.primaryPool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = 1;
+
+    if (vkAllocateCommandBuffers(device, &allocInfo, &commandBuffers[i]) !=
+        VK_SUCCESS) {
+      throw std::runtime_error("failed to allocate command buffers!");
+    }
+
+    frame.threadPools.resize(threadCount);
+    frame.secondaryBuffers.resize(threadCount);
+    for (uint32_t thread = 0; thread < threadCount; thread++) {
+      frame.threadPools[thread] =
+          createPool(VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+
+      allocInfo.commandPool = frame.threadPools[thread];
+      allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+      if (vkAllocateCommandBuffers(device, &allocInfo,
+                                   &frame.secondaryBuffers[thread]) !=
+          VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate command buffers!");
+      }
+    }
+  }
+}
+
+void VulkanCommand::freeCommandBuffers() {
+  // Destroying a pool frees its buffers
+  for (FrameCommands &frame : frameCommands) {
+    vkDestroyCommandPool(device, frame.primaryPool, nullptr);
+    for (VkCommandPool pool : frame.threadPools) {
+      vkDestroyCommandPool(device, pool, nullptr);
+    }
+  }
+  frameCommands.clear();
+  commandBuffers.clear();
+}
+
+void VulkanCommand::resetFrame(uint32_t frameIndex) {
+  FrameCommands &frame = frameCommands[frameIndex];
+  if (vkResetCommandPool(device, frame.primaryPool, 0) != VK_SUCCESS) {
+    throw std::runtime_error("failed to reset command pool!");
+  }
+  for (VkCommandPool pool : frame.threadPools) {
+    if (vkResetCommandPool(device, pool, 0) != VK_SUCCESS) {
+      throw std::runtime_error("failed to reset command pool!");
+    }
   }
 }
 
-} // namespace VulkanStuff
\ No newline at end of file
+} // namespace VulkanStuff
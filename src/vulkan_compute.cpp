@@ -0,0 +1,132 @@
+#include <vulkan_compute.hpp>
+
+namespace VulkanStuff {
+
+VulkanCompute::VulkanCompute(VkDevice inputDevice, VkQueue inputComputeQueue,
+                             uint32_t inputComputeFamily,
+                             VulkanTimeline *inputComputeTimeline,
+                             VulkanTimeline *inputGraphicsTimeline,
+                             uint32_t slotCount)
+    : device{inputDevice}, computeQueue{inputComputeQueue},
+      computeFamily{inputComputeFamily},
+      computeTimeline{inputComputeTimeline},
+      graphicsTimeline{inputGraphicsTimeline} {
+  frameSlots.resize(slotCount);
+
+  VkCommandPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+  poolInfo.queueFamilyIndex = computeFamily;
+
+  for (FrameSlot &slot : frameSlots) {
+    if (vkCreateCommandPool(device, &poolInfo, nullptr, &slot.commandPool) !=
+        VK_SUCCESS) {
+      throw std::runtime_error("failed to create compute command pool!");
+    }
+  }
+}
+
+VulkanCompute::~VulkanCompute() {
+  // The owner waits for the device to go idle first
+  for (FrameSlot &slot : frameSlots) {
+    vkDestroyCommandPool(device, slot.commandPool, nullptr);
+  }
+}
+
+void VulkanCompute::beginFrame(uint32_t frameIndex) {
+  currentSlot = frameIndex;
+  frameWaitValue = 0;
+  frameWaitStages = 0;
+
+  FrameSlot &slot = frameSlots[currentSlot];
+  if (slot.usedCommandBuffers == 0) {
+    return;
+  }
+  // Normally long done, the graphics frame of this slot waited for it
+  computeTimeline->wait(slot.lastValue);
+  vkResetCommandPool(device, slot.commandPool, 0);
+  slot.usedCommandBuffers = 0;
+}
+
+VkCommandBuffer VulkanCompute::beginCommandBuffer() {
+  FrameSlot &slot = frameSlots[currentSlot];
+  if (slot.usedCommandBuffers == slot.commandBuffers.size()) {
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = slot.commandPool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = 1;
+
+    VkCommandBuffer commandBuffer;
+    if (vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer) !=
+        VK_SUCCESS) {
+      throw std::runtime_error("failed to allocate compute command buffer!");
+    }
+    slot.commandBuffers.push_back(commandBuffer);
+  }
+  VkCommandBuffer commandBuffer =
+      slot.commandBuffers[slot.usedCommandBuffers++];
+
+  VkCommandBufferBeginInfo beginInfo{};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+    throw std::runtime_error("failed to begin compute command buffer!");
+  }
+  return commandBuffer;
+}
+
+uint64_t VulkanCompute::submitCommandBuffer(
+    VkCommandBuffer commandBuffer, VkPipelineStageFlags2KHR consumerStages,
+    uint64_t waitGraphicsValue, VkPipelineStageFlags2KHR waitStages) {
+  PROFILE_FUNCTION();
+  if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+    throw std::runtime_error("failed to record compute command buffer!");
+  }
+
+  uint64_t signalValue = computeTimeline->nextValue();
+
+  VkCommandBufferSubmitInfoKHR commandBufferInfo{};
+  commandBufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO_KHR;
+  commandBufferInfo.commandBuffer = commandBuffer;
+
+  VkSemaphoreSubmitInfoKHR waitInfo{};
+  waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO_KHR;
+  waitInfo.semaphore = graphicsTimeline->semaphore;
+  waitInfo.value = waitGraphicsValue;
+  waitInfo.stageMask = waitStages;
+
+  VkSemaphoreSubmitInfoKHR signalInfo{};
+  signalInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO_KHR;
+  signalInfo.semaphore = computeTimeline->semaphore;
+  signalInfo.value = signalValue;
+  signalInfo.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT_KHR;
+
+  VkSubmitInfo2KHR submitInfo{};
+  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2_KHR;
+  // A value the GPU already passed needs no wait
+  if (!graphicsTimeline->isComplete(waitGraphicsValue)) {
+    submitInfo.waitSemaphoreInfoCount = 1;
+    submitInfo.pWaitSemaphoreInfos = &waitInfo;
+  }
+  submitInfo.commandBufferInfoCount = 1;
+  submitInfo.pCommandBufferInfos = &commandBufferInfo;
+  submitInfo.signalSemaphoreInfoCount = 1;
+  submitInfo.pSignalSemaphoreInfos = &signalInfo;
+
+  if (vkQueueSubmit2KHR(computeQueue, 1, &submitInfo, VK_NULL_HANDLE) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to submit compute command buffer!");
+  }
+
+  frameSlots[currentSlot].lastValue = signalValue;
+  if (consumerStages != 0) {
+    // Submissions on one queue signal in order, waiting for the last one
+    // covers everything before it
+    frameWaitValue = signalValue;
+    frameWaitStages |= consumerStages;
+  }
+  submissionCount++;
+  return signalValue;
+}
+} // namespace VulkanStuff
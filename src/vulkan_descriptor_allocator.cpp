@@ -0,0 +1,184 @@
+#include <vulkan_descriptor_allocator.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace VulkanStuff {
+
+// FNV-1a, 64 bit. A collision would hand out the wrong set, which at 64
+// bits is a risk worth taking for a per frame cache
+static uint64_t hashBytes(uint64_t hash, const void *data, size_t size) {
+  const uint8_t *bytes = static_cast<const uint8_t *>(data);
+  for (size_t i = 0; i < size; i++) {
+    hash ^= bytes[i];
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+
+VulkanDescriptorAllocator::VulkanDescriptorAllocator(
+    VkDevice inputDevice, uint32_t frameSlotCount,
+    std::vector<PoolRatio> inputRatios, uint32_t initialSetsPerPool)
+    : device{inputDevice}, ratios{inputRatios},
+      setsPerPool{std::clamp(initialSetsPerPool, 1u, MAX_SETS_PER_POOL)} {
+  frameSlots.resize(frameSlotCount);
+}
+
+VulkanDescriptorAllocator::~VulkanDescriptorAllocator() {
+  // The owner waits for the device to go idle first
+  for (const DescriptorTemplate &descriptorTemplate : templates) {
+    vkDestroyDescriptorUpdateTemplate(device, descriptorTemplate.updateTemplate,
+                                      nullptr);
+  }
+  for (PoolChain &slot : frameSlots) {
+    freePools.insert(freePools.end(), slot.pools.begin(), slot.pools.end());
+  }
+  freePools.insert(freePools.end(), persistentPools.pools.begin(),
+                   persistentPools.pools.end());
+  for (VkDescriptorPool pool : freePools) {
+    vkDestroyDescriptorPool(device, pool, nullptr);
+  }
+}
+
+DescriptorTemplate VulkanDescriptorAllocator::createTemplate(
+    VkDescriptorSetLayout layout,
+    const std::vector<VkDescriptorUpdateTemplateEntry> &entries,
+    size_t dataSize) {
+  VkDescriptorUpdateTemplateCreateInfo templateInfo{};
+  templateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO;
+  templateInfo.descriptorUpdateEntryCount =
+      static_cast<uint32_t>(entries.size());
+  templateInfo.pDescriptorUpdateEntries = entries.data();
+  templateInfo.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET;
+  templateInfo.descriptorSetLayout = layout;
+
+  DescriptorTemplate descriptorTemplate;
+  descriptorTemplate.layout = layout;
+  descriptorTemplate.dataSize = dataSize;
+  if (vkCreateDescriptorUpdateTemplate(device, &templateInfo, nullptr,
+                                       &descriptorTemplate.updateTemplate) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create descriptor update template!");
+  }
+  templates.push_back(descriptorTemplate);
+  return descriptorTemplate;
+}
+
+void VulkanDescriptorAllocator::beginFrame(uint32_t frameIndex) {
+  currentFrame = frameIndex;
+  PoolChain &slot = frameSlots[frameIndex];
+  for (VkDescriptorPool pool : slot.pools) {
+    vkResetDescriptorPool(device, pool, 0);
+    freePools.push_back(pool);
+  }
+  slot.pools.clear();
+}
+
+void VulkanDescriptorAllocator::resetPersistent() {
+  for (VkDescriptorPool pool : persistentPools.pools) {
+    vkResetDescriptorPool(device, pool, 0);
+    freePools.push_back(pool);
+  }
+  persistentPools.pools.clear();
+  setCache.clear();
+}
+
+VkDescriptorSet
+VulkanDescriptorAllocator::allocateTransient(VkDescriptorSetLayout layout) {
+  return allocate(frameSlots[currentFrame], layout);
+}
+
+VkDescriptorSet
+VulkanDescriptorAllocator::allocatePersistent(VkDescriptorSetLayout layout) {
+  return allocate(persistentPools, layout);
+}
+
+VkDescriptorSet
+VulkanDescriptorAllocator::getSet(const DescriptorTemplate &descriptorTemplate,
+                                  const void *data) {
+  uint64_t hash = 0xcbf29ce484222325ull;
+  hash = hashBytes(hash, &descriptorTemplate.updateTemplate,
+                   sizeof(descriptorTemplate.updateTemplate));
+  hash = hashBytes(hash, data, descriptorTemplate.dataSize);
+
+  auto cached = setCache.find(hash);
+  if (cached != setCache.end()) {
+    cacheHits++;
+    return cached->second;
+  }
+
+  VkDescriptorSet descriptorSet =
+      allocatePersistent(descriptorTemplate.layout);
+  write(descriptorSet, descriptorTemplate, data);
+  setCache.emplace(hash, descriptorSet);
+  return descriptorSet;
+}
+
+void VulkanDescriptorAllocator::write(
+    VkDescriptorSet descriptorSet, const DescriptorTemplate &descriptorTemplate,
+    const void *data) {
+  vkUpdateDescriptorSetWithTemplate(device, descriptorSet,
+                                    descriptorTemplate.updateTemplate, data);
+}
+
+VkDescriptorSet VulkanDescriptorAllocator::allocate(
+    PoolChain &chain, VkDescriptorSetLayout layout) {
+  if (chain.pools.empty()) {
+    chain.pools.push_back(takePool());
+  }
+
+  VkDescriptorSetAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocInfo.descriptorPool = chain.pools.back();
+  allocInfo.descriptorSetCount = 1;
+  allocInfo.pSetLayouts = &layout;
+
+  VkDescriptorSet descriptorSet;
+  VkResult result =
+      vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet);
+  if (result == VK_ERROR_OUT_OF_POOL_MEMORY ||
+      result == VK_ERROR_FRAGMENTED_POOL) {
+    // The full pool stays in the chain until it is reset
+    chain.pools.push_back(takePool());
+    allocInfo.descriptorPool = chain.pools.back();
+    result = vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet);
+  }
+  if (result != VK_SUCCESS) {
+    throw std::runtime_error("failed to allocate descriptor sets!");
+  }
+  setsAllocated++;
+  return descriptorSet;
+}
+
+VkDescriptorPool VulkanDescriptorAllocator::takePool() {
+  if (!freePools.empty()) {
+    VkDescriptorPool pool = freePools.back();
+    freePools.pop_back();
+    return pool;
+  }
+
+  std::vector<VkDescriptorPoolSize> poolSizes;
+  for (const PoolRatio &ratio : ratios) {
+    VkDescriptorPoolSize poolSize{};
+    poolSize.type = ratio.type;
+    poolSize.descriptorCount = std::max(
+        static_cast<uint32_t>(std::ceil(ratio.perSet * setsPerPool)), 1u);
+    poolSizes.push_back(poolSize);
+  }
+
+  VkDescriptorPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+  poolInfo.pPoolSizes = poolSizes.data();
+  poolInfo.maxSets = setsPerPool;
+
+  VkDescriptorPool pool;
+  if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &pool) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create descriptor pool!");
+  }
+  poolCount++;
+  setsPerPool = std::min(setsPerPool * 2, MAX_SETS_PER_POOL);
+  return pool;
+}
+} // namespace VulkanStuff
@@ -1,7 +1,24 @@
 
 #include <vulkan_device.hpp>
 namespace VulkanStuff {
-VulkanDevice::VulkanDevice(SDL_Window *sdlWindow) : window{sdlWindow} {
+VulkanDevice::VulkanDevice(SDL_Window *sdlWindow,
+                           bool requestDynamicRendering)
+    : window{sdlWindow}, headless{sdlWindow == nullptr},
+      dynamicRendering{requestDynamicRendering} {
+  PROFILE_FUNCTION();
+  if (headless) {
+    // Nothing is presented, so don't require the swapchain extensions
+    std::set<std::string> swapchainExtensions = {
+        VK_KHR_SWAPCHAIN_EXTENSION_NAME,
+        VK_KHR_SWAPCHAIN_MUTABLE_FORMAT_EXTENSION_NAME};
+    deviceExtensions.erase(
+        std::remove_if(deviceExtensions.begin(), deviceExtensions.end(),
+                       [&](const char *name) {
+                         return swapchainExtensions.count(name) > 0;
+                       }),
+        deviceExtensions.end());
+  }
+
   createInstance();
   setupDebugMessenger();
   createSurface();
@@ -76,13 +93,19 @@ VulkanDevice::~VulkanDevice() {
     // Can remove this line to trigger validation layer error
     DestroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
   }
+  // Writes the cache back before the device goes
+  delete pipelineCache;
+  delete allocator;
   vkDestroyDevice(logicalDevice, nullptr);
-  vkDestroySurfaceKHR(instance, surface, nullptr);
+  if (surface != VK_NULL_HANDLE) {
+    vkDestroySurfaceKHR(instance, surface, nullptr);
+  }
   // have to destroy logical device first it seems
   vkDestroyInstance(instance, nullptr);
 }
 
 void VulkanDevice::createInstance() {
+  loadGlobalFunctions();
 
   if (enableValidationLayers && !checkValidationLayerSupport()) {
     throw std::runtime_error("Validation Layer requested but not available\n");
@@ -129,6 +152,7 @@ void VulkanDevice::createInstance() {
   if (vkCreateInstance(&createInfo, nullptr, &instance) != VK_SUCCESS) {
     throw std::runtime_error("failed to create instance!");
   }
+  loadInstanceFunctions(instance);
 }
 
 bool VulkanDevice::checkValidationLayerSupport() {
@@ -164,6 +188,10 @@ bool VulkanDevice::checkValidationLayerSupport() {
 }
 std::vector<const char *> VulkanDevice::getRequiredVkExtensions() {
 
+  if (headless) {
+    return {VK_EXT_DEBUG_UTILS_EXTENSION_NAME};
+  }
+
   unsigned int extensionCount;
 
   if (!SDL_Vulkan_GetInstanceExtensions(window, &extensionCount, nullptr)) {
@@ -258,6 +286,10 @@ void VulkanDevice::DestroyDebugUtilsMessengerEXT(
 }
 
 void VulkanDevice::createSurface() {
+  if (headless) {
+    surface = VK_NULL_HANDLE;
+    return;
+  }
   if (SDL_Vulkan_CreateSurface(window, instance, &surface) != SDL_TRUE) {
     throw std::runtime_error("failed to create window surface!");
   }
@@ -291,11 +323,35 @@ void VulkanDevice::pickPhysicalDevice() {
     std::cout << "Picked " << deviceProperties.deviceName
               << " Vendor: " << deviceProperties.vendorID << "\n";
 
+    deviceName = deviceProperties.deviceName;
     deviceTimestampPeriod = deviceProperties.limits.timestampPeriod;
     std::cout << "timestampPeriod: " << deviceTimestampPeriod << "\n";
+
+    msaaSamples = getMaxUsableSampleCount();
+    std::cout << "msaaSamples: " << msaaSamples << "\n";
   }
 }
 
+VkSampleCountFlagBits VulkanDevice::getMaxUsableSampleCount() {
+  VkPhysicalDeviceProperties deviceProperties;
+  vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+
+  VkSampleCountFlags counts =
+      deviceProperties.limits.framebufferColorSampleCounts &
+      deviceProperties.limits.framebufferDepthSampleCounts;
+
+  if (counts & VK_SAMPLE_COUNT_8_BIT) {
+    return VK_SAMPLE_COUNT_8_BIT;
+  }
+  if (counts & VK_SAMPLE_COUNT_4_BIT) {
+    return VK_SAMPLE_COUNT_4_BIT;
+  }
+  if (counts & VK_SAMPLE_COUNT_2_BIT) {
+    return VK_SAMPLE_COUNT_2_BIT;
+  }
+  return VK_SAMPLE_COUNT_1_BIT;
+}
+
 bool VulkanDevice::isDeviceSuitable(VkPhysicalDevice device) {
 
   VkPhysicalDeviceProperties deviceProperties;
@@ -310,16 +366,114 @@ bool VulkanDevice::isDeviceSuitable(VkPhysicalDevice device) {
   Utils::QueueFamilyIndices indices = Utils::findQueueFamilies(device, surface);
 
   bool swapChainAdequate = false;
-  Utils::SwapChainSupportDetails swapChainSupport =
-      Utils::querySwapChainSupport(device, surface);
+  if (headless) {
+    swapChainAdequate = true;
+  } else {
+    Utils::SwapChainSupportDetails swapChainSupport =
+        Utils::querySwapChainSupport(device, surface);
 
-  swapChainAdequate = !swapChainSupport.formats.empty() &&
-                      !swapChainSupport.presentModes.empty();
+    swapChainAdequate = !swapChainSupport.formats.empty() &&
+                        !swapChainSupport.presentModes.empty();
+  }
 
   return indices.graphicsFamily.has_value() &&
          indices.presentFamily.has_value() &&
          checkDeviceExtensionSupport(device) && swapChainAdequate &&
-         deviceFeatures.samplerAnisotropy;
+         deviceFeatures.samplerAnisotropy && checkDeviceFeatureSupport(device);
+}
+
+bool VulkanDevice::checkDeviceFeatureSupport(VkPhysicalDevice device) {
+  // Frame synchronization is built on timeline semaphores and
+  // vkQueueSubmit2
+  VkPhysicalDeviceSynchronization2FeaturesKHR sync2Features{};
+  sync2Features.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR;
+
+  VkPhysicalDeviceVulkan12Features vk12Features{};
+  vk12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+  vk12Features.pNext = &sync2Features;
+
+  VkPhysicalDeviceFeatures2 features2{};
+  features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+  features2.pNext = &vk12Features;
+
+  vkGetPhysicalDeviceFeatures2(device, &features2);
+
+  // The texture table is one partially bound, update after bind array
+  // indexed per draw
+  bool textureTable =
+      features2.features.shaderSampledImageArrayDynamicIndexing &&
+      vk12Features.descriptorBindingPartiallyBound &&
+      vk12Features.descriptorBindingSampledImageUpdateAfterBind &&
+      vk12Features.descriptorBindingUpdateUnusedWhilePending;
+
+  return vk12Features.timelineSemaphore && sync2Features.synchronization2 &&
+         textureTable;
+}
+
+bool VulkanDevice::checkPresentWaitSupport(VkPhysicalDevice device) {
+  uint32_t extensionCount;
+  vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount,
+                                       nullptr);
+  std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+  vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount,
+                                       availableExtensions.data());
+
+  std::set<std::string> wantedExtensions = {
+      VK_KHR_PRESENT_ID_EXTENSION_NAME, VK_KHR_PRESENT_WAIT_EXTENSION_NAME};
+  for (const auto &extension : availableExtensions) {
+    wantedExtensions.erase(extension.extensionName);
+  }
+  if (!wantedExtensions.empty()) {
+    return false;
+  }
+
+  VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures{};
+  presentWaitFeatures.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+
+  VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures{};
+  presentIdFeatures.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+  presentIdFeatures.pNext = &presentWaitFeatures;
+
+  VkPhysicalDeviceFeatures2 features2{};
+  features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+  features2.pNext = &presentIdFeatures;
+  vkGetPhysicalDeviceFeatures2(device, &features2);
+
+  return presentIdFeatures.presentId && presentWaitFeatures.presentWait;
+}
+
+bool VulkanDevice::checkDynamicRenderingSupport(VkPhysicalDevice device) {
+  uint32_t extensionCount;
+  vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount,
+                                       nullptr);
+  std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+  vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount,
+                                       availableExtensions.data());
+
+  bool extensionFound = false;
+  for (const auto &extension : availableExtensions) {
+    if (std::string(extension.extensionName) ==
+        VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME) {
+      extensionFound = true;
+    }
+  }
+  if (!extensionFound) {
+    return false;
+  }
+
+  VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures{};
+  dynamicRenderingFeatures.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+
+  VkPhysicalDeviceFeatures2 features2{};
+  features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+  features2.pNext = &dynamicRenderingFeatures;
+  vkGetPhysicalDeviceFeatures2(device, &features2);
+
+  return dynamicRenderingFeatures.dynamicRendering;
 }
 
 bool VulkanDevice::checkDeviceExtensionSupport(VkPhysicalDevice device) {
@@ -354,22 +508,75 @@ void VulkanDevice::createLogicalDevice() {
 
   std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
 
-  // set will only contain unique values
-  std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily.value(),
-                                            indices.presentFamily.value()};
+  uint32_t queueFamilyCount = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount,
+                                           nullptr);
+  std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+  vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount,
+                                           queueFamilies.data());
+
+  graphicsFamily = indices.graphicsFamily.value();
+  uint32_t presentFamily = indices.presentFamily.value();
+
+  // Queues taken from each family so far. Graphics and present use queue 0
+  // of theirs, the other queues get a new one of their family while it has
+  // any left and share queue 0 after that
+  std::vector<uint32_t> familyQueueCounts(queueFamilyCount, 0);
+  familyQueueCounts[graphicsFamily] = 1;
+  familyQueueCounts[presentFamily] = 1;
+  auto reserveQueue = [&](uint32_t family) -> uint32_t {
+    if (familyQueueCounts[family] < queueFamilies[family].queueCount) {
+      return familyQueueCounts[family]++;
+    }
+    familyQueueCounts[family] = std::max(familyQueueCounts[family], 1u);
+    return 0;
+  };
+
+  // Pick where uploads run, so copies don't queue up behind rendering
+  transferFamily = indices.transferFamily.value_or(graphicsFamily);
+  uint32_t transferQueueIndex = reserveQueue(transferFamily);
+  if (indices.transferFamily.has_value()) {
+    std::cout << "Upload queue: transfer only family " << transferFamily
+              << "\n";
+  } else if (transferQueueIndex != 0) {
+    std::cout << "Upload queue: queue " << transferQueueIndex
+              << " of graphics family " << graphicsFamily << "\n";
+  } else {
+    std::cout << "Upload queue: shared with graphics\n";
+  }
+
+  // Same for compute, a compute family without graphics runs alongside the
+  // frame on most desktop GPUs
+  computeFamily = indices.computeFamily.value_or(graphicsFamily);
+  uint32_t computeQueueIndex = reserveQueue(computeFamily);
+  if (indices.computeFamily.has_value()) {
+    std::cout << "Compute queue: async compute family " << computeFamily
+              << "\n";
+  } else if (computeQueueIndex != 0) {
+    std::cout << "Compute queue: queue " << computeQueueIndex
+              << " of graphics family " << graphicsFamily << "\n";
+  } else {
+    std::cout << "Compute queue: shared with graphics\n";
+  }
 
   // create device queue
   // Assigns priorty to queues to influence scheduling of comand buffer
   // execution
-  float queuePriority = 1.0f;
-  for (int i = 0; i < uniqueQueueFamilies.size(); i++) {
+  std::vector<float> queuePriorities(
+      *std::max_element(familyQueueCounts.begin(), familyQueueCounts.end()),
+      1.0f);
+  for (uint32_t queueFamily = 0; queueFamily < queueFamilyCount;
+       queueFamily++) {
+    if (familyQueueCounts[queueFamily] == 0) {
+      continue;
+    }
 
     VkDeviceQueueCreateInfo queueCreateInfo{};
     queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-    queueCreateInfo.queueFamilyIndex = i;
-    queueCreateInfo.queueCount = 1;
+    queueCreateInfo.queueFamilyIndex = queueFamily;
+    queueCreateInfo.queueCount = familyQueueCounts[queueFamily];
 
-    queueCreateInfo.pQueuePriorities = &queuePriority;
+    queueCreateInfo.pQueuePriorities = queuePriorities.data();
     queueCreateInfos.push_back(queueCreateInfo);
   }
 
@@ -379,6 +586,33 @@ void VulkanDevice::createLogicalDevice() {
   // enable anisotropy
   deviceFeatures.samplerAnisotropy = VK_TRUE;
 
+  // Compressed textures, whichever family the device has. The streamer
+  // decodes the others on the CPU
+  VkPhysicalDeviceFeatures supportedFeatures;
+  vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+  deviceFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
+  deviceFeatures.textureCompressionETC2 =
+      supportedFeatures.textureCompressionETC2;
+  deviceFeatures.shaderSampledImageArrayDynamicIndexing = VK_TRUE;
+
+  // Latency is measured to the moment a frame is shown when the device can
+  // say so, else only to when the GPU finished it
+  presentWaitSupported = !headless && checkPresentWaitSupport(physicalDevice);
+  if (presentWaitSupported) {
+    deviceExtensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+    deviceExtensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+  }
+
+  // Its dependencies, create_renderpass2 and depth_stencil_resolve, are
+  // core in Vulkan 1.2
+  if (dynamicRendering && !checkDynamicRenderingSupport(physicalDevice)) {
+    std::cout << "Dynamic rendering is not supported, using render passes\n";
+    dynamicRendering = false;
+  }
+  if (dynamicRendering) {
+    deviceExtensions.push_back(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+  }
+
   VkDeviceCreateInfo createInfo{};
   createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
 
@@ -400,9 +634,18 @@ void VulkanDevice::createLogicalDevice() {
     createInfo.enabledLayerCount = 0;
   }
   // Query vk12 features
-  //VkPhysicalDeviceVulkan12Features vk12Features{};
-  //vk12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
-  //createInfo.pNext = &vk12Features;
+  VkPhysicalDeviceVulkan12Features vk12Features{};
+  vk12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+  vk12Features.timelineSemaphore = VK_TRUE;
+  // Texture table
+  vk12Features.descriptorBindingPartiallyBound = VK_TRUE;
+  vk12Features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+  vk12Features.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+
+  VkPhysicalDeviceSynchronization2FeaturesKHR sync2Features{};
+  sync2Features.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR;
+  sync2Features.synchronization2 = VK_TRUE;
 
   VkPhysicalDeviceExtendedDynamicState3FeaturesEXT extended_dynamic_state3_features{};
   extended_dynamic_state3_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_FEATURES_EXT;
@@ -416,19 +659,74 @@ void VulkanDevice::createLogicalDevice() {
   extended_dynamic_state3_features.extendedDynamicState3ColorWriteMask = true;
   //extended_dynamic_state3_features.extendedDynamicState3AlphaToOneEnable = true;
 
-  createInfo.pNext = &extended_dynamic_state3_features;
+  createInfo.pNext = &vk12Features;
+  vk12Features.pNext = &sync2Features;
+  sync2Features.pNext = &extended_dynamic_state3_features;
+
+  VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures{};
+  presentIdFeatures.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+  presentIdFeatures.presentId = VK_TRUE;
+
+  VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures{};
+  presentWaitFeatures.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+  presentWaitFeatures.presentWait = VK_TRUE;
+  presentIdFeatures.pNext = &presentWaitFeatures;
+
+  if (presentWaitSupported) {
+    extended_dynamic_state3_features.pNext = &presentIdFeatures;
+  }
+
+  VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures{};
+  dynamicRenderingFeatures.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+  dynamicRenderingFeatures.dynamicRendering = VK_TRUE;
+  if (dynamicRendering) {
+    dynamicRenderingFeatures.pNext = const_cast<void *>(createInfo.pNext);
+    createInfo.pNext = &dynamicRenderingFeatures;
+  }
 
   if (vkCreateDevice(physicalDevice, &createInfo, nullptr, &logicalDevice) !=
       VK_SUCCESS) {
     throw std::runtime_error("failed to create logical device!");
   }
 
+  // Resolve every device function once, calls then skip the loader
+  dispatch = loadDeviceDispatch(logicalDevice);
+  if (!dispatch.hasSynchronization2) {
+    throw std::runtime_error("failed to load vkQueueSubmit2KHR!");
+  }
+  if (!headless && !dispatch.hasSwapchain) {
+    throw std::runtime_error("failed to load VK_KHR_swapchain functions!");
+  }
+  bindDeviceDispatch(dispatch);
+  presentWaitSupported = presentWaitSupported && dispatch.hasPresentWait;
+  if (dynamicRendering && !dispatch.hasDynamicRendering) {
+    throw std::runtime_error("failed to load VK_KHR_dynamic_rendering "
+                             "functions!");
+  }
+  std::cout << "Render path: "
+            << (dynamicRendering ? "dynamic rendering" : "render pass")
+            << "\n";
+  std::cout << "Present wait: "
+            << (presentWaitSupported ? "supported" : "not supported") << "\n";
+
   vkGetDeviceQueue(logicalDevice, indices.graphicsFamily.value(), 0,
                    &graphicsQueue);
 
   // Now create the present queue
-  vkGetDeviceQueue(logicalDevice, indices.presentFamily.value(), 0,
-                   &presentQueue);
+  vkGetDeviceQueue(logicalDevice, presentFamily, 0, &presentQueue);
+
+  vkGetDeviceQueue(logicalDevice, transferFamily, transferQueueIndex,
+                   &transferQueue);
+
+  vkGetDeviceQueue(logicalDevice, computeFamily, computeQueueIndex,
+                   &computeQueue);
+
+  allocator = new VulkanAllocator(physicalDevice, logicalDevice);
+  pipelineCache = new VulkanPipelineCache(physicalDevice, logicalDevice,
+                                          PIPELINE_CACHE_PATH);
 }
 
 } // namespace VulkanStuff
\ No newline at end of file
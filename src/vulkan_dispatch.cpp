@@ -0,0 +1,83 @@
+#include <vulkan_dispatch.hpp>
+
+#include <stdexcept>
+#include <string>
+
+namespace VulkanStuff {
+
+namespace Dispatch {
+#define VULKAN_DISPATCH_DEFINE(name) PFN_##name name = nullptr;
+VULKAN_GLOBAL_FUNCTIONS(VULKAN_DISPATCH_DEFINE)
+VULKAN_INSTANCE_FUNCTIONS(VULKAN_DISPATCH_DEFINE)
+VULKAN_SURFACE_FUNCTIONS(VULKAN_DISPATCH_DEFINE)
+VULKAN_ALL_DEVICE_FUNCTIONS(VULKAN_DISPATCH_DEFINE)
+#undef VULKAN_DISPATCH_DEFINE
+} // namespace Dispatch
+
+void loadGlobalFunctions() {
+#define VULKAN_LOAD_GLOBAL(name)                                               \
+  Dispatch::name =                                                             \
+      reinterpret_cast<PFN_##name>(vkGetInstanceProcAddr(nullptr, #name));     \
+  if (Dispatch::name == nullptr) {                                             \
+    throw std::runtime_error("failed to load " #name "!");                     \
+  }
+  VULKAN_GLOBAL_FUNCTIONS(VULKAN_LOAD_GLOBAL)
+#undef VULKAN_LOAD_GLOBAL
+}
+
+void loadInstanceFunctions(VkInstance instance) {
+#define VULKAN_LOAD_INSTANCE(name)                                             \
+  Dispatch::name =                                                             \
+      reinterpret_cast<PFN_##name>(vkGetInstanceProcAddr(instance, #name));    \
+  if (Dispatch::name == nullptr) {                                             \
+    throw std::runtime_error("failed to load " #name "!");                     \
+  }
+  VULKAN_INSTANCE_FUNCTIONS(VULKAN_LOAD_INSTANCE)
+#undef VULKAN_LOAD_INSTANCE
+
+  // Null when the instance was created without VK_KHR_surface
+#define VULKAN_LOAD_OPTIONAL_INSTANCE(name)                                    \
+  Dispatch::name =                                                             \
+      reinterpret_cast<PFN_##name>(vkGetInstanceProcAddr(instance, #name));
+  VULKAN_SURFACE_FUNCTIONS(VULKAN_LOAD_OPTIONAL_INSTANCE)
+#undef VULKAN_LOAD_OPTIONAL_INSTANCE
+}
+
+VulkanDeviceDispatch loadDeviceDispatch(VkDevice device) {
+  VulkanDeviceDispatch dispatch{};
+
+#define VULKAN_LOAD_DEVICE(name)                                               \
+  dispatch.name = reinterpret_cast<PFN_##name>(                                \
+      Dispatch::vkGetDeviceProcAddr(device, #name));
+  VULKAN_ALL_DEVICE_FUNCTIONS(VULKAN_LOAD_DEVICE)
+#undef VULKAN_LOAD_DEVICE
+
+#define VULKAN_CHECK_REQUIRED(name)                                            \
+  if (dispatch.name == nullptr) {                                              \
+    throw std::runtime_error("failed to load " #name "!");                     \
+  }
+  VULKAN_DEVICE_FUNCTIONS(VULKAN_CHECK_REQUIRED)
+#undef VULKAN_CHECK_REQUIRED
+
+#define VULKAN_CHECK_LOADED(name) &&dispatch.name != nullptr
+  dispatch.hasSwapchain = true VULKAN_SWAPCHAIN_FUNCTIONS(VULKAN_CHECK_LOADED);
+  dispatch.hasSynchronization2 =
+      true VULKAN_SYNCHRONIZATION_2_FUNCTIONS(VULKAN_CHECK_LOADED);
+  dispatch.hasExtendedDynamicState3 =
+      true VULKAN_EXTENDED_DYNAMIC_STATE_3_FUNCTIONS(VULKAN_CHECK_LOADED);
+  dispatch.hasPresentWait =
+      true VULKAN_PRESENT_WAIT_FUNCTIONS(VULKAN_CHECK_LOADED);
+  dispatch.hasDynamicRendering =
+      true VULKAN_DYNAMIC_RENDERING_FUNCTIONS(VULKAN_CHECK_LOADED);
+#undef VULKAN_CHECK_LOADED
+
+  return dispatch;
+}
+
+void bindDeviceDispatch(const VulkanDeviceDispatch &dispatch) {
+#define VULKAN_BIND_DEVICE(name) Dispatch::name = dispatch.name;
+  VULKAN_ALL_DEVICE_FUNCTIONS(VULKAN_BIND_DEVICE)
+#undef VULKAN_BIND_DEVICE
+}
+
+} // namespace VulkanStuff
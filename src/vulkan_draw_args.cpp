@@ -0,0 +1,118 @@
+#include <vulkan_draw_args.hpp>
+
+namespace VulkanStuff {
+VulkanDrawArgs::VulkanDrawArgs(VkDevice inputDevice,
+                               VulkanAllocator *inputAllocator,
+                               uint32_t inputGraphicsFamily,
+                               uint32_t inputComputeFamily,
+                               VkPipelineCache inputPipelineCache)
+    : device{inputDevice}, allocator{inputAllocator},
+      graphicsFamily{inputGraphicsFamily}, computeFamily{inputComputeFamily},
+      pipelineCache{inputPipelineCache} {
+  VkDescriptorSetLayoutBinding argsBinding{};
+  argsBinding.binding = 0;
+  argsBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  argsBinding.descriptorCount = 1;
+  argsBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+  VkDescriptorSetLayoutCreateInfo layoutInfo{};
+  layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layoutInfo.bindingCount = 1;
+  layoutInfo.pBindings = &argsBinding;
+
+  if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr,
+                                  &descriptorSetLayout) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create draw args set layout!");
+  }
+
+  createPipeline();
+}
+
+VulkanDrawArgs::~VulkanDrawArgs() {
+  // The owner waits for the device to go idle first
+  destroyBuffer();
+  vkDestroyPipeline(device, pipeline, nullptr);
+  vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+  vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+}
+
+void VulkanDrawArgs::createPipeline() {
+  PROFILE_FUNCTION();
+  std::vector<char> shaderCode = Utils::readFile("shaders/draw_args.comp.spv");
+
+  VkShaderModuleCreateInfo moduleInfo{};
+  moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+  moduleInfo.codeSize = shaderCode.size();
+  moduleInfo.pCode = reinterpret_cast<const uint32_t *>(shaderCode.data());
+
+  VkShaderModule shaderModule;
+  if (vkCreateShaderModule(device, &moduleInfo, nullptr, &shaderModule) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create shader module!");
+  }
+
+  VkPushConstantRange pushConstantRange{};
+  pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  pushConstantRange.offset = 0;
+  pushConstantRange.size = sizeof(Utils::DrawArgsConstants);
+
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipelineLayoutInfo.setLayoutCount = 1;
+  pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+  pipelineLayoutInfo.pushConstantRangeCount = 1;
+  pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+  if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr,
+                             &pipelineLayout) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create draw args pipeline layout!");
+  }
+
+  VkComputePipelineCreateInfo pipelineInfo{};
+  pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+  pipelineInfo.stage.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  pipelineInfo.stage.module = shaderModule;
+  pipelineInfo.stage.pName = "main";
+  pipelineInfo.layout = pipelineLayout;
+
+  VkResult result = vkCreateComputePipelines(device, pipelineCache, 1,
+                                             &pipelineInfo, nullptr, &pipeline);
+  vkDestroyShaderModule(device, shaderModule, nullptr);
+  if (result != VK_SUCCESS) {
+    throw std::runtime_error("failed to create draw args pipeline!");
+  }
+}
+
+void VulkanDrawArgs::createBuffer(uint32_t drawCount, uint32_t regionCount) {
+  drawsPerRegion = drawCount;
+  // Written on the compute queue, read as draw parameters on the graphics
+  // queue
+  bufferMemory = allocator->createBuffer(
+      sizeof(VkDrawIndexedIndirectCommand) * drawsPerRegion * regionCount,
+      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer,
+      {graphicsFamily, computeFamily});
+}
+
+void VulkanDrawArgs::destroyBuffer() {
+  if (buffer != VK_NULL_HANDLE) {
+    allocator->destroyBuffer(buffer, bufferMemory);
+  }
+}
+
+void VulkanDrawArgs::record(VkCommandBuffer commandBuffer,
+                            VkDescriptorSet descriptorSet, uint32_t frameIndex,
+                            uint32_t drawCount) {
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                          pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+
+  Utils::DrawArgsConstants constants{firstDraw(frameIndex), drawCount};
+  vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT,
+                     0, sizeof(constants), &constants);
+  vkCmdDispatch(commandBuffer,
+                (drawCount + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+}
+} // namespace VulkanStuff
@@ -6,54 +6,40 @@ namespace VulkanStuff {
 VulkanImage::VulkanImage(VkPhysicalDevice inputPhysicalDevice,
 
                          VkDevice inputDevice, VkQueue inputGraphicsQueue,
-                         VkCommandPool inputCommandPool, VkExtent2D inputExtent, VkFormat inputFormat)
+                         VulkanAllocator *inputAllocator,
+                         VulkanUploader *inputUploader, VkExtent2D inputExtent,
+                         VkFormat inputFormat,
+                         VkSampleCountFlagBits inputMsaaSamples)
     : device{inputDevice}, physicalDevice{inputPhysicalDevice},
-      graphicsQueue{inputGraphicsQueue}, commandPool{inputCommandPool},
-      swapChainExtent{inputExtent} {
+      graphicsQueue{inputGraphicsQueue}, allocator{inputAllocator},
+      uploader{inputUploader},
+      swapChainExtent{inputExtent}, msaaSamples{inputMsaaSamples} {
 
   swapchainFormat = inputFormat;
 
-  createTextureImage("textures/texture.jpg", textureImage, textureImageMemory,
-                     false);
-  textureImageView = Utils::createImageView(
-      device, textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT);
-
-  createTextureImage("textures/amdtexture.jpg", second_textureImage,
-                     second_textureImageMemory, false);
-
-  second_textureImageView = Utils::createImageView(device, second_textureImage,
-                                                   VK_FORMAT_R8G8B8A8_SRGB,
-                                                   VK_IMAGE_ASPECT_COLOR_BIT);
-
+  // Textures come from VulkanTextureStreamer, only the sampler lives here
   createTextureSampler();
   createDepthResources();
   createColorResources();
 }
 
 VulkanImage::~VulkanImage() {
-  vkDestroyImage(device, textureImage, nullptr);
-  vkFreeMemory(device, textureImageMemory, nullptr);
-  vkDestroyImageView(device, textureImageView, nullptr);
-
-  vkDestroyImage(device, second_textureImage, nullptr);
-  vkFreeMemory(device, second_textureImageMemory, nullptr);
-  vkDestroyImageView(device, second_textureImageView, nullptr);
-
-  vkDestroyImage(device, depthImage, nullptr);
-  vkFreeMemory(device, depthImageMemory, nullptr);
+  allocator->destroyImage(depthImage, depthImageMemory);
   vkDestroyImageView(device, depthImageView, nullptr);
 
   vkDestroyImageView(device, colorImageView, nullptr);
-  vkDestroyImage(device, colorImage, nullptr);
-  vkFreeMemory(device, colorImageMemory, nullptr);
+  allocator->destroyImage(colorImage, colorImageMemory);
 
   vkDestroySampler(device, textureSampler, nullptr);
 }
 
-void VulkanImage::createImage(uint32_t width, uint32_t height, VkFormat format,
+void VulkanImage::createImage(uint32_t width, uint32_t height,
+                              uint32_t mipLevels, VkFormat format,
                               VkImageTiling tiling, VkImageUsageFlags usage,
                               VkMemoryPropertyFlags properties, VkImage &image,
-                              VkDeviceMemory &imageMemory, bool isExplicit, VkSampleCountFlagBits numSamples) {
+                              VulkanAllocation &imageMemory, bool isExplicit,
+                              VkSampleCountFlagBits numSamples,
+                              bool dedicated) {
   // Now create the VKImage
   VkImageCreateInfo imageInfo{};
   imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -62,7 +48,7 @@ void VulkanImage::createImage(uint32_t width, uint32_t height, VkFormat format,
   imageInfo.extent.width = static_cast<uint32_t>(width);
   imageInfo.extent.height = static_cast<uint32_t>(height);
   imageInfo.extent.depth = 1;
-  imageInfo.mipLevels = 1;
+  imageInfo.mipLevels = mipLevels;
   imageInfo.arrayLayers = 1;
 
   imageInfo.format = format;
@@ -85,40 +71,21 @@ void VulkanImage::createImage(uint32_t width, uint32_t height, VkFormat format,
   // imageInfo.pNext = &formatList;
 
   // Enabling this will disable implicit gmsharing for this image
+  VkExternalMemoryImageCreateInfo memCreate{};
   if (isExplicit) {
-    VkExternalMemoryImageCreateInfo memCreate{};
     memCreate.sType = VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_IMAGE_CREATE_INFO;
     memCreate.handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD_BIT;
     imageInfo.pNext = &memCreate;
   }
 
-  if (vkCreateImage(device, &imageInfo, nullptr, &image) != VK_SUCCESS) {
-    throw std::runtime_error("failed to create image!");
-  }
-  VkMemoryRequirements memRequirements;
-  vkGetImageMemoryRequirements(device, image, &memRequirements);
-
-  VkMemoryAllocateInfo allocInfo{};
-  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  allocInfo.allocationSize = memRequirements.size;
-  allocInfo.memoryTypeIndex = Utils::findMemoryType(
-      physicalDevice, memRequirements.memoryTypeBits, properties);
-
-  if (vkAllocateMemory(device, &allocInfo, nullptr, &imageMemory) !=
-      VK_SUCCESS) {
-    throw std::runtime_error("failed to allocate image memory!");
-  }
-
-  vkBindImageMemory(device, image, imageMemory, 0);
+  imageMemory = allocator->createImage(imageInfo, properties, image,
+                                       dedicated || isExplicit);
 }
 
 void VulkanImage::transitionImageLayout(VkImage image, VkFormat format,
+                                        uint32_t mipLevels,
                                         VkImageLayout oldLayout,
                                         VkImageLayout newLayout) {
-
-  VkCommandBuffer commandBuffer =
-      Utils::beginSingleTimeCommands(device, commandPool);
-
   VkImageMemoryBarrier barrier{};
   barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
   barrier.oldLayout = oldLayout;
@@ -132,7 +99,7 @@ void VulkanImage::transitionImageLayout(VkImage image, VkFormat format,
   barrier.image = image;
   barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
   barrier.subresourceRange.baseMipLevel = 0;
-  barrier.subresourceRange.levelCount = 1;
+  barrier.subresourceRange.levelCount = mipLevels;
   barrier.subresourceRange.baseArrayLayer = 0;
   barrier.subresourceRange.layerCount = 1;
 
@@ -173,7 +140,8 @@ void VulkanImage::transitionImageLayout(VkImage image, VkFormat format,
     barrier.srcAccessMask = 0;
     barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
 
-    sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    // Frames still in flight may be sampling it, wait for their shaders
+    sourceStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
     destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
 
   } else if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED &&
@@ -190,88 +158,126 @@ void VulkanImage::transitionImageLayout(VkImage image, VkFormat format,
     throw std::invalid_argument("unsupported layout transition!");
   }
 
-  vkCmdPipelineBarrier(commandBuffer, sourceStage, destinationStage, 0, 0,
-                       nullptr, 0, nullptr, 1, &barrier);
-  Utils::endSingleTimeCommands(device, commandPool, commandBuffer,
-                               graphicsQueue);
+  uploader->record([&](VkCommandBuffer commandBuffer) {
+    vkCmdPipelineBarrier(commandBuffer, sourceStage, destinationStage, 0, 0,
+                         nullptr, 0, nullptr, 1, &barrier);
+  });
 }
 
-void VulkanImage::copyBufferToImage(VkBuffer buffer, VkImage image,
-                                    uint32_t width, uint32_t height) {
-  VkCommandBuffer commandBuffer =
-      Utils::beginSingleTimeCommands(device, commandPool);
+bool VulkanImage::supportsSampling(VkFormat format) {
+  VkFormatProperties formatProperties;
+  vkGetPhysicalDeviceFormatProperties(physicalDevice, format,
+                                      &formatProperties);
 
-  VkBufferImageCopy region{};
-  region.bufferOffset = 0;
-  region.bufferRowLength = 0;
-  region.bufferImageHeight = 0;
-
-  region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-  region.imageSubresource.mipLevel = 0;
-  region.imageSubresource.baseArrayLayer = 0;
-  region.imageSubresource.layerCount = 1;
-
-  region.imageOffset = {0, 0, 0};
-  region.imageExtent = {width, height, 1};
+  VkFormatFeatureFlags required =
+      VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT |
+      VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+  return (formatProperties.optimalTilingFeatures & required) == required;
+}
 
-  vkCmdCopyBufferToImage(commandBuffer, buffer, image,
-                         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+bool VulkanImage::supportsLinearBlit(VkFormat format) {
+  VkFormatProperties formatProperties;
+  vkGetPhysicalDeviceFormatProperties(physicalDevice, format,
+                                      &formatProperties);
 
-  Utils::endSingleTimeCommands(device, commandPool, commandBuffer,
-                               graphicsQueue);
+  VkFormatFeatureFlags required =
+      VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT |
+      VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT;
+  return (formatProperties.optimalTilingFeatures & required) == required;
 }
 
-void VulkanImage::createTextureImage(const char *texPath, VkImage &image,
-                                     VkDeviceMemory &imageMemory,
-                                     bool isExplicit) {
-  int texWidth, texHeight, texChannels;
-  stbi_uc *pixels =
-      stbi_load(texPath, &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-  VkDeviceSize imageSize = texWidth * texHeight * 4;
-
-  if (!pixels) {
-    throw std::runtime_error("failed to load texture image!");
+void VulkanImage::generateMipmaps(VkImage image, uint32_t width,
+                                  uint32_t height, uint32_t mipLevels) {
+  if (mipLevels <= 1) {
+    return;
   }
 
-  VkBuffer stagingBuffer;
-  VkDeviceMemory stagingBufferMemory;
-
-  Utils::createBuffer(physicalDevice, device, imageSize,
-                      VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                      stagingBuffer, stagingBufferMemory);
-
-  void *data;
-  vkMapMemory(device, stagingBufferMemory, 0, imageSize, 0, &data);
-  memcpy(data, pixels, static_cast<size_t>(imageSize));
-  vkUnmapMemory(device, stagingBufferMemory);
-
-  stbi_image_free(pixels);
-
-  // createImage(
-  //     texWidth, texHeight, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL,
-  //     VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-  //     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, textureImage, textureImageMemory);
-
-  createImage(texWidth, texHeight, VK_FORMAT_A8B8G8R8_UNORM_PACK32,
-              VK_IMAGE_TILING_OPTIMAL,
-              VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-              VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, imageMemory, false, VK_SAMPLE_COUNT_1_BIT);
-
-  transitionImageLayout(image, VK_FORMAT_R8G8B8A8_SRGB,
-                        VK_IMAGE_LAYOUT_UNDEFINED,
-                        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-
-  copyBufferToImage(stagingBuffer, image, static_cast<uint32_t>(texWidth),
-                    static_cast<uint32_t>(texHeight));
-
-  transitionImageLayout(image, VK_FORMAT_R8G8B8A8_SRGB,
-                        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+  uploader->record([&](VkCommandBuffer commandBuffer) {
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+
+    // Level 0 is only read from, everything below it is overwritten
+    VkImageMemoryBarrier startBarriers[2] = {barrier, barrier};
+    startBarriers[0].subresourceRange.baseMipLevel = 0;
+    startBarriers[0].subresourceRange.levelCount = 1;
+    startBarriers[0].oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    startBarriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    startBarriers[0].srcAccessMask = 0;
+    startBarriers[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    startBarriers[1].subresourceRange.baseMipLevel = 1;
+    startBarriers[1].subresourceRange.levelCount = mipLevels - 1;
+    startBarriers[1].oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    startBarriers[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    startBarriers[1].srcAccessMask = 0;
+    startBarriers[1].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
+                         nullptr, 2, startBarriers);
+
+    barrier.subresourceRange.levelCount = 1;
+    int32_t mipWidth = static_cast<int32_t>(width);
+    int32_t mipHeight = static_cast<int32_t>(height);
+    for (uint32_t level = 1; level < mipLevels; level++) {
+      int32_t nextWidth = mipWidth > 1 ? mipWidth / 2 : 1;
+      int32_t nextHeight = mipHeight > 1 ? mipHeight / 2 : 1;
+
+      VkImageBlit blit{};
+      blit.srcOffsets[0] = {0, 0, 0};
+      blit.srcOffsets[1] = {mipWidth, mipHeight, 1};
+      blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+      blit.srcSubresource.mipLevel = level - 1;
+      blit.srcSubresource.baseArrayLayer = 0;
+      blit.srcSubresource.layerCount = 1;
+      blit.dstOffsets[0] = {0, 0, 0};
+      blit.dstOffsets[1] = {nextWidth, nextHeight, 1};
+      blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+      blit.dstSubresource.mipLevel = level;
+      blit.dstSubresource.baseArrayLayer = 0;
+      blit.dstSubresource.layerCount = 1;
+      vkCmdBlitImage(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                     image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit,
+                     VK_FILTER_LINEAR);
+
+      // The level just written is the source of the next blit
+      if (level + 1 < mipLevels) {
+        barrier.subresourceRange.baseMipLevel = level;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
+                             nullptr, 1, &barrier);
+      }
+
+      mipWidth = nextWidth;
+      mipHeight = nextHeight;
+    }
 
-  vkDestroyBuffer(device, stagingBuffer, nullptr);
-  vkFreeMemory(device, stagingBufferMemory, nullptr);
+    // Every level but the last one was a blit source
+    VkImageMemoryBarrier endBarriers[2] = {barrier, barrier};
+    endBarriers[0].subresourceRange.baseMipLevel = 0;
+    endBarriers[0].subresourceRange.levelCount = mipLevels - 1;
+    endBarriers[0].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    endBarriers[0].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    endBarriers[0].srcAccessMask = 0;
+    endBarriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    endBarriers[1].subresourceRange.baseMipLevel = mipLevels - 1;
+    endBarriers[1].subresourceRange.levelCount = 1;
+    endBarriers[1].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    endBarriers[1].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    endBarriers[1].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    endBarriers[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr,
+                         0, nullptr, 2, endBarriers);
+  });
 }
 
 void VulkanImage::createTextureSampler() {
@@ -304,7 +310,8 @@ void VulkanImage::createTextureSampler() {
   samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
   samplerInfo.mipLodBias = 0.0f;
   samplerInfo.minLod = 0.0f;
-  samplerInfo.maxLod = 0.0f;
+  // Each view decides how many levels there are
+  samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
 
   if (vkCreateSampler(device, &samplerInfo, nullptr, &textureSampler) !=
       VK_SUCCESS) {
@@ -313,21 +320,18 @@ void VulkanImage::createTextureSampler() {
 }
 
 void VulkanImage::createDepthResources() {
-  VkFormat depthFormat = Utils::findSupportedFormat(
-      physicalDevice,
-      {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT,
-       VK_FORMAT_D24_UNORM_S8_UINT},
-      VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
+  depthFormat = Utils::findDepthFormat(physicalDevice);
 
   createImage(
-      swapChainExtent.width, swapChainExtent.height, depthFormat,
+      swapChainExtent.width, swapChainExtent.height, 1, depthFormat,
       VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
-      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, depthImage, depthImageMemory, false, msaaSamples);
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, depthImage, depthImageMemory, false,
+      msaaSamples, true);
 
   depthImageView = Utils::createImageView(device, depthImage, depthFormat,
                                           VK_IMAGE_ASPECT_DEPTH_BIT);
 
-  transitionImageLayout(depthImage, depthFormat, VK_IMAGE_LAYOUT_UNDEFINED,
+  transitionImageLayout(depthImage, depthFormat, 1, VK_IMAGE_LAYOUT_UNDEFINED,
                         VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
 }
 
@@ -335,10 +339,11 @@ void VulkanImage::createColorResources() {
     VkFormat colorFormat = swapchainFormat;
 
     
-    createImage(swapChainExtent.width, swapChainExtent.height, colorFormat,
+    createImage(swapChainExtent.width, swapChainExtent.height, 1, colorFormat,
         VK_IMAGE_TILING_OPTIMAL,
         VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
-        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, colorImage, colorImageMemory, false, msaaSamples); 
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, colorImage, colorImageMemory, false,
+        msaaSamples, true);
     
     colorImageView = Utils::createImageView(device, colorImage,     colorFormat,     VK_IMAGE_ASPECT_COLOR_BIT);
 }
@@ -1,21 +1,35 @@
 
 #include <vulkan_pipeline.hpp>
+
+#include <chrono>
+
 namespace VulkanStuff {
 VulkanPipeline::VulkanPipeline(
     VkPhysicalDevice inputPhysicalDevice, VkDevice inputDevice,
     VkSurfaceKHR inputSurface, VkQueue inputGraphicsQueue,
-    VkExtent2D inputSwapChainExtent, VkFormat inputSwapChainImageFormat,
-    std::vector<VkImageView> inputSwapChainImageViews)
+    VkSampleCountFlagBits inputMsaaSamples, bool inputDynamicRendering,
+    VkExtent2D inputSwapChainExtent,
+    VkFormat inputSwapChainImageFormat,
+    std::vector<VkImageView> inputSwapChainImageViews,
+    VkImageLayout inputFinalLayout,
+    VkDescriptorSetLayout inputTextureSetLayout,
+    VkPipelineCache inputPipelineCache)
     : physicalDevice{inputPhysicalDevice}, device{inputDevice},
       surface{inputSurface}, graphicsQueue{inputGraphicsQueue},
+      msaaSamples{inputMsaaSamples}, dynamicRendering{inputDynamicRendering},
       swapChainExtent{inputSwapChainExtent},
       swapChainImageFormat{inputSwapChainImageFormat},
-      swapChainImageViews{inputSwapChainImageViews} {
+      swapChainImageViews{inputSwapChainImageViews},
+      finalLayout{inputFinalLayout},
+      textureSetLayout{inputTextureSetLayout},
+      pipelineCache{inputPipelineCache} {
 
   // Ive seperate renderpass into its own obj, hopefully for easier future
   // extensibility
-  vulkanRenderPass =
-      new VulkanRenderPass(physicalDevice, device, swapChainImageFormat);
+  if (!dynamicRendering) {
+    vulkanRenderPass = new VulkanRenderPass(
+        physicalDevice, device, msaaSamples, swapChainImageFormat, finalLayout);
+  }
 
   createDescriptorSetLayout();
 
@@ -49,22 +63,15 @@ VulkanPipeline::createShaderModule(const std::vector<char> &code) {
 void VulkanPipeline::createDescriptorSetLayout() {
   VkDescriptorSetLayoutBinding uboLayoutBinding{};
   uboLayoutBinding.binding = 0;
-  uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+  // Dynamic so every draw can point at its own slice of the uniform ring
+  uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
   uboLayoutBinding.descriptorCount = 1;
   uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
   uboLayoutBinding.pImmutableSamplers = nullptr; // Optional
 
-  // Sampler
-  VkDescriptorSetLayoutBinding samplerLayoutBinding{};
-  samplerLayoutBinding.binding = 1;
-  samplerLayoutBinding.descriptorCount = 1;
-  samplerLayoutBinding.descriptorType =
-      VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-  samplerLayoutBinding.pImmutableSamplers = nullptr;
-  samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-
-  std::vector<VkDescriptorSetLayoutBinding> bindings = {uboLayoutBinding,
-                                                        samplerLayoutBinding};
+  // Textures are in the texture table's own set, a dynamic uniform buffer
+  // can't share an update after bind layout
+  std::vector<VkDescriptorSetLayoutBinding> bindings = {uboLayoutBinding};
 
   VkDescriptorSetLayoutCreateInfo layoutInfo{};
   layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
@@ -78,6 +85,7 @@ void VulkanPipeline::createDescriptorSetLayout() {
 }
 
 void VulkanPipeline::createGraphicsPipeline() {
+  PROFILE_FUNCTION();
   std::string vertShaderPath = "shaders/simple_shader.vert.spv";
   std::string fragShaderPath = "shaders/simple_shader.frag.spv";
   auto vertShaderCode = Utils::readFile(vertShaderPath);
@@ -139,25 +147,15 @@ void VulkanPipeline::createGraphicsPipeline() {
   inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
   inputAssembly.primitiveRestartEnable = VK_FALSE;
 
-  // Viewport
-  VkViewport viewport{};
-  viewport.x = 0.0f;
-  viewport.y = 0.0f;
-  viewport.width = (float)swapChainExtent.width;
-  viewport.height = (float)swapChainExtent.height;
-  viewport.minDepth = 0.0f;
-  viewport.maxDepth = 1.0f;
-
-  VkRect2D scissor{};
-  scissor.offset = {0, 0};
-  scissor.extent = swapChainExtent;
-
+  // Viewport and scissor are dynamic, see
+  // VulkanRenderer::setViewportAndScissor. The pipeline doesn't depend on the
+  // swapchain size and survives resizes
   VkPipelineViewportStateCreateInfo viewportState{};
   viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
   viewportState.viewportCount = 1;
-  viewportState.pViewports = &viewport;
+  viewportState.pViewports = nullptr;
   viewportState.scissorCount = 1;
-  viewportState.pScissors = &scissor;
+  viewportState.pScissors = nullptr;
 
   // Rasterizer, turns vertices into fragments to be colored in
 
@@ -186,7 +184,7 @@ void VulkanPipeline::createGraphicsPipeline() {
   multisampling.sType =
       VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
   multisampling.sampleShadingEnable = VK_FALSE;
-  multisampling.rasterizationSamples = VK_SAMPLE_COUNT_8_BIT;
+  multisampling.rasterizationSamples = msaaSamples;
   multisampling.minSampleShading = 1.0f;          // Optional
   multisampling.pSampleMask = nullptr;            // Optional
   multisampling.alphaToCoverageEnable = VK_FALSE; // Optional
@@ -235,7 +233,9 @@ void VulkanPipeline::createGraphicsPipeline() {
 
   VkPipelineDynamicStateCreateInfo dynamic_state_info{};
   dynamic_state_info.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-  const VkDynamicState dynamicStates[] = {VK_DYNAMIC_STATE_RASTERIZATION_SAMPLES_EXT };
+  const VkDynamicState dynamicStates[] = {
+      VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR,
+      VK_DYNAMIC_STATE_RASTERIZATION_SAMPLES_EXT};
   dynamic_state_info.dynamicStateCount = static_cast<uint32_t>(std::size(dynamicStates));
   dynamic_state_info.pDynamicStates = dynamicStates;
 
@@ -244,12 +244,18 @@ void VulkanPipeline::createGraphicsPipeline() {
   pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 
   // Descriptor set layouts
-  pipelineLayoutInfo.setLayoutCount = 1;                 // Optional
-  pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout; // Optional
-
-  // Push constants
-  pipelineLayoutInfo.pushConstantRangeCount = 0;    // Optional
-  pipelineLayoutInfo.pPushConstantRanges = nullptr; // Optional
+  VkDescriptorSetLayout setLayouts[] = {descriptorSetLayout, textureSetLayout};
+  pipelineLayoutInfo.setLayoutCount =
+      static_cast<uint32_t>(std::size(setLayouts));
+  pipelineLayoutInfo.pSetLayouts = setLayouts;
+
+  // Push constants, the draw's texture index
+  VkPushConstantRange pushConstantRange{};
+  pushConstantRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+  pushConstantRange.offset = 0;
+  pushConstantRange.size = sizeof(Utils::DrawPushConstants);
+  pipelineLayoutInfo.pushConstantRangeCount = 1;
+  pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
 
   if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr,
                              &pipelineLayout) != VK_SUCCESS) {
@@ -292,16 +298,36 @@ void VulkanPipeline::createGraphicsPipeline() {
 
   pipelineInfo.layout = pipelineLayout;
 
-  pipelineInfo.renderPass = vulkanRenderPass->renderPass;
+  // Without a render pass the formats are all the pipeline needs to know,
+  // any attachments of these formats can be rendered to
+  VkPipelineRenderingCreateInfoKHR renderingInfo{};
+  renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+  renderingInfo.colorAttachmentCount = 1;
+  renderingInfo.pColorAttachmentFormats = &swapChainImageFormat;
+  renderingInfo.depthAttachmentFormat = Utils::findDepthFormat(physicalDevice);
+  if (dynamicRendering) {
+    pipelineInfo.pNext = &renderingInfo;
+    pipelineInfo.renderPass = VK_NULL_HANDLE;
+  } else {
+    pipelineInfo.renderPass = vulkanRenderPass->renderPass;
+  }
   pipelineInfo.subpass = 0;
 
   pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; // Optional
   pipelineInfo.basePipelineIndex = -1;              // Optional
 
-  if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo,
+  // With a warm cache the driver skips compiling the shaders
+  auto createStart = std::chrono::steady_clock::now();
+  if (vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineInfo,
                                 nullptr, &graphicsPipeline) != VK_SUCCESS) {
     throw std::runtime_error("failed to create graphics pipeline!");
   }
+  lastCreateMs = std::chrono::duration<double, std::milli>(
+                     std::chrono::steady_clock::now() - createStart)
+                     .count();
+  if (startupCreateMs < 0) {
+    startupCreateMs = lastCreateMs;
+  }
 
   // Cleanup===========
   vkDestroyShaderModule(device, fragShaderModule, nullptr);
@@ -0,0 +1,126 @@
+#include <vulkan_pipeline_cache.hpp>
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace VulkanStuff {
+
+// VkPipelineCacheHeaderVersionOne, written by the driver in front of the
+// blob: header size, header version, vendor ID, device ID and the UUID
+static constexpr size_t PIPELINE_CACHE_HEADER_SIZE = 16 + VK_UUID_SIZE;
+
+static uint32_t readUint32(const std::vector<char> &blob, size_t offset) {
+  uint32_t value;
+  memcpy(&value, blob.data() + offset, sizeof(value));
+  return value;
+}
+
+VulkanPipelineCache::VulkanPipelineCache(VkPhysicalDevice inputPhysicalDevice,
+                                         VkDevice inputDevice,
+                                         std::string inputFilePath)
+    : physicalDevice{inputPhysicalDevice}, device{inputDevice},
+      filePath{inputFilePath} {
+  PROFILE_FUNCTION();
+  // A missing file is the normal first run, not an error
+  std::vector<char> blob;
+  std::ifstream file(filePath, std::ios::ate | std::ios::binary);
+  if (file.is_open()) {
+    blob.resize(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(blob.data(), blob.size());
+  }
+
+  VkPipelineCacheCreateInfo cacheInfo{};
+  cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+  if (isCompatible(blob)) {
+    cacheInfo.initialDataSize = blob.size();
+    cacheInfo.pInitialData = blob.data();
+  } else if (!blob.empty()) {
+    std::cout << "Pipeline cache " << filePath
+              << " is from another device or driver, starting empty\n";
+  }
+
+  VkResult result = vkCreatePipelineCache(device, &cacheInfo, nullptr, &cache);
+  if (result != VK_SUCCESS && cacheInfo.initialDataSize > 0) {
+    // Drivers may still reject a blob that passed the header check
+    cacheInfo.initialDataSize = 0;
+    cacheInfo.pInitialData = nullptr;
+    result = vkCreatePipelineCache(device, &cacheInfo, nullptr, &cache);
+  }
+  if (result != VK_SUCCESS) {
+    throw std::runtime_error("failed to create pipeline cache!");
+  }
+
+  loadedBytes = cacheInfo.initialDataSize;
+  loadedFromDisk = loadedBytes > 0;
+  std::cout << "Pipeline cache: "
+            << (loadedFromDisk ? "warm, " + std::to_string(loadedBytes) +
+                                     " bytes from " + filePath
+                               : std::string("cold"))
+            << "\n";
+}
+
+VulkanPipelineCache::~VulkanPipelineCache() {
+  save();
+  vkDestroyPipelineCache(device, cache, nullptr);
+}
+
+bool VulkanPipelineCache::isCompatible(const std::vector<char> &blob) {
+  if (blob.size() < PIPELINE_CACHE_HEADER_SIZE) {
+    return false;
+  }
+
+  VkPhysicalDeviceProperties deviceProperties;
+  vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+
+  uint32_t headerSize = readUint32(blob, 0);
+  uint32_t headerVersion = readUint32(blob, 4);
+  uint32_t vendorID = readUint32(blob, 8);
+  uint32_t deviceID = readUint32(blob, 12);
+  return headerSize >= PIPELINE_CACHE_HEADER_SIZE &&
+         headerSize <= blob.size() &&
+         headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+         vendorID == deviceProperties.vendorID &&
+         deviceID == deviceProperties.deviceID &&
+         memcmp(blob.data() + 16, deviceProperties.pipelineCacheUUID,
+                VK_UUID_SIZE) == 0;
+}
+
+bool VulkanPipelineCache::save() {
+  PROFILE_FUNCTION();
+  size_t size = 0;
+  if (vkGetPipelineCacheData(device, cache, &size, nullptr) != VK_SUCCESS) {
+    return false;
+  }
+  std::vector<char> blob(size);
+  // VK_INCOMPLETE would mean a truncated blob, don't write that
+  if (vkGetPipelineCacheData(device, cache, &size, blob.data()) !=
+      VK_SUCCESS) {
+    return false;
+  }
+  blob.resize(size);
+
+  // A crash halfway through leaves the temporary file behind, never a
+  // truncated cache
+  std::string tempPath = filePath + ".tmp";
+  {
+    std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+    if (!file.is_open() ||
+        !file.write(blob.data(), static_cast<std::streamsize>(blob.size()))) {
+      std::cout << "Failed to write pipeline cache " << tempPath << "\n";
+      return false;
+    }
+  }
+
+  std::error_code error;
+  std::filesystem::rename(tempPath, filePath, error);
+  if (error) {
+    std::cout << "Failed to replace pipeline cache " << filePath << ", "
+              << error.message() << "\n";
+    std::filesystem::remove(tempPath, error);
+    return false;
+  }
+  return true;
+}
+} // namespace VulkanStuff
@@ -0,0 +1,185 @@
+#include <vulkan_profiler.hpp>
+
+#include <cstring>
+#include <iomanip>
+
+namespace VulkanStuff {
+VulkanProfiler::VulkanProfiler(VkPhysicalDevice inputPhysicalDevice,
+                               VkDevice inputDevice, VkSurfaceKHR inputSurface,
+                               float inputTimestampPeriod, uint32_t slotCount)
+    : physicalDevice{inputPhysicalDevice}, device{inputDevice},
+      surface{inputSurface}, timestampPeriod{inputTimestampPeriod} {
+  Utils::QueueFamilyIndices indices =
+      Utils::findQueueFamilies(physicalDevice, surface);
+
+  uint32_t queueFamilyCount = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount,
+                                           nullptr);
+  std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+  vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount,
+                                           queueFamilies.data());
+
+  uint32_t validBits =
+      queueFamilies[indices.graphicsFamily.value()].timestampValidBits;
+
+  supported = timestampPeriod > 0 && validBits > 0;
+  if (!supported) {
+    std::cout << "GPU timestamps not supported on the graphics queue\n";
+    return;
+  }
+  timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+  frames.resize(slotCount);
+  for (FrameQueries &frame : frames) {
+    VkQueryPoolCreateInfo queryPoolCreateInfo{};
+    queryPoolCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolCreateInfo.pNext = nullptr;
+    queryPoolCreateInfo.flags = 0;
+    queryPoolCreateInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    queryPoolCreateInfo.queryCount = 2 * MAX_SCOPES;
+    queryPoolCreateInfo.pipelineStatistics = 0;
+
+    if (vkCreateQueryPool(device, &queryPoolCreateInfo, nullptr,
+                          &frame.queryPool) != VK_SUCCESS) {
+      throw std::runtime_error("failed to create vkCreateQueryPool!");
+    }
+    frame.scopes.reserve(MAX_SCOPES);
+  }
+
+  queryResults.resize(2 * MAX_SCOPES);
+  lastResults.reserve(MAX_SCOPES);
+  scopeStack.reserve(MAX_SCOPES);
+}
+
+VulkanProfiler::~VulkanProfiler() {
+  for (FrameQueries &frame : frames) {
+    vkDestroyQueryPool(device, frame.queryPool, nullptr);
+  }
+}
+
+void VulkanProfiler::beginFrame(VkCommandBuffer commandBuffer, uint32_t slot) {
+  if (!supported) {
+    return;
+  }
+  currentSlot = slot;
+  scopeStack.clear();
+
+  collectResults(slot);
+
+  FrameQueries &frame = frames[slot];
+  frame.scopes.clear();
+  frame.frameNumber = frameNumber++;
+  vkCmdResetQueryPool(commandBuffer, frame.queryPool, 0, 2 * MAX_SCOPES);
+}
+
+void VulkanProfiler::endFrame() {
+  if (!scopeStack.empty()) {
+    std::cout << "GPU profiler: " << scopeStack.size()
+              << " scopes still open at end of frame\n";
+    scopeStack.clear();
+  }
+}
+
+void VulkanProfiler::beginScope(VkCommandBuffer commandBuffer,
+                                const char *name) {
+  if (!supported) {
+    return;
+  }
+
+  FrameQueries &frame = frames[currentSlot];
+  // Out of queries, drop the scope but keep the stack balanced
+  if (frame.scopes.size() >= MAX_SCOPES) {
+    scopeStack.push_back(UINT32_MAX);
+    return;
+  }
+
+  uint32_t scopeIndex = static_cast<uint32_t>(frame.scopes.size());
+  frame.scopes.push_back(
+      {name, static_cast<uint32_t>(scopeStack.size())});
+  scopeStack.push_back(scopeIndex);
+
+  vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                      frame.queryPool, scopeIndex * 2);
+}
+
+void VulkanProfiler::endScope(VkCommandBuffer commandBuffer) {
+  if (!supported || scopeStack.empty()) {
+    return;
+  }
+
+  uint32_t scopeIndex = scopeStack.back();
+  scopeStack.pop_back();
+  if (scopeIndex == UINT32_MAX) {
+    return;
+  }
+
+  vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                      frames[currentSlot].queryPool, scopeIndex * 2 + 1);
+}
+
+void VulkanProfiler::resetSlots() {
+  for (FrameQueries &frame : frames) {
+    frame.scopes.clear();
+  }
+  scopeStack.clear();
+  lastResults.clear();
+  lastResultsValid = false;
+}
+
+void VulkanProfiler::collectResults(uint32_t slot) {
+  FrameQueries &frame = frames[slot];
+  if (frame.scopes.empty()) {
+    return;
+  }
+
+  uint32_t queryCount = static_cast<uint32_t>(frame.scopes.size()) * 2;
+  const auto flags =
+      VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT;
+
+  // VK_NOT_READY is fine here, availability is checked per query
+  vkGetQueryPoolResults(device, frame.queryPool, 0, queryCount,
+                        queryCount * sizeof(Utils::Query), queryResults.data(),
+                        sizeof(Utils::Query), flags);
+
+  lastResults.clear();
+  for (size_t i = 0; i < frame.scopes.size(); i++) {
+    const Utils::Query &begin = queryResults[i * 2];
+    const Utils::Query &end = queryResults[i * 2 + 1];
+    if (begin.availability == 0 || end.availability == 0) {
+      continue;
+    }
+    uint64_t ticks = (end.value - begin.value) & timestampMask;
+    lastResults.push_back({frame.scopes[i].name, frame.scopes[i].depth,
+                           ticks * timestampPeriod / 1000000.0});
+  }
+  lastResultsFrame = frame.frameNumber;
+  lastResultsValid = true;
+}
+
+double VulkanProfiler::getScopeMs(const char *name) {
+  double total = -1;
+  for (const GpuScopeResult &result : lastResults) {
+    if (strcmp(result.name, name) == 0) {
+      total = (total < 0 ? 0 : total) + result.ms;
+    }
+  }
+  return total;
+}
+
+void VulkanProfiler::printReport() {
+  std::cout << "=======================================\n";
+  if (!lastResultsValid) {
+    std::cout << "GPU profile: no results yet\n";
+    std::cout << "=======================================\n";
+    return;
+  }
+  std::cout << "GPU profile of frame " << lastResultsFrame << " (ms)\n";
+  std::cout << std::fixed << std::setprecision(3);
+  for (const GpuScopeResult &result : lastResults) {
+    std::cout << std::string(result.depth * 2, ' ') << result.name << ": "
+              << result.ms << "\n";
+  }
+  std::cout << std::defaultfloat;
+  std::cout << "=======================================\n";
+}
+} // namespace VulkanStuff
@@ -2,35 +2,170 @@
 
 namespace VulkanStuff {
 
-VulkanRenderer::VulkanRenderer(SDL_Window *sdlWindow) : window{sdlWindow} {
-  vulkanCommand =
-      new VulkanCommand(vulkanDevice.physicalDevice, vulkanDevice.logicalDevice,
-                        vulkanDevice.surface, MAX_FRAMES_IN_FLIGHT);
+// Moves a whole attachment image out of UNDEFINED, its old contents are
+// discarded
+static VkImageMemoryBarrier attachmentBarrier(VkImage image,
+                                              VkImageAspectFlags aspectMask,
+                                              VkImageLayout newLayout,
+                                              VkAccessFlags srcAccessMask,
+                                              VkAccessFlags dstAccessMask) {
+  VkImageMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.srcAccessMask = srcAccessMask;
+  barrier.dstAccessMask = dstAccessMask;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  barrier.newLayout = newLayout;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = image;
+  barrier.subresourceRange.aspectMask = aspectMask;
+  barrier.subresourceRange.baseMipLevel = 0;
+  barrier.subresourceRange.levelCount = 1;
+  barrier.subresourceRange.baseArrayLayer = 0;
+  barrier.subresourceRange.layerCount = 1;
+  return barrier;
+}
+
+VulkanRenderer::VulkanRenderer(SDL_Window *sdlWindow,
+                               RendererSettings settings,
+                               Utils::JobSystem *inputJobSystem)
+    : window{sdlWindow}, vulkanDevice{window, settings.dynamicRendering},
+      // Low latency asks for a single image, clamped up to minImageCount
+      vulkanSwapChain{window,
+                      vulkanDevice.physicalDevice,
+                      vulkanDevice.logicalDevice,
+                      vulkanDevice.surface,
+                      vulkanDevice.allocator,
+                      settings.presentMode,
+                      settings.lowLatency ? 1u : settings.swapchainImages},
+      framesInFlight{settings.lowLatency
+                         ? 1u
+                         : std::clamp(settings.framesInFlight, 1u,
+                                      MAX_FRAMES_IN_FLIGHT)},
+      objectCount{std::max(settings.objectCount, 1u)},
+      jobSystem{inputJobSystem} {
+  PROFILE_FUNCTION();
+  std::cout << "Frames in flight: " << framesInFlight << "\n";
+
+  lowLatency = settings.lowLatency;
+  savedFramesInFlight =
+      std::clamp(settings.framesInFlight, 1u, MAX_FRAMES_IN_FLIGHT);
+  savedSwapchainImages = settings.swapchainImages;
+  usePresentWait = vulkanDevice.presentWaitSupported;
+  std::cout << "Low latency: " << (lowLatency ? "on" : "off")
+            << ", latency measured to " << latencySource() << "\n";
+
+  recordThreadCount = settings.recordThreads;
+  if (recordThreadCount == 0) {
+    recordThreadCount = jobSystem->threadCount();
+  }
+  recordThreadCount = std::clamp(recordThreadCount, 1u, MAX_RECORD_THREADS);
+  std::cout << "Command recording slices: " << recordThreadCount << "\n";
+
+  vulkanCommand = new VulkanCommand(
+      vulkanDevice.physicalDevice, vulkanDevice.logicalDevice,
+      vulkanDevice.surface, framesInFlight, recordThreadCount);
 
   vulkanSyncObject =
-      new VulkanSyncObject(vulkanDevice.logicalDevice, MAX_FRAMES_IN_FLIGHT);
+      new VulkanSyncObject(vulkanDevice.logicalDevice, framesInFlight);
+  if (!vulkanSwapChain.headless) {
+    vulkanSyncObject->createPresentSemaphores(vulkanSwapChain.imageCount);
+  }
+
+  vulkanUploader = new VulkanUploader(
+      vulkanDevice.logicalDevice, vulkanDevice.graphicsQueue,
+      vulkanDevice.graphicsFamily, vulkanDevice.transferQueue,
+      vulkanDevice.transferFamily, vulkanDevice.allocator,
+      vulkanSyncObject->graphicsTimeline, vulkanSyncObject->transferTimeline,
+      STAGING_SIZE);
+
+  // One slot per possible frame slot, like the profiler
+  vulkanCompute = new VulkanCompute(
+      vulkanDevice.logicalDevice, vulkanDevice.computeQueue,
+      vulkanDevice.computeFamily, vulkanSyncObject->computeTimeline,
+      vulkanSyncObject->graphicsTimeline, MAX_FRAMES_IN_FLIGHT);
 
   vulkanBuffer =
       new VulkanBuffer(vulkanDevice.physicalDevice, vulkanDevice.logicalDevice,
-                       vulkanDevice.graphicsQueue, vulkanCommand->commandPool);
+                       vulkanDevice.graphicsQueue, vulkanDevice.allocator,
+                       vulkanUploader);
 
   vulkanImage =
       new VulkanImage(vulkanDevice.physicalDevice, vulkanDevice.logicalDevice,
-                      vulkanDevice.graphicsQueue, vulkanCommand->commandPool,
-                      vulkanSwapChain.swapChainExtent, vulkanSwapChain.swapChainImageFormat);
+                      vulkanDevice.graphicsQueue, vulkanDevice.allocator,
+                      vulkanUploader,
+                      vulkanSwapChain.swapChainExtent, vulkanSwapChain.swapChainImageFormat,
+                      vulkanDevice.msaaSamples);
+
+  textureTable =
+      new VulkanTextureTable(vulkanDevice.physicalDevice,
+                             vulkanDevice.logicalDevice,
+                             vulkanImage->textureSampler);
+
+  // Decoding never blocks startup, the first frames draw the placeholder
+  textureStreamer = new VulkanTextureStreamer(
+      vulkanDevice.logicalDevice, vulkanDevice.allocator, vulkanImage,
+      vulkanUploader, jobSystem, textureTable, jobSystem->threadCount(),
+      TEXTURE_UPLOAD_BUDGET);
+  texture = textureStreamer->request("textures/texture.jpg", 1);
+  secondTexture = textureStreamer->request("textures/amdtexture.jpg", 0);
 
   vulkanPipeline = new VulkanPipeline( vulkanDevice.physicalDevice,
                                 vulkanDevice.logicalDevice,
                                 vulkanDevice.surface,
                                 vulkanDevice.graphicsQueue,
+                                vulkanDevice.msaaSamples,
+                                vulkanDevice.dynamicRendering,
                                 vulkanSwapChain.swapChainExtent,
                                 vulkanSwapChain.swapChainImageFormat,
-                                vulkanSwapChain.swapChainImageViews );
-
-  swapChainFramebuffers = Utils::createFramebuffers(
-      vulkanDevice.logicalDevice, vulkanPipeline->swapChainImageViews,
-      vulkanImage->depthImageView, vulkanPipeline->vulkanRenderPass->renderPass,
-      vulkanPipeline->swapChainExtent, vulkanImage->colorImageView);
+                                vulkanSwapChain.swapChainImageViews,
+                                vulkanSwapChain.finalLayout,
+                                textureTable->descriptorSetLayout,
+                                vulkanDevice.pipelineCache->cache );
+
+  // One slot per possible frame slot, like the profiler. Pools start small
+  // and grow with what a frame actually needs
+  descriptorAllocator = new VulkanDescriptorAllocator(
+      vulkanDevice.logicalDevice, MAX_FRAMES_IN_FLIGHT,
+      {{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.0f},
+       {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1.0f},
+       {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1.0f}},
+      16);
+
+  VkDescriptorUpdateTemplateEntry uniformEntry{};
+  uniformEntry.dstBinding = 0;
+  uniformEntry.dstArrayElement = 0;
+  uniformEntry.descriptorCount = 1;
+  uniformEntry.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+  uniformEntry.offset = 0;
+  uniformEntry.stride = sizeof(VkDescriptorBufferInfo);
+  uniformTemplate = descriptorAllocator->createTemplate(
+      vulkanPipeline->descriptorSetLayout, {uniformEntry},
+      sizeof(VkDescriptorBufferInfo));
+
+  drawArgs = new VulkanDrawArgs(
+      vulkanDevice.logicalDevice, vulkanDevice.allocator,
+      vulkanDevice.graphicsFamily, vulkanDevice.computeFamily,
+      vulkanDevice.pipelineCache->cache);
+
+  VkDescriptorUpdateTemplateEntry drawArgsEntry{};
+  drawArgsEntry.dstBinding = 0;
+  drawArgsEntry.dstArrayElement = 0;
+  drawArgsEntry.descriptorCount = 1;
+  drawArgsEntry.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  drawArgsEntry.offset = 0;
+  drawArgsEntry.stride = sizeof(VkDescriptorBufferInfo);
+  drawArgsTemplate = descriptorAllocator->createTemplate(
+      drawArgs->descriptorSetLayout, {drawArgsEntry},
+      sizeof(VkDescriptorBufferInfo));
+
+  if (!vulkanDevice.dynamicRendering) {
+    swapChainFramebuffers = Utils::createFramebuffers(
+        vulkanDevice.logicalDevice, vulkanPipeline->swapChainImageViews,
+        vulkanImage->depthImageView,
+        vulkanPipeline->vulkanRenderPass->renderPass,
+        vulkanPipeline->swapChainExtent, vulkanImage->colorImageView);
+  }
 
   // vertices = {{{0.0f, -0.5f}, {1.0f, 0.0f, 0.0f}},
   //             {{0.5f, 0.5f}, {0.0f, 1.0f, 0.0f}},
@@ -67,39 +202,37 @@ VulkanRenderer::VulkanRenderer(SDL_Window *sdlWindow) : window{sdlWindow} {
 
   vulkanBuffer->createIndexBuffer(indices);
 
-  vulkanBuffer->createUniformBuffers(vulkanSwapChain.imageCount);
-  vulkanBuffer->createDescriptorPool(vulkanSwapChain.imageCount);
-  vulkanBuffer->createDescriptorSets(
-      vulkanSwapChain.imageCount, vulkanPipeline->descriptorSetLayout,
-      vulkanImage->textureImageView, vulkanImage->textureSampler,
-      vulkanImage->second_textureImageView);
+  createFrameResources();
 
-  // query pool createinfo
-  /*
-  VkQueryPoolCreateInfo queryPoolCreateInfo{};
-  queryPoolCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
-  queryPoolCreateInfo.pNext = nullptr;
-  queryPoolCreateInfo.flags = 0;
-  queryPoolCreateInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
-  queryPoolCreateInfo.queryCount = 2;
-  queryPoolCreateInfo.pipelineStatistics = 0;
-
-  if (vkCreateQueryPool(vulkanDevice.logicalDevice, &queryPoolCreateInfo,
-                        nullptr, &queryPool) != VK_SUCCESS) {
-    throw std::runtime_error("failed to create vkCreateQueryPool!");
-  }
-  */
+  // One query pool per possible frame slot, so changing framesInFlight
+  // doesn't have to rebuild it
+  vulkanProfiler = new VulkanProfiler(
+      vulkanDevice.physicalDevice, vulkanDevice.logicalDevice,
+      vulkanDevice.surface, vulkanDevice.deviceTimestampPeriod,
+      MAX_FRAMES_IN_FLIGHT);
 }
 VulkanRenderer::~VulkanRenderer() {
   vkDeviceWaitIdle(vulkanDevice.logicalDevice);
+  delete uniformRing;
+  delete descriptorAllocator;
+  delete drawArgs;
+  delete vulkanProfiler;
   delete vulkanCommand;
   delete vulkanSyncObject;
   delete vulkanBuffer;
+  delete textureStreamer;
+  delete textureTable;
   delete vulkanImage;
+  delete vulkanUploader;
+  delete vulkanCompute;
 
   for (auto framebuffer : swapChainFramebuffers) {
     vkDestroyFramebuffer(vulkanDevice.logicalDevice, framebuffer, nullptr);
   }
+  // The device is idle, so every retired swapchain can go
+  for (RetiredSwapChain &retired : retiredSwapChains) {
+    destroyRetiredSwapChain(retired);
+  }
 }
 
 void VulkanRenderer::beginRenderPass(VkCommandBuffer commandBuffer,
@@ -124,21 +257,121 @@ void VulkanRenderer::beginRenderPass(VkCommandBuffer commandBuffer,
   renderPassInfo.pClearValues = clearValues.data();
 
   vkCmdBeginRenderPass(commandBuffer, &renderPassInfo,
-                       VK_SUBPASS_CONTENTS_INLINE);
+                       VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
 }
 void VulkanRenderer::endRenderPass(VkCommandBuffer commandBuffer) {
   vkCmdEndRenderPass(commandBuffer);
 }
 
+void VulkanRenderer::beginRendering(VkCommandBuffer commandBuffer,
+                                    uint32_t imageIndex) {
+  // The swapchain image's old contents are never read. The MSAA color and
+  // depth attachments are shared by all frames in flight, so the previous
+  // frame's writes to them finish before this frame clears them
+  VkImageAspectFlags depthAspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+  if (Utils::hasStencilComponent(vulkanImage->depthFormat)) {
+    depthAspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
+  }
+  VkImageMemoryBarrier barriers[3] = {
+      attachmentBarrier(vulkanSwapChain.swapChainImages[imageIndex],
+                        VK_IMAGE_ASPECT_COLOR_BIT,
+                        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, 0,
+                        VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT),
+      attachmentBarrier(vulkanImage->colorImage, VK_IMAGE_ASPECT_COLOR_BIT,
+                        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                        VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                        VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT),
+      attachmentBarrier(vulkanImage->depthImage, depthAspect,
+                        VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT)};
+  VkPipelineStageFlags attachmentStages =
+      VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+      VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+      VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+  vkCmdPipelineBarrier(commandBuffer, attachmentStages, attachmentStages, 0, 0,
+                       nullptr, 0, nullptr, 3, barriers);
+
+  VkRenderingAttachmentInfoKHR colorAttachment{};
+  colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+  colorAttachment.imageView = vulkanImage->colorImageView;
+  colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+  colorAttachment.resolveMode = VK_RESOLVE_MODE_AVERAGE_BIT;
+  colorAttachment.resolveImageView =
+      vulkanSwapChain.swapChainImageViews[imageIndex];
+  colorAttachment.resolveImageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+  colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+  colorAttachment.clearValue.color = {{0.0f, 0.0f, 0.0f, 1.0f}};
+
+  VkRenderingAttachmentInfoKHR depthAttachment{};
+  depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+  depthAttachment.imageView = vulkanImage->depthImageView;
+  depthAttachment.imageLayout =
+      VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+  depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  depthAttachment.clearValue.depthStencil = {1.0f, 0};
+
+  VkRenderingInfoKHR renderingInfo{};
+  renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+  // Same as VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+  renderingInfo.flags = VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT_KHR;
+  renderingInfo.renderArea.offset = {0, 0};
+  renderingInfo.renderArea.extent = vulkanPipeline->swapChainExtent;
+  renderingInfo.layerCount = 1;
+  renderingInfo.colorAttachmentCount = 1;
+  renderingInfo.pColorAttachments = &colorAttachment;
+  renderingInfo.pDepthAttachment = &depthAttachment;
+
+  vkCmdBeginRenderingKHR(commandBuffer, &renderingInfo);
+}
+
+void VulkanRenderer::endRendering(VkCommandBuffer commandBuffer,
+                                  uint32_t imageIndex) {
+  vkCmdEndRenderingKHR(commandBuffer);
+
+  // PRESENT_SRC for the swapchain, TRANSFER_SRC for headless readback
+  VkImageMemoryBarrier barrier = attachmentBarrier(
+      vulkanSwapChain.swapChainImages[imageIndex], VK_IMAGE_ASPECT_COLOR_BIT,
+      vulkanSwapChain.finalLayout, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, 0);
+  barrier.oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+  vkCmdPipelineBarrier(commandBuffer,
+                       VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                       VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0,
+                       nullptr, 1, &barrier);
+}
+
+void VulkanRenderer::setViewportAndScissor(VkCommandBuffer commandBuffer) {
+  VkExtent2D extent = vulkanPipeline->swapChainExtent;
+
+  VkViewport viewport{};
+  viewport.x = 0.0f;
+  viewport.y = 0.0f;
+  viewport.width = (float)extent.width;
+  viewport.height = (float)extent.height;
+  viewport.minDepth = 0.0f;
+  viewport.maxDepth = 1.0f;
+  vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+  VkRect2D scissor{};
+  scissor.offset = {0, 0};
+  scissor.extent = extent;
+  vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+}
+
 void VulkanRenderer::drawObjects(VkCommandBuffer commandBuffer) {
   vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
                     vulkanPipeline->graphicsPipeline);
+  setViewportAndScissor(commandBuffer);
   vkCmdDraw(commandBuffer, 3, 1, 0, 0);
 }
 
 void VulkanRenderer::drawFromVertices(VkCommandBuffer commandBuffer) {
   vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
                     vulkanPipeline->graphicsPipeline);
+  setViewportAndScissor(commandBuffer);
 
   VkBuffer vertexBuffers[] = {vulkanBuffer->vertexBuffer};
   VkDeviceSize offsets[] = {0};
@@ -150,6 +383,7 @@ void VulkanRenderer::drawFromVertices(VkCommandBuffer commandBuffer) {
 void VulkanRenderer::drawFromIndices(VkCommandBuffer commandBuffer) {
   vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
                     vulkanPipeline->graphicsPipeline);
+  setViewportAndScissor(commandBuffer);
 
   VkBuffer vertexBuffers[] = {vulkanBuffer->vertexBuffer};
   VkDeviceSize offsets[] = {0};
@@ -161,77 +395,208 @@ void VulkanRenderer::drawFromIndices(VkCommandBuffer commandBuffer) {
                    0, 0);
 }
 
-void VulkanRenderer::drawFromDescriptors(VkCommandBuffer commandBuffer,
-                                         int imageIndex) {
-  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                    vulkanPipeline->graphicsPipeline);
+void VulkanRenderer::buildDrawList() {
+  drawList.clear();
+
+  // The only set the draws bind, each with its own dynamic offset. The
+  // ring's buffer stays the same, so after the first frame this is a cache
+  // hit
+  VkDescriptorBufferInfo uniformInfo{};
+  uniformInfo.buffer = uniformRing->buffer;
+  uniformInfo.offset = 0;
+  uniformInfo.range = sizeof(Utils::UniformBufferObject);
+  frameDescriptorSet =
+      descriptorAllocator->getSet(uniformTemplate, &uniformInfo);
+
+  // Resident textures keep their slot, so the indices picked here stay
+  // valid for as long as the frame is in flight
+  uint32_t quadTexture = textureStreamer->getTextureIndex(texture);
+  uint32_t triangleTexture = textureStreamer->getTextureIndex(secondTexture);
+
+  // Even objects are the textured quad, odd ones the triangle behind it.
+  // draw_args.comp picks their index ranges by the same rule
+  for (uint32_t i = 0; i < objectCount; i++) {
+    uint32_t uniformOffset = objectUniformOffset + i * objectUniformStride;
+    drawList.push_back(
+        {uniformOffset, i % 2 == 0 ? quadTexture : triangleTexture});
+  }
+}
 
-  VkBuffer vertexBuffers[] = {vulkanBuffer->vertexBuffer};
-  VkDeviceSize offsets[] = {0};
-  vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
-  vkCmdBindIndexBuffer(commandBuffer, vulkanBuffer->indexBuffer, 0,
-                       VK_INDEX_TYPE_UINT16);
+void VulkanRenderer::dispatchDrawArgs(uint32_t frameIndex) {
+  PROFILE_FUNCTION();
+  uint32_t drawCount = static_cast<uint32_t>(drawList.size());
+  drawArgsOffset = static_cast<VkDeviceSize>(drawArgs->firstDraw(frameIndex)) *
+                   sizeof(VkDrawIndexedIndirectCommand);
+
+  // The shader indexes the whole buffer, so this is a cache hit after the
+  // first frame too
+  VkDescriptorBufferInfo argsInfo{};
+  argsInfo.buffer = drawArgs->buffer;
+  argsInfo.offset = 0;
+  argsInfo.range = VK_WHOLE_SIZE;
+  VkDescriptorSet argsSet =
+      descriptorAllocator->getSet(drawArgsTemplate, &argsInfo);
+
+  // The slot's region was last read by the slot's previous frame. drawFrame
+  // already waited for it, so this wait is normally skipped
+  vulkanCompute->submit(
+      [&](VkCommandBuffer commandBuffer) {
+        drawArgs->record(commandBuffer, argsSet, frameIndex, drawCount);
+      },
+      VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT_KHR,
+      vulkanSyncObject->frameTimelineValues[frameIndex]);
+}
 
-  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                          vulkanPipeline->pipelineLayout, 0, 1,
-                          &vulkanBuffer->descriptorSets[imageIndex], 0,
-                          nullptr);
+void VulkanRenderer::recordDrawList(VkCommandBuffer commandBuffer,
+                                    uint32_t frameIndex, uint32_t imageIndex) {
+  PROFILE_FUNCTION();
+  uint32_t drawCount = static_cast<uint32_t>(drawList.size());
+  if (drawCount == 0) {
+    return;
+  }
+
+  uint32_t sliceSize = (drawCount + recordThreadCount - 1) / recordThreadCount;
+  uint32_t sliceCount = (drawCount + sliceSize - 1) / sliceSize;
+
+  // Slice i always goes to pool i, whichever thread picks it up, so no pool
+  // is ever used by two threads at once
+  VulkanCommand::FrameCommands &frame =
+      vulkanCommand->frameCommands[frameIndex];
+  jobSystem->parallelFor(sliceCount, 1, [&](uint32_t begin, uint32_t end) {
+    for (uint32_t slice = begin; slice < end; slice++) {
+      uint32_t firstDraw = slice * sliceSize;
+      recordDrawSlice(frame.secondaryBuffers[slice], imageIndex, firstDraw,
+                      std::min(sliceSize, drawCount - firstDraw));
+    }
+  });
+
+  vkCmdExecuteCommands(commandBuffer, sliceCount,
+                       frame.secondaryBuffers.data());
+}
+
+void VulkanRenderer::recordDrawSlice(VkCommandBuffer secondaryBuffer,
+                                     uint32_t imageIndex, uint32_t firstDraw,
+                                     uint32_t drawCount) {
+  PROFILE_FUNCTION();
+  // With dynamic rendering the secondary only learns the attachment
+  // formats, not the attachments
+  VkCommandBufferInheritanceRenderingInfoKHR renderingInheritance{};
+  renderingInheritance.sType =
+      VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO_KHR;
+  renderingInheritance.colorAttachmentCount = 1;
+  renderingInheritance.pColorAttachmentFormats =
+      &vulkanPipeline->swapChainImageFormat;
+  renderingInheritance.depthAttachmentFormat = vulkanImage->depthFormat;
+  renderingInheritance.rasterizationSamples = vulkanDevice.msaaSamples;
+
+  VkCommandBufferInheritanceInfo inheritanceInfo{};
+  inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+  if (vulkanDevice.dynamicRendering) {
+    inheritanceInfo.pNext = &renderingInheritance;
+  } else {
+    inheritanceInfo.renderPass = vulkanPipeline->vulkanRenderPass->renderPass;
+    inheritanceInfo.subpass = 0;
+    inheritanceInfo.framebuffer = swapChainFramebuffers[imageIndex];
+  }
 
-  // vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(indices.size()), 1,
-  // 0,
-  //                  0, 0);
+  VkCommandBufferBeginInfo beginInfo{};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT |
+                    VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+  if (vkBeginCommandBuffer(secondaryBuffer, &beginInfo) != VK_SUCCESS) {
+    throw std::runtime_error("failed to begin secondary command buffer!");
+  }
 
-  // first object
-  vkCmdDrawIndexed(commandBuffer, 6, 1, 0, 0, 0);
+  // Secondary buffers inherit no state from the primary, dynamic state
+  // included
+  if (vulkanDevice.dispatch.hasExtendedDynamicState3) {
+    vkCmdSetRasterizationSamplesEXT(secondaryBuffer, vulkanDevice.msaaSamples);
+  }
+  vkCmdBindPipeline(secondaryBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                    vulkanPipeline->graphicsPipeline);
+  setViewportAndScissor(secondaryBuffer);
 
-  // Second object
-  // vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-  //                         vulkanPipeline->pipelineLayout, 0, 1,
-  //                         &vulkanBuffer->descriptorSets[0], 0, nullptr);
+  VkBuffer vertexBuffers[] = {vulkanBuffer->vertexBuffer};
+  VkDeviceSize offsets[] = {0};
+  vkCmdBindVertexBuffers(secondaryBuffer, 0, 1, vertexBuffers, offsets);
+  vkCmdBindIndexBuffer(secondaryBuffer, vulkanBuffer->indexBuffer, 0,
+                       VK_INDEX_TYPE_UINT16);
 
-  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                          vulkanPipeline->pipelineLayout, 0, 1,
-                          &vulkanBuffer->secondDescriptorSet, 0, nullptr);
+  // The texture table stays bound for the whole slice
+  vkCmdBindDescriptorSets(secondaryBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                          vulkanPipeline->pipelineLayout, 1, 1,
+                          &textureTable->descriptorSet, 0, nullptr);
+
+  // Rebinding with a new dynamic offset and pushing the texture index is all
+  // a new object costs
+  for (uint32_t i = firstDraw; i < firstDraw + drawCount; i++) {
+    const DrawCommand &draw = drawList[i];
+    vkCmdBindDescriptorSets(secondaryBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                            vulkanPipeline->pipelineLayout, 0, 1,
+                            &frameDescriptorSet, 1, &draw.uniformOffset);
+    Utils::DrawPushConstants constants{draw.textureIndex};
+    vkCmdPushConstants(secondaryBuffer, vulkanPipeline->pipelineLayout,
+                       VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(constants),
+                       &constants);
+    vkCmdDrawIndexedIndirect(
+        secondaryBuffer, drawArgs->buffer,
+        drawArgsOffset + i * sizeof(VkDrawIndexedIndirectCommand), 1,
+        sizeof(VkDrawIndexedIndirectCommand));
+  }
 
-  vkCmdDrawIndexed(commandBuffer, 3, 1, 6, 0, 0);
+  if (vkEndCommandBuffer(secondaryBuffer) != VK_SUCCESS) {
+    throw std::runtime_error("failed to record secondary command buffer!");
+  }
 }
 
 void VulkanRenderer::clearColorImage() {
+  if (!textureStreamer->isResident(texture)) {
+    std::cout << "Texture not resident yet, nothing to clear\n";
+    return;
+  }
+  const VulkanTextureStreamer::StreamedTexture &streamed =
+      textureStreamer->textures[texture];
+  // Block compressed images can't be cleared
+  Utils::TextureBlockInfo blockInfo;
+  if (!Utils::getTextureBlockInfo(streamed.format, blockInfo) ||
+      blockInfo.compressed) {
+    std::cout << "Texture is block compressed, can't clear it\n";
+    return;
+  }
+  VkImage textureImage = streamed.image;
 
-  vulkanImage->transitionImageLayout(vulkanImage->textureImage,
-                                     VK_FORMAT_R8G8B8A8_SRGB,
+  // Goes out with the next frame. Frames still in flight sample the texture,
+  // the transition's barrier keeps the clear behind their fragment shaders.
+  // The view samples every mip, so all of them are cleared
+  vulkanImage->transitionImageLayout(textureImage, streamed.format,
+                                     streamed.mipLevels,
                                      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
                                      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
 
-  VkCommandBuffer commandBuffer = Utils::beginSingleTimeCommands(
-      vulkanDevice.logicalDevice, vulkanBuffer->commandPool);
-  VkImageSubresourceRange ImageSubresourceRange;
-  ImageSubresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-  ImageSubresourceRange.baseMipLevel = 0;
-  ImageSubresourceRange.levelCount = 1;
-  ImageSubresourceRange.baseArrayLayer = 0;
-  ImageSubresourceRange.layerCount = 1;
-
-  VkClearColorValue ClearColorValue = {0, 0.111111, 0.222222, 0.333333};
-  vkCmdClearColorImage(commandBuffer, vulkanImage->textureImage,
-                       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &ClearColorValue,
-                       1, &ImageSubresourceRange);
-
-  Utils::endSingleTimeCommands(vulkanDevice.logicalDevice,
-                               vulkanBuffer->commandPool, commandBuffer,
-                               vulkanDevice.graphicsQueue);
-
-  vulkanImage->transitionImageLayout(vulkanImage->textureImage,
-                                     VK_FORMAT_R8G8B8A8_SRGB,
+  vulkanUploader->record([&](VkCommandBuffer commandBuffer) {
+    VkImageSubresourceRange ImageSubresourceRange;
+    ImageSubresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    ImageSubresourceRange.baseMipLevel = 0;
+    ImageSubresourceRange.levelCount = streamed.mipLevels;
+    ImageSubresourceRange.baseArrayLayer = 0;
+    ImageSubresourceRange.layerCount = 1;
+
+    VkClearColorValue ClearColorValue = {0, 0.111111, 0.222222, 0.333333};
+    vkCmdClearColorImage(commandBuffer, textureImage,
+                         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &ClearColorValue,
+                         1, &ImageSubresourceRange);
+  });
+
+  vulkanImage->transitionImageLayout(textureImage, streamed.format,
+                                     streamed.mipLevels,
                                      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
                                      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 }
 
 void VulkanRenderer::beginDrawingCommandBuffer(VkCommandBuffer commandBuffer) {
-
-  if (vkResetCommandBuffer(commandBuffer, 0) != VK_SUCCESS) {
-    throw std::runtime_error("failed to reset command buffer!");
-  }
+  // Already reset along with its pool by VulkanCommand::resetFrame
   VkCommandBufferBeginInfo beginInfo{};
   beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
   // telling driver about our onetime usage
@@ -240,111 +605,303 @@ void VulkanRenderer::beginDrawingCommandBuffer(VkCommandBuffer commandBuffer) {
   vkBeginCommandBuffer(commandBuffer, &beginInfo);
 }
 
-void VulkanRenderer::endDrawingCommandBuffer(
-    VkCommandBuffer commandBuffer, VkSemaphore imageAvailableSemaphore,
-    VkSemaphore renderFinishedSemaphore, VkFence inFlightFence) {
+void VulkanRenderer::endDrawingCommandBuffer(VkCommandBuffer commandBuffer) {
   if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
     throw std::runtime_error("failed to record drawing command buffer!");
   }
-  VkSubmitInfo submitInfo{};
-  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  addFrameCommandBuffer(commandBuffer);
+}
+
+void VulkanRenderer::addFrameCommandBuffer(VkCommandBuffer commandBuffer) {
+  VkCommandBufferSubmitInfoKHR commandBufferInfo{};
+  commandBufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO_KHR;
+  commandBufferInfo.commandBuffer = commandBuffer;
+  frameCommandBuffers.push_back(commandBufferInfo);
+}
 
-  VkSemaphore waitSemaphores[] = {imageAvailableSemaphore};
-  VkPipelineStageFlags waitStages[] = {
-      VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-  submitInfo.waitSemaphoreCount = 1;
-  submitInfo.pWaitSemaphores = waitSemaphores;
-  submitInfo.pWaitDstStageMask = waitStages;
+void VulkanRenderer::addFrameWaitSemaphore(VkSemaphore semaphore,
+                                           uint64_t value,
+                                           VkPipelineStageFlags2KHR stageMask) {
+  VkSemaphoreSubmitInfoKHR waitInfo{};
+  waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO_KHR;
+  waitInfo.semaphore = semaphore;
+  waitInfo.value = value;
+  waitInfo.stageMask = stageMask;
+  frameWaitSemaphores.push_back(waitInfo);
+}
 
-  submitInfo.commandBufferCount = 1;
-  submitInfo.pCommandBuffers = &commandBuffer;
+void VulkanRenderer::submitFrame(VkSemaphore imageAvailableSemaphore,
+                                 VkSemaphore renderFinishedSemaphore) {
+  PROFILE_FUNCTION();
+  // Headless frames have no acquire or present, both semaphores are null
+  if (imageAvailableSemaphore != VK_NULL_HANDLE) {
+    addFrameWaitSemaphore(imageAvailableSemaphore, 0,
+                          VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR);
+  }
 
-  VkSemaphore signalSemaphores[] = {renderFinishedSemaphore};
-  submitInfo.signalSemaphoreCount = 1;
-  submitInfo.pSignalSemaphores = signalSemaphores;
+  VulkanTimeline *timeline = vulkanSyncObject->graphicsTimeline;
+  uint64_t signalValue = timeline->nextValue();
+
+  // Timeline value for everyone else, binary semaphore for present
+  VkSemaphoreSubmitInfoKHR signalInfos[2]{};
+  uint32_t signalCount = 0;
+
+  signalInfos[signalCount].sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO_KHR;
+  signalInfos[signalCount].semaphore = timeline->semaphore;
+  signalInfos[signalCount].value = signalValue;
+  signalInfos[signalCount].stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT_KHR;
+  signalCount++;
+
+  if (renderFinishedSemaphore != VK_NULL_HANDLE) {
+    signalInfos[signalCount].sType =
+        VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO_KHR;
+    signalInfos[signalCount].semaphore = renderFinishedSemaphore;
+    signalInfos[signalCount].stageMask =
+        VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT_KHR;
+    signalCount++;
+  }
 
-  if (vkQueueSubmit(vulkanDevice.graphicsQueue, 1, &submitInfo,
-                    inFlightFence) != VK_SUCCESS) {
+  VkSubmitInfo2KHR submitInfo{};
+  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2_KHR;
+  submitInfo.waitSemaphoreInfoCount =
+      static_cast<uint32_t>(frameWaitSemaphores.size());
+  submitInfo.pWaitSemaphoreInfos = frameWaitSemaphores.data();
+  submitInfo.commandBufferInfoCount =
+      static_cast<uint32_t>(frameCommandBuffers.size());
+  submitInfo.pCommandBufferInfos = frameCommandBuffers.data();
+  submitInfo.signalSemaphoreInfoCount = signalCount;
+  submitInfo.pSignalSemaphoreInfos = signalInfos;
+
+  if (vkQueueSubmit2KHR(vulkanDevice.graphicsQueue, 1, &submitInfo,
+                        VK_NULL_HANDLE) != VK_SUCCESS) {
     throw std::runtime_error("failed to submit draw command buffer!");
   }
 
-  vkQueueWaitIdle(vulkanDevice.graphicsQueue);
-  //getQueryPoolTimes();
-  /*
-  vkQueueWaitIdle(vulkanDevice.graphicsQueue);
+  // No wait here, the timeline value is what tells drawFrame when this frame
+  // slot can be reused
+  vulkanSyncObject->frameTimelineValues[currentFrame] = signalValue;
 
-  vkFreeCommandBuffers(vulkanDevice.logicalDevice, vulkanCommand->commandPool,
-                       1, &commandBuffer);
-                       */
+  frameCommandBuffers.clear();
+  frameWaitSemaphores.clear();
 }
 
-void VulkanRenderer::cleanupSwapChain() {
-  vkDestroyPipeline(vulkanDevice.logicalDevice, vulkanPipeline->graphicsPipeline,
-                    nullptr);
-  vkDestroyPipelineLayout(vulkanDevice.logicalDevice,
-                          vulkanPipeline->pipelineLayout, nullptr);
+void VulkanRenderer::requestResize() {
+  framebufferResized = true;
+  lastResizeRequest = std::chrono::steady_clock::now();
+}
 
-  for (auto framebuffer : swapChainFramebuffers) {
+void VulkanRenderer::releaseRetiredSwapChains() {
+  while (!retiredSwapChains.empty() &&
+         vulkanSyncObject->graphicsTimeline->isComplete(
+             retiredSwapChains.front().timelineValue)) {
+    destroyRetiredSwapChain(retiredSwapChains.front());
+    retiredSwapChains.pop_front();
+  }
+}
+
+void VulkanRenderer::destroyRetiredSwapChain(RetiredSwapChain &retired) {
+  for (auto framebuffer : retired.framebuffers) {
     vkDestroyFramebuffer(vulkanDevice.logicalDevice, framebuffer, nullptr);
   }
+  vkDestroyImageView(vulkanDevice.logicalDevice, retired.depthImageView,
+                     nullptr);
+  vulkanDevice.allocator->destroyImage(retired.depthImage,
+                                      retired.depthImageMemory);
+  vkDestroyImageView(vulkanDevice.logicalDevice, retired.colorImageView,
+                     nullptr);
+  vulkanDevice.allocator->destroyImage(retired.colorImage,
+                                      retired.colorImageMemory);
+  for (VkSemaphore semaphore : retired.renderFinishedSemaphores) {
+    vkDestroySemaphore(vulkanDevice.logicalDevice, semaphore, nullptr);
+  }
+  vulkanSwapChain.destroyRetired(retired.swapChain);
+}
 
+void VulkanRenderer::recreateRenderPass() {
+  PROFILE_FUNCTION();
+  std::cout << "Swapchain format changed, rebuilding render pass and "
+               "pipeline\n";
+  // Rare enough that waiting beats retiring the pipeline along with the
+  // swapchain
+  vkDeviceWaitIdle(vulkanDevice.logicalDevice);
+  vkDestroyPipeline(vulkanDevice.logicalDevice,
+                    vulkanPipeline->graphicsPipeline, nullptr);
+  vkDestroyPipelineLayout(vulkanDevice.logicalDevice,
+                          vulkanPipeline->pipelineLayout, nullptr);
   delete vulkanPipeline->vulkanRenderPass;
-
-  for (size_t i = 0; i < vulkanSwapChain.swapChainImageViews.size(); i++) {
-    vkDestroyImageView(vulkanDevice.logicalDevice,
-                       vulkanSwapChain.swapChainImageViews[i], nullptr);
+  vulkanPipeline->vulkanRenderPass = nullptr;
+
+  // Dynamic rendering pipelines carry the format themselves
+  if (!vulkanDevice.dynamicRendering) {
+    vulkanPipeline->vulkanRenderPass = new VulkanRenderPass(
+        vulkanDevice.physicalDevice, vulkanDevice.logicalDevice,
+        vulkanDevice.msaaSamples, vulkanSwapChain.swapChainImageFormat,
+        vulkanSwapChain.finalLayout);
   }
-
-  vkDestroySwapchainKHR(vulkanDevice.logicalDevice, vulkanSwapChain.swapChain,
-                        nullptr);
-
-  // due to recreation of depth images need to kill the existing one first
-  vkDestroyImage(vulkanDevice.logicalDevice, vulkanImage->depthImage, nullptr);
-  vkFreeMemory(vulkanDevice.logicalDevice, vulkanImage->depthImageMemory,
-               nullptr);
-  vkDestroyImageView(vulkanDevice.logicalDevice, vulkanImage->depthImageView,
-                     nullptr);
+  vulkanPipeline->swapChainImageFormat = vulkanSwapChain.swapChainImageFormat;
+  vulkanPipeline->createGraphicsPipeline();
 }
 void VulkanRenderer::recreateSwapChain() {
+  PROFILE_FUNCTION();
+  framebufferResized = false;
+  // Offscreen images keep their size
+  if (vulkanSwapChain.headless) {
+    return;
+  }
   std::cout << "Recreating Swapchain\n";
 
   Uint32 flags = SDL_GetWindowFlags(window);
   Utils::showWindowFlags(flags);
 
-  // don't recreate swapchain if minimized
+  // don't recreate swapchain if minimized. Events stay queued for the game
+  // loop, a quit leaves the swapchain stale so the loop can exit
   while (flags & SDL_WINDOW_MINIMIZED) {
+    SDL_PumpEvents();
+    if (SDL_HasEvent(SDL_QUIT)) {
+      framebufferResized = true;
+      return;
+    }
     flags = SDL_GetWindowFlags(window);
-    SDL_Event event;
-    SDL_WaitEvent(&event);
+    SDL_Delay(MINIMIZED_POLL_MS);
   }
 
-  vkDeviceWaitIdle(vulkanDevice.logicalDevice);
-
-  cleanupSwapChain();
-
-  // recreateswapchain
-  vulkanSwapChain.createSwapChain();
-  vulkanSwapChain.createSwapChainImageViews();
+  // No device wait, frames in flight finish on the old swapchain's images.
+  // Their last presents were queued behind the newest submission
+  RetiredSwapChain retired;
+  retired.timelineValue = vulkanSyncObject->graphicsTimeline->submittedValue;
+  retired.framebuffers = swapChainFramebuffers;
+  retired.depthImage = vulkanImage->depthImage;
+  retired.depthImageMemory = vulkanImage->depthImageMemory;
+  retired.depthImageView = vulkanImage->depthImageView;
+  retired.colorImage = vulkanImage->colorImage;
+  retired.colorImageMemory = vulkanImage->colorImageMemory;
+  retired.colorImageView = vulkanImage->colorImageView;
+  retired.swapChain = vulkanSwapChain.recreateSwapChain();
+  // Presents to the old swapchain may still wait on these, and acquiring
+  // from the new one says nothing about them. The image count may change
+  // too, so every image gets a fresh one
+  retired.renderFinishedSemaphores =
+      vulkanSyncObject->retirePresentSemaphores();
+  vulkanSyncObject->createPresentSemaphores(vulkanSwapChain.imageCount);
+  retiredSwapChains.push_back(retired);
+
+  // Present ids only mean something to the swapchain they went to
+  if (usePresentWait) {
+    pendingLatencies.clear();
+  }
 
-  // recreate renderpass
-  vulkanPipeline->vulkanRenderPass = new VulkanRenderPass(
-      vulkanDevice.physicalDevice, vulkanDevice.logicalDevice,
-      vulkanSwapChain.swapChainImageFormat);
+  // Viewport and scissor are dynamic, so a plain resize keeps the pipeline
+  if (vulkanSwapChain.swapChainImageFormat !=
+      vulkanPipeline->swapChainImageFormat) {
+    recreateRenderPass();
+  }
 
   // reassign swapchain vars for framebuffers recreation
-  vulkanPipeline->swapChainImageFormat = vulkanSwapChain.swapChainImageFormat;
   vulkanPipeline->swapChainImageViews = vulkanSwapChain.swapChainImageViews;
   vulkanPipeline->swapChainExtent = vulkanSwapChain.swapChainExtent;
 
-  vulkanPipeline->createGraphicsPipeline();
-
   vulkanImage->swapChainExtent = vulkanSwapChain.swapChainExtent;
+  vulkanImage->swapchainFormat = vulkanSwapChain.swapChainImageFormat;
   vulkanImage->createDepthResources();
+  vulkanImage->createColorResources();
+
+  // Attachments are named per frame with dynamic rendering
+  if (!vulkanDevice.dynamicRendering) {
+    swapChainFramebuffers = Utils::createFramebuffers(
+        vulkanDevice.logicalDevice, vulkanPipeline->swapChainImageViews,
+        vulkanImage->depthImageView,
+        vulkanPipeline->vulkanRenderPass->renderPass,
+        vulkanPipeline->swapChainExtent, vulkanImage->colorImageView);
+  }
+}
+
+void VulkanRenderer::setPresentMode(VkPresentModeKHR presentMode) {
+  PROFILE_FUNCTION();
+  if (vulkanSwapChain.headless) {
+    std::cout << "Nothing is presented in headless mode\n";
+    return;
+  }
+  std::cout << "Present mode: "
+            << Utils::presentModeName(vulkanSwapChain.presentMode) << " -> "
+            << Utils::presentModeName(presentMode) << "\n";
+  vulkanSwapChain.requestedPresentMode = presentMode;
+  recreateSwapChain();
+}
+
+void VulkanRenderer::setSwapchainImageCount(uint32_t count) {
+  PROFILE_FUNCTION();
+  if (vulkanSwapChain.headless) {
+    std::cout << "Nothing is presented in headless mode\n";
+    return;
+  }
+  vulkanSwapChain.requestedImageCount = count;
+  recreateSwapChain();
+}
 
-  swapChainFramebuffers = Utils::createFramebuffers(
-      vulkanDevice.logicalDevice, vulkanPipeline->swapChainImageViews,
-      vulkanImage->depthImageView, vulkanPipeline->vulkanRenderPass->renderPass,
-      vulkanPipeline->swapChainExtent, vulkanImage->colorImageView);
+void VulkanRenderer::setLowLatency(bool enabled) {
+  if (enabled == lowLatency) {
+    return;
+  }
+  std::cout << "Low latency: " << (enabled ? "on" : "off") << "\n";
+  lowLatency = enabled;
+  if (enabled) {
+    savedFramesInFlight = framesInFlight;
+    savedSwapchainImages = vulkanSwapChain.requestedImageCount;
+    setFramesInFlight(1);
+    // Clamped up to minImageCount
+    setSwapchainImageCount(1);
+  } else {
+    setFramesInFlight(savedFramesInFlight);
+    setSwapchainImageCount(savedSwapchainImages);
+  }
+}
+
+void VulkanRenderer::waitBeforeInput() {
+  PROFILE_FUNCTION();
+  lastFrameStats.latencyValid = false;
+  // Input sampled after the previous frame is on screen is as fresh as it
+  // gets without missing the next refresh
+  if (lowLatency && usePresentWait && !pendingLatencies.empty()) {
+    vkWaitForPresentKHR(vulkanDevice.logicalDevice, vulkanSwapChain.swapChain,
+                        pendingLatencies.back().presentId,
+                        PRESENT_WAIT_TIMEOUT_NS);
+  }
+  pollLatency();
+  inputSampleTime = std::chrono::steady_clock::now();
+}
+
+void VulkanRenderer::pollLatency() {
+  while (!pendingLatencies.empty()) {
+    const PendingLatency &pending = pendingLatencies.front();
+    bool presented = true;
+    if (pending.presentId != 0) {
+      VkResult result =
+          vkWaitForPresentKHR(vulkanDevice.logicalDevice,
+                              vulkanSwapChain.swapChain, pending.presentId, 0);
+      if (result == VK_TIMEOUT) {
+        break;
+      }
+      // Out of date or lost surfaces never report it, the sample is dropped
+      presented = result == VK_SUCCESS;
+    } else if (!vulkanSyncObject->graphicsTimeline->isComplete(
+                   pending.timelineValue)) {
+      break;
+    }
+
+    // Polling can't tell when the frame finished, only that it has by now
+    if (presented) {
+      lastFrameStats.latencyBoundMs =
+          std::chrono::duration<double, std::milli>(
+              std::chrono::steady_clock::now() - pending.inputTime)
+              .count();
+      lastFrameStats.latencyValid = true;
+    }
+    pendingLatencies.pop_front();
+  }
+}
+
+const char *VulkanRenderer::latencySource() const {
+  return usePresentWait ? "present" : "gpu";
 }
 
 void VulkanRenderer::recreateVertexBuffer(
@@ -354,7 +911,58 @@ void VulkanRenderer::recreateVertexBuffer(
   vulkanBuffer->createVertexBuffer(inputVertices);
 }
 
-void VulkanRenderer::updateUniformBuffer(uint32_t currentImage) {
+void VulkanRenderer::createFrameResources() {
+  // Room for every object plus a little for anything else per frame. 256 is
+  // the largest minUniformBufferOffsetAlignment the spec allows
+  VkDeviceSize bytesPerFrame =
+      objectCount * 256 + sizeof(Utils::UniformBufferObject) * 64;
+  uniformRing =
+      new VulkanUniformRing(vulkanDevice.physicalDevice,
+                            vulkanDevice.logicalDevice, vulkanDevice.allocator,
+                            framesInFlight, bytesPerFrame);
+  objectUniformStride = static_cast<uint32_t>(
+      uniformRing->alignUp(sizeof(Utils::UniformBufferObject)));
+  drawArgs->createBuffer(objectCount, framesInFlight);
+}
+
+void VulkanRenderer::cleanupFrameResources() {
+  // Cached sets point at the ring's and the draw args' buffers
+  descriptorAllocator->resetPersistent();
+  delete uniformRing;
+  uniformRing = nullptr;
+  drawArgs->destroyBuffer();
+}
+
+void VulkanRenderer::setFramesInFlight(uint32_t number) {
+  PROFILE_FUNCTION();
+  number = std::clamp(number, 1u, MAX_FRAMES_IN_FLIGHT);
+  if (number == framesInFlight) {
+    return;
+  }
+  std::cout << "Frames in flight: " << framesInFlight << " -> " << number
+            << "\n";
+
+  // Every frame slot gets rebuilt, so nothing may still be executing
+  vkDeviceWaitIdle(vulkanDevice.logicalDevice);
+
+  framesInFlight = number;
+  currentFrame = 0;
+
+  // The timeline itself survives, only the per-slot objects are rebuilt
+  vulkanSyncObject->cleanupSyncObjects();
+  vulkanSyncObject->createSyncObjects(framesInFlight);
+
+  vulkanCommand->freeCommandBuffers();
+  vulkanCommand->createCommandBuffers(framesInFlight);
+
+  vulkanProfiler->resetSlots();
+
+  cleanupFrameResources();
+  createFrameResources();
+}
+
+void VulkanRenderer::updateUniformBuffer(uint32_t frameIndex) {
+  PROFILE_FUNCTION();
   /*
   static auto startTime = std::chrono::high_resolution_clock::now();
 
@@ -364,142 +972,261 @@ void VulkanRenderer::updateUniformBuffer(uint32_t currentImage) {
                    .count();
 */
 
-  Utils::UniformBufferObject ubo{};
-  ubo.model = glm::rotate(glm::mat4(1.0f), rotation * glm::radians(90.0f),
-                          glm::vec3(0.0f, 0.0f, 1.0f));
-  ubo.view =
+  glm::mat4 view =
       glm::lookAt(glm::vec3(1.0f, 1.0f, 1.0f), glm::vec3(0.0f, 0.0f, 0.0f),
                   glm::vec3(0.0f, 0.0f, 1.0f));
 
-  ubo.proj = glm::perspective(glm::radians(45.0f),
-                              vulkanSwapChain.swapChainExtent.width /
-                                  (float)vulkanSwapChain.swapChainExtent.height,
-                              0.1f, 10.0f);
-
-  ubo.proj[1][1] *= -1;
-
-  void *data;
-  vkMapMemory(vulkanDevice.logicalDevice,
-              vulkanBuffer->uniformBuffersMemory[currentImage], 0, sizeof(ubo),
-              0, &data);
-  memcpy(data, &ubo, sizeof(ubo));
-  vkUnmapMemory(vulkanDevice.logicalDevice,
-                vulkanBuffer->uniformBuffersMemory[currentImage]);
+  glm::mat4 proj = glm::perspective(
+      glm::radians(45.0f),
+      vulkanSwapChain.swapChainExtent.width /
+          (float)vulkanSwapChain.swapChainExtent.height,
+      0.1f, 10.0f);
+
+  proj[1][1] *= -1;
+
+  glm::mat4 spin = glm::rotate(glm::mat4(1.0f), rotation * glm::radians(90.0f),
+                               glm::vec3(0.0f, 0.0f, 1.0f));
+
+  // Objects come in pairs (quad and triangle) on a square grid that fills
+  // the area the original pair covered, so 2 objects is the original scene
+  uint32_t pairCount = (objectCount + 1) / 2;
+  uint32_t gridSide =
+      static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(pairCount))));
+  float cellSize = 1.0f / gridSide;
+  float gridCenter = (gridSide - 1) * 0.5f;
+
+  // The previous submission of this slot is done, so its region is free
+  uniformRing->beginFrame(frameIndex);
+  VulkanUniformRing::Allocation block =
+      uniformRing->allocate(objectCount * objectUniformStride);
+  objectUniformOffset = block.offset;
+  uint8_t *objectData = static_cast<uint8_t *>(block.data);
+
+  jobSystem->parallelFor(objectCount, 256, [&](uint32_t begin, uint32_t end) {
+    for (uint32_t i = begin; i < end; i++) {
+      uint32_t pair = i / 2;
+      glm::vec3 position{(pair % gridSide - gridCenter) * cellSize,
+                         (pair / gridSide - gridCenter) * cellSize, 0.0f};
+
+      // Written straight into mapped memory, never read back
+      Utils::UniformBufferObject *ubo =
+          reinterpret_cast<Utils::UniformBufferObject *>(
+              objectData + i * objectUniformStride);
+      ubo->model = glm::scale(glm::translate(spin, position),
+                              glm::vec3(cellSize, cellSize, cellSize));
+      ubo->view = view;
+      ubo->proj = proj;
+    }
+  });
 }
 
 void VulkanRenderer::drawFrame(uint32_t queryIndex) {
-  // std::cout << "Drawing frame: " << currentFrame << "\n";
-  vkWaitForFences(vulkanDevice.logicalDevice, 1,
-                  &vulkanSyncObject->inFlightFences[currentFrame], VK_TRUE,
-                  UINT64_MAX);
+  PROFILE_FUNCTION();
+  using Clock = std::chrono::steady_clock;
+  using Milliseconds = std::chrono::duration<double, std::milli>;
 
-  VkResult result = vkAcquireNextImageKHR(
-      vulkanDevice.logicalDevice, vulkanSwapChain.swapChain, UINT64_MAX,
-      vulkanSyncObject->imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE,
-      &currentImage);
+  // std::cout << "Drawing frame: " << currentFrame << "\n";
+  // Only blocks when the GPU is framesInFlight frames behind the CPU
+  auto waitStart = Clock::now();
+  vulkanSyncObject->graphicsTimeline->wait(
+      vulkanSyncObject->frameTimelineValues[currentFrame]);
+  lastFrameStats.frameWaitMs = Milliseconds(Clock::now() - waitStart).count();
+  lastFrameStats.skipped = false;
+  releaseRetiredSwapChains();
+  pollLatency();
+
+  // Headless rendering goes through the same path, just without the
+  // acquire/present semaphores
+  VkSemaphore imageAvailableSemaphore = VK_NULL_HANDLE;
+  VkSemaphore renderFinishedSemaphore = VK_NULL_HANDLE;
+  if (!vulkanSwapChain.headless) {
+    imageAvailableSemaphore =
+        vulkanSyncObject->imageAvailableSemaphores[currentFrame];
+  }
 
+  auto acquireStart = Clock::now();
+  VkResult result =
+      vulkanSwapChain.acquireNextImage(imageAvailableSemaphore, &currentImage);
   if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+    // Nothing was acquired, so the frame can still go to the new swapchain
+    // instead of being dropped
     recreateSwapChain();
+    result = vulkanSwapChain.acquireNextImage(imageAvailableSemaphore,
+                                              &currentImage);
+  }
+  lastFrameStats.acquireMs = Milliseconds(Clock::now() - acquireStart).count();
+
+  if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+    lastFrameStats.skipped = true;
     return;
   } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
     throw std::runtime_error("failed to acquire swap chain image!");
   }
+  if (!vulkanSwapChain.headless) {
+    renderFinishedSemaphore =
+        vulkanSyncObject->renderFinishedSemaphores[currentImage];
+  }
 
-  updateUniformBuffer(currentImage);
+  updateUniformBuffer(currentFrame);
+  vulkanCompute->beginFrame(currentFrame);
+  descriptorAllocator->beginFrame(currentFrame);
 
-  vkResetFences(vulkanDevice.logicalDevice, 1,
-                &vulkanSyncObject->inFlightFences[currentFrame]);
+  textureStreamer->update();
 
+  // The slot's previous submission finished, so all its pools can go
+  vulkanCommand->resetFrame(currentFrame);
+  auto recordStart = Clock::now();
   beginDrawingCommandBuffer(vulkanCommand->commandBuffers[currentFrame]);
 
-  PFN_vkCmdSetRasterizationSamplesEXT vkCmdSetRasterizationSamplesEXT = PFN_vkCmdSetRasterizationSamplesEXT(vkGetDeviceProcAddr(vulkanDevice.logicalDevice, "vkCmdSetRasterizationSamplesEXT"));
-  vkCmdSetRasterizationSamplesEXT(vulkanCommand->commandBuffers[currentFrame], VK_SAMPLE_COUNT_8_BIT);
-
-  beginRenderPass(vulkanCommand->commandBuffers[currentFrame], currentImage);
-
-  //  drawObjects(vulkanCommand->commandBuffers[currentFrame]);
-  // drawFromVertices(vulkanCommand->commandBuffers[currentFrame]);
-  // drawFromIndices(vulkanCommand->commandBuffers[currentFrame]);
-  drawFromDescriptors(vulkanCommand->commandBuffers[currentFrame],
-                      currentImage);
-    drawFromDescriptors(vulkanCommand->commandBuffers[currentFrame],
-                        currentImage);
+  // Reads back this slot's previous results before resetting its queries
+  vulkanProfiler->beginFrame(vulkanCommand->commandBuffers[currentFrame],
+                             currentFrame);
+  double gpuFrameMs = vulkanProfiler->getScopeMs("frame");
+  lastFrameStats.gpuValid = gpuFrameMs >= 0;
+  lastFrameStats.gpuMs = lastFrameStats.gpuValid ? gpuFrameMs : 0;
+
+  vulkanProfiler->beginScope(vulkanCommand->commandBuffers[currentFrame],
+                             "frame");
+
+  buildDrawList();
+  dispatchDrawArgs(currentFrame);
+
+  // Only vkCmdExecuteCommands may go inside the render pass now, so the
+  // profiler can't time individual batches anymore
+  vulkanProfiler->beginScope(vulkanCommand->commandBuffers[currentFrame],
+                             "render pass");
+  if (vulkanDevice.dynamicRendering) {
+    beginRendering(vulkanCommand->commandBuffers[currentFrame], currentImage);
+  } else {
+    beginRenderPass(vulkanCommand->commandBuffers[currentFrame],
+                    currentImage);
+  }
+  recordDrawList(vulkanCommand->commandBuffers[currentFrame], currentFrame,
+                 currentImage);
+  if (vulkanDevice.dynamicRendering) {
+    endRendering(vulkanCommand->commandBuffers[currentFrame], currentImage);
+  } else {
+    endRenderPass(vulkanCommand->commandBuffers[currentFrame]);
+  }
+  vulkanProfiler->endScope(vulkanCommand->commandBuffers[currentFrame]);
 
-  endRenderPass(vulkanCommand->commandBuffers[currentFrame]);
+  vulkanProfiler->endScope(vulkanCommand->commandBuffers[currentFrame]);
+  vulkanProfiler->endFrame();
 
-  // vkCmdWriteTimestamp(vulkanCommand->commandBuffers[currentFrame],
-  // VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 1);
+  // Uploads recorded since the last frame run ahead of the frame's own work,
+  // with a transfer queue the frame waits for their copies instead
+  VulkanUploader::FrameUploads uploads = vulkanUploader->endBatch();
+  if (uploads.waitSemaphore != VK_NULL_HANDLE) {
+    addFrameWaitSemaphore(uploads.waitSemaphore, uploads.waitValue,
+                          uploads.waitStages);
+  }
+  if (uploads.commandBuffer != VK_NULL_HANDLE) {
+    addFrameCommandBuffer(uploads.commandBuffer);
+  }
+  if (vulkanCompute->frameWaitValue != 0) {
+    addFrameWaitSemaphore(vulkanSyncObject->computeTimeline->semaphore,
+                          vulkanCompute->frameWaitValue,
+                          vulkanCompute->frameWaitStages);
+  }
 
+  endDrawingCommandBuffer(vulkanCommand->commandBuffers[currentFrame]);
+  lastFrameStats.recordMs = Milliseconds(Clock::now() - recordStart).count();
 
-  endDrawingCommandBuffer(
-      vulkanCommand->commandBuffers[currentFrame],
-      vulkanSyncObject->imageAvailableSemaphores[currentFrame],
-      vulkanSyncObject->renderFinishedSemaphores[currentFrame],
-      vulkanSyncObject->inFlightFences[currentFrame]);
+  auto submitStart = Clock::now();
+  submitFrame(imageAvailableSemaphore, renderFinishedSemaphore);
+  vulkanUploader->batchSubmitted(
+      vulkanSyncObject->frameTimelineValues[currentFrame]);
+  lastFrameStats.submitMs = Milliseconds(Clock::now() - submitStart).count();
 
   // Now present the image
-  VkSemaphore signalSemaphores[] = {
-      vulkanSyncObject->renderFinishedSemaphores[currentFrame]};
-
-  VkPresentInfoKHR presentInfo{};
-  presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-
-  presentInfo.waitSemaphoreCount = 1;
-  presentInfo.pWaitSemaphores = signalSemaphores;
-
-  VkSwapchainKHR swapChains[] = {vulkanSwapChain.swapChain};
-  presentInfo.swapchainCount = 1;
-  presentInfo.pSwapchains = swapChains;
-  presentInfo.pImageIndices = &currentImage;
-
-  presentInfo.pResults = nullptr; // Optional
-  result = vkQueuePresentKHR(vulkanDevice.presentQueue, &presentInfo);
-  if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
+  auto presentStart = Clock::now();
+  uint64_t presentId = usePresentWait ? ++lastPresentId : 0;
+  result = vulkanSwapChain.presentImage(vulkanDevice.presentQueue,
+                                        renderFinishedSemaphore, currentImage,
+                                        presentId);
+  lastFrameStats.presentMs = Milliseconds(Clock::now() - presentStart).count();
+
+  // A hidden window may never show its frames, keep only the newest
+  if (pendingLatencies.size() == MAX_PENDING_LATENCIES) {
+    pendingLatencies.pop_front();
+  }
+  pendingLatencies.push_back(
+      {presentId, vulkanSyncObject->frameTimelineValues[currentFrame],
+       inputSampleTime});
+  // A suboptimal swapchain still presents, so it waits like a resize
+  if (result == VK_SUBOPTIMAL_KHR && !framebufferResized) {
+    requestResize();
+  }
+  bool resizeSettled =
+      framebufferResized &&
+      Milliseconds(Clock::now() - lastResizeRequest).count() >=
+          RESIZE_SETTLE_MS;
+  if (result == VK_ERROR_OUT_OF_DATE_KHR || resizeSettled) {
     recreateSwapChain();
-  } else if (result != VK_SUCCESS) {
+  } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
     throw std::runtime_error("failed to present swap chain image!");
   }
 
-  currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+  currentFrame = (currentFrame + 1) % framesInFlight;
 }
 
-void VulkanRenderer::getQueryPoolTimes() {
+void VulkanRenderer::saveLastFrame(const std::string &filePath) {
+  if (!vulkanSwapChain.headless) {
+    std::cout << "Frame readback is only supported in headless mode\n";
+    return;
+  }
+  if (vulkanSyncObject->graphicsTimeline->submittedValue == 0) {
+    std::cout << "No frame rendered yet, nothing to save\n";
+    return;
+  }
+
+  // The last image is still being rendered to until the queue drains
+  vkDeviceWaitIdle(vulkanDevice.logicalDevice);
 
-  Utils::Query queries[2]{};
+  VkExtent2D extent = vulkanSwapChain.swapChainExtent;
+  VkDeviceSize imageSize =
+      static_cast<VkDeviceSize>(extent.width) * extent.height * 4;
 
-  const auto flags =
-      VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT;
+  VkBuffer readbackBuffer;
+  VulkanAllocation readbackBufferMemory = vulkanDevice.allocator->createBuffer(
+      imageSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+      readbackBuffer);
 
-  std::cout << "=======================================\n";
-  std::cout << "size of queries:" << sizeof(queries) << " bytes\n";
-  std::cout << "size of queries stride:" << sizeof(*queries) << " bytes\n";
+  VkCommandBuffer commandBuffer = Utils::beginSingleTimeCommands(
+      vulkanDevice.logicalDevice, vulkanCommand->commandPool);
 
-  vkGetQueryPoolResults(vulkanDevice.logicalDevice, queryPool, 0, 2,
-                        sizeof(queries), static_cast<void *>(&queries[0]),
-                        sizeof(*queries), flags);
+  VkBufferImageCopy region{};
+  region.bufferOffset = 0;
+  region.bufferRowLength = 0;
+  region.bufferImageHeight = 0;
 
-  std::cout << "query0 value: " << queries[0].value << "\n";
-  std::cout << "query0 avail: " << queries[0].availability << "\n";
+  region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  region.imageSubresource.mipLevel = 0;
+  region.imageSubresource.baseArrayLayer = 0;
+  region.imageSubresource.layerCount = 1;
 
-  std::cout << "query1 value: " << queries[1].value << "\n";
-  std::cout << "query1 avail: " << queries[1].availability << "\n";
+  region.imageOffset = {0, 0, 0};
+  region.imageExtent = {extent.width, extent.height, 1};
 
-  if (queries[0].availability == 1 && queries[1].availability == 1) {
-    uint64_t diff = queries[1].value - queries[0].value;
+  // The render pass already left the image in TRANSFER_SRC_OPTIMAL
+  vkCmdCopyImageToBuffer(commandBuffer,
+                         vulkanSwapChain.swapChainImages[currentImage],
+                         VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readbackBuffer,
+                         1, &region);
 
-    uint64_t diffNano = diff * vulkanDevice.deviceTimestampPeriod;
+  Utils::endSingleTimeCommands(vulkanDevice.logicalDevice,
+                               vulkanCommand->commandPool, commandBuffer,
+                               vulkanDevice.graphicsQueue);
 
-    std::cout << "diff : " << diff << "\n";
-    std::cout << "diff in nanos: " << diffNano << "\n";
+  Utils::writePPM(filePath,
+                  static_cast<const uint8_t *>(readbackBufferMemory.mapped),
+                  extent.width, extent.height);
 
-    float diffSeconds = diffNano / 1000000000.0;
-    std::cout << "diff in s: " << diffSeconds << "\n";
-  }
+  vulkanDevice.allocator->destroyBuffer(readbackBuffer, readbackBufferMemory);
 
-  std::cout << "=======================================\n";
+  std::cout << "Saved frame to " << filePath << "\n";
 }
 
-void VulkanRenderer::resetQueryPool() {
-  vkResetQueryPool(vulkanDevice.logicalDevice, queryPool, 0, 2);
-}
 } // namespace VulkanStuff
\ No newline at end of file
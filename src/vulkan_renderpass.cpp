@@ -3,9 +3,13 @@
 namespace VulkanStuff {
 VulkanRenderPass::VulkanRenderPass(VkPhysicalDevice inputPhysicalDevice,
                                    VkDevice inputDevice,
-                                   VkFormat inputSwapChainImageFormat)
+                                   VkSampleCountFlagBits inputMsaaSamples,
+                                   VkFormat inputSwapChainImageFormat,
+                                   VkImageLayout inputFinalLayout)
     : physicalDevice{inputPhysicalDevice}, device{inputDevice},
-      swapChainImageFormat{inputSwapChainImageFormat} {
+      msaaSamples{inputMsaaSamples},
+      swapChainImageFormat{inputSwapChainImageFormat},
+      finalLayout{inputFinalLayout} {
   createRenderPass();
 }
 VulkanRenderPass::~VulkanRenderPass() {
@@ -14,8 +18,6 @@ VulkanRenderPass::~VulkanRenderPass() {
 
 void VulkanRenderPass::createRenderPass() {
 
-  VkSampleCountFlagBits msaaSamples = VK_SAMPLE_COUNT_8_BIT;
-
   VkAttachmentDescription colorAttachment{};
   colorAttachment.format = swapChainImageFormat;
   colorAttachment.samples = msaaSamples;
@@ -32,11 +34,7 @@ void VulkanRenderPass::createRenderPass() {
 
   // Depth attachment
   VkAttachmentDescription depthAttachment{};
-  depthAttachment.format = Utils::findSupportedFormat(
-      physicalDevice,
-      {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT,
-       VK_FORMAT_D24_UNORM_S8_UINT},
-      VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
+  depthAttachment.format = Utils::findDepthFormat(physicalDevice);
 
   depthAttachment.samples = msaaSamples;
   depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
@@ -60,7 +58,8 @@ void VulkanRenderPass::createRenderPass() {
   colorAttachmentResolve.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
   colorAttachmentResolve.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
   colorAttachmentResolve.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-  colorAttachmentResolve.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+  // PRESENT_SRC for the swapchain, TRANSFER_SRC for headless readback
+  colorAttachmentResolve.finalLayout = finalLayout;
 
   VkAttachmentReference colorAttachmentResolveRef{};
   colorAttachmentResolveRef.attachment = 2;
@@ -80,11 +79,17 @@ void VulkanRenderPass::createRenderPass() {
   VkSubpassDependency dependency{};
   dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
   dependency.dstSubpass = 0;
+  // The MSAA color and depth attachments are shared by all frames in flight,
+  // so the previous frame's attachment writes have to finish before this
+  // frame's clear overwrites them
   dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
-                            VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-  dependency.srcAccessMask = 0;
+                            VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                            VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+  dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                             VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
   dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
-                            VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+                            VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                            VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
   dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
                              VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
 
@@ -5,17 +5,61 @@ namespace VulkanStuff {
 VulkanSwapChain::VulkanSwapChain(SDL_Window *sdlWindow,
                                  VkPhysicalDevice inputPhysicalDevice,
                                  VkDevice inputDevice,
-                                 VkSurfaceKHR inputSurface)
+                                 VkSurfaceKHR inputSurface,
+                                 VulkanAllocator *inputAllocator,
+                                 VkPresentModeKHR inputPresentMode,
+                                 uint32_t inputImageCount)
     : window{sdlWindow}, physicalDevice{inputPhysicalDevice},
-      device{inputDevice}, surface{inputSurface} {
+      device{inputDevice}, surface{inputSurface}, allocator{inputAllocator},
+      headless{inputSurface == VK_NULL_HANDLE},
+      requestedPresentMode{inputPresentMode},
+      requestedImageCount{inputImageCount} {
+  finalLayout = headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
+                         : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
   createSwapChain();
   createSwapChainImageViews();
 }
-VulkanSwapChain::~VulkanSwapChain() {
+VulkanSwapChain::~VulkanSwapChain() { cleanupSwapChain(); }
+
+void VulkanSwapChain::cleanupSwapChain() {
   for (auto imageView : swapChainImageViews) {
     vkDestroyImageView(device, imageView, nullptr);
   }
-  vkDestroySwapchainKHR(device, swapChain, nullptr);
+  swapChainImageViews.clear();
+
+  if (headless) {
+    for (size_t i = 0; i < swapChainImages.size(); i++) {
+      allocator->destroyImage(swapChainImages[i], offscreenImagesMemory[i]);
+    }
+    offscreenImagesMemory.clear();
+  } else {
+    vkDestroySwapchainKHR(device, swapChain, nullptr);
+    swapChain = VK_NULL_HANDLE;
+  }
+  swapChainImages.clear();
+}
+
+VulkanSwapChain::Retired VulkanSwapChain::recreateSwapChain() {
+  PROFILE_FUNCTION();
+  Retired retired;
+  retired.swapChain = swapChain;
+  retired.imageViews = swapChainImageViews;
+  swapChainImageViews.clear();
+  // Owned by the old swapchain, they go away with it
+  swapChainImages.clear();
+
+  createSwapChain();
+  createSwapChainImageViews();
+  return retired;
+}
+
+void VulkanSwapChain::destroyRetired(Retired &retired) {
+  for (auto imageView : retired.imageViews) {
+    vkDestroyImageView(device, imageView, nullptr);
+  }
+  retired.imageViews.clear();
+  vkDestroySwapchainKHR(device, retired.swapChain, nullptr);
+  retired.swapChain = VK_NULL_HANDLE;
 }
 
 VkSurfaceFormatKHR VulkanSwapChain::chooseSwapSurfaceFormat(
@@ -34,11 +78,13 @@ VkSurfaceFormatKHR VulkanSwapChain::chooseSwapSurfaceFormat(
 VkPresentModeKHR VulkanSwapChain::chooseSwapPresentMode(
     const std::vector<VkPresentModeKHR> &availablePresentModes) {
   for (const auto &availablePresentMode : availablePresentModes) {
-    if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
+    if (availablePresentMode == requestedPresentMode) {
       return availablePresentMode;
     }
   }
 
+  std::cout << Utils::presentModeName(requestedPresentMode)
+            << " is not supported by the surface, using FIFO\n";
   return VK_PRESENT_MODE_FIFO_KHR;
 }
 
@@ -73,23 +119,35 @@ VkExtent2D VulkanSwapChain::chooseSwapExtent(
 }
 
 void VulkanSwapChain::createSwapChain() {
+  PROFILE_FUNCTION();
+  if (headless) {
+    createOffscreenImages();
+    return;
+  }
+
   Utils::SwapChainSupportDetails swapChainSupport =
       Utils::querySwapChainSupport(physicalDevice, surface);
 
   VkSurfaceFormatKHR surfaceFormat =
       chooseSwapSurfaceFormat(swapChainSupport.formats);
-  VkPresentModeKHR presentMode =
-      chooseSwapPresentMode(swapChainSupport.presentModes);
+  presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
   VkExtent2D extent = chooseSwapExtent(swapChainSupport.capabilities);
 
-  // minimum + 1, and don't go over maximum
-  imageCount = swapChainSupport.capabilities.minImageCount + 1;
+  // minimum + 1 unless asked otherwise, and don't go over maximum. Fewer
+  // images means fewer frames queued for the screen
+  imageCount = requestedImageCount == 0
+                   ? swapChainSupport.capabilities.minImageCount + 1
+                   : requestedImageCount;
+  imageCount =
+      std::max(imageCount, swapChainSupport.capabilities.minImageCount);
   if (swapChainSupport.capabilities.maxImageCount > 0 &&
       imageCount > swapChainSupport.capabilities.maxImageCount) {
     imageCount = swapChainSupport.capabilities.maxImageCount;
   }
 
   std::cout << "SwapChain Image count: " << imageCount << "\n";
+  std::cout << "SwapChain present mode: " << Utils::presentModeName(presentMode)
+            << "\n";
   // VK_FORMAT_B8G8R8A8_SRGB = 50,
   std::cout << "SwapChain Image format: " << surfaceFormat.format << "\n";
 
@@ -135,12 +193,16 @@ void VulkanSwapChain::createSwapChain() {
   createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
   createInfo.presentMode = presentMode;
   createInfo.clipped = VK_TRUE;
-  createInfo.oldSwapchain = VK_NULL_HANDLE;
+  // Lets the driver reuse the retiring swapchain's resources, it stays
+  // valid until destroyed but can't acquire new images anymore
+  createInfo.oldSwapchain = swapChain;
 
-  if (vkCreateSwapchainKHR(device, &createInfo, nullptr, &swapChain) !=
+  VkSwapchainKHR newSwapChain;
+  if (vkCreateSwapchainKHR(device, &createInfo, nullptr, &newSwapChain) !=
       VK_SUCCESS) {
     throw std::runtime_error("failed to create swap chain!");
   }
+  swapChain = newSwapChain;
 
   vkGetSwapchainImagesKHR(device, swapChain, &imageCount, nullptr);
   swapChainImages.resize(imageCount);
@@ -150,6 +212,90 @@ void VulkanSwapChain::createSwapChain() {
   swapChainExtent = extent;
 }
 
+void VulkanSwapChain::createOffscreenImages() {
+  // Same format and size a desktop swapchain would usually pick, so headless
+  // numbers stay comparable
+  swapChainImageFormat = VK_FORMAT_B8G8R8A8_SRGB;
+  swapChainExtent = {static_cast<uint32_t>(Utils::WIDTH),
+                     static_cast<uint32_t>(Utils::HEIGHT)};
+  imageCount = HEADLESS_IMAGE_COUNT;
+  nextOffscreenImage = 0;
+
+  std::cout << "Headless image count: " << imageCount << "\n";
+
+  swapChainImages.resize(imageCount);
+  offscreenImagesMemory.resize(imageCount);
+
+  for (uint32_t i = 0; i < imageCount; i++) {
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent.width = swapChainExtent.width;
+    imageInfo.extent.height = swapChainExtent.height;
+    imageInfo.extent.depth = 1;
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = swapChainImageFormat;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    // Transfer source so the final frame can be read back
+    imageInfo.usage =
+        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+
+    // Full size render targets, dedicated like a swapchain's images
+    offscreenImagesMemory[i] = allocator->createImage(
+        imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, swapChainImages[i],
+        true);
+  }
+}
+
+VkResult VulkanSwapChain::acquireNextImage(VkSemaphore imageAvailableSemaphore,
+                                           uint32_t *imageIndex) {
+  PROFILE_FUNCTION();
+  if (headless) {
+    // The frame slot wait in drawFrame already guarantees the image is free
+    *imageIndex = nextOffscreenImage;
+    nextOffscreenImage = (nextOffscreenImage + 1) % imageCount;
+    return VK_SUCCESS;
+  }
+  return vkAcquireNextImageKHR(device, swapChain, UINT64_MAX,
+                               imageAvailableSemaphore, VK_NULL_HANDLE,
+                               imageIndex);
+}
+
+VkResult VulkanSwapChain::presentImage(VkQueue presentQueue,
+                                       VkSemaphore renderFinishedSemaphore,
+                                       uint32_t imageIndex,
+                                       uint64_t presentId) {
+  PROFILE_FUNCTION();
+  if (headless) {
+    return VK_SUCCESS;
+  }
+
+  VkPresentInfoKHR presentInfo{};
+  presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+
+  presentInfo.waitSemaphoreCount = 1;
+  presentInfo.pWaitSemaphores = &renderFinishedSemaphore;
+
+  presentInfo.swapchainCount = 1;
+  presentInfo.pSwapchains = &swapChain;
+  presentInfo.pImageIndices = &imageIndex;
+
+  presentInfo.pResults = nullptr; // Optional
+
+  VkPresentIdKHR presentIdInfo{};
+  presentIdInfo.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+  presentIdInfo.swapchainCount = 1;
+  presentIdInfo.pPresentIds = &presentId;
+  if (presentId != 0) {
+    presentInfo.pNext = &presentIdInfo;
+  }
+  return vkQueuePresentKHR(presentQueue, &presentInfo);
+}
+
 void VulkanSwapChain::createSwapChainImageViews() {
   swapChainImageViews.resize(swapChainImages.size());
 
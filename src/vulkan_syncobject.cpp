@@ -1,42 +1,124 @@
-
 #include <vulkan_syncobject.hpp>
 namespace VulkanStuff {
+VulkanTimeline::VulkanTimeline(VkDevice inputDevice) : device{inputDevice} {
+  VkSemaphoreTypeCreateInfo typeInfo{};
+  typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+  typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+  typeInfo.initialValue = 0;
+
+  VkSemaphoreCreateInfo semaphoreInfo{};
+  semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+  semaphoreInfo.pNext = &typeInfo;
+
+  if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &semaphore) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create timeline semaphore!");
+  }
+}
+
+VulkanTimeline::~VulkanTimeline() {
+  vkDestroySemaphore(device, semaphore, nullptr);
+}
+
+uint64_t VulkanTimeline::nextValue() { return ++submittedValue; }
+
+uint64_t VulkanTimeline::queryCompletedValue() {
+  uint64_t value = 0;
+  if (vkGetSemaphoreCounterValue(device, semaphore, &value) != VK_SUCCESS) {
+    throw std::runtime_error("failed to read timeline semaphore value!");
+  }
+  completedValue = value;
+  return completedValue;
+}
+
+bool VulkanTimeline::isComplete(uint64_t value) {
+  if (value <= completedValue) {
+    return true;
+  }
+  return queryCompletedValue() >= value;
+}
+
+void VulkanTimeline::wait(uint64_t value) {
+  if (isComplete(value)) {
+    return;
+  }
+  // Only the blocking path is interesting on a trace
+  PROFILE_ZONE("timeline wait");
+
+  VkSemaphoreWaitInfo waitInfo{};
+  waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+  waitInfo.semaphoreCount = 1;
+  waitInfo.pSemaphores = &semaphore;
+  waitInfo.pValues = &value;
+
+  if (vkWaitSemaphores(device, &waitInfo, UINT64_MAX) != VK_SUCCESS) {
+    throw std::runtime_error("failed to wait on timeline semaphore!");
+  }
+  completedValue = value;
+}
+
 VulkanSyncObject::VulkanSyncObject(VkDevice inputDevice, uint32_t number)
     : device{inputDevice} {
+  graphicsTimeline = new VulkanTimeline(device);
+  transferTimeline = new VulkanTimeline(device);
+  computeTimeline = new VulkanTimeline(device);
   createSyncObjects(number);
 }
 
 VulkanSyncObject::~VulkanSyncObject() {
-  for (size_t i = 0; i < imageAvailableSemaphores.size(); i++) {
-    vkDestroySemaphore(device, renderFinishedSemaphores[i], nullptr);
-    vkDestroySemaphore(device, imageAvailableSemaphores[i], nullptr);
-    vkDestroyFence(device, inFlightFences[i], nullptr);
+  cleanupSyncObjects();
+  for (VkSemaphore semaphore : retirePresentSemaphores()) {
+    vkDestroySemaphore(device, semaphore, nullptr);
   }
+  delete graphicsTimeline;
+  delete transferTimeline;
+  delete computeTimeline;
 }
 
 void VulkanSyncObject::createSyncObjects(uint32_t number) {
   imageAvailableSemaphores.resize(number);
-  renderFinishedSemaphores.resize(number);
-  inFlightFences.resize(number);
+  // 0 is already reached, so fresh frame slots never wait
+  frameTimelineValues.assign(number, 0);
 
   VkSemaphoreCreateInfo semaphoreInfo{};
   semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-  VkFenceCreateInfo fenceInfo{};
-  fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-  fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
   for (size_t i = 0; i < number; i++) {
     if (vkCreateSemaphore(device, &semaphoreInfo, nullptr,
-                          &imageAvailableSemaphores[i]) != VK_SUCCESS ||
-        vkCreateSemaphore(device, &semaphoreInfo, nullptr,
-                          &renderFinishedSemaphores[i]) != VK_SUCCESS ||
-        vkCreateFence(device, &fenceInfo, nullptr, &inFlightFences[i]) !=
-            VK_SUCCESS) {
+                          &imageAvailableSemaphores[i]) != VK_SUCCESS) {
 
       throw std::runtime_error(
           "failed to create synchronization objects for a frame!");
     }
   }
 }
-} // namespace VulkanStuff
\ No newline at end of file
+
+void VulkanSyncObject::createPresentSemaphores(uint32_t imageCount) {
+  renderFinishedSemaphores.resize(imageCount);
+
+  VkSemaphoreCreateInfo semaphoreInfo{};
+  semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+  for (size_t i = 0; i < imageCount; i++) {
+    if (vkCreateSemaphore(device, &semaphoreInfo, nullptr,
+                          &renderFinishedSemaphores[i]) != VK_SUCCESS) {
+      throw std::runtime_error(
+          "failed to create synchronization objects for an image!");
+    }
+  }
+}
+
+std::vector<VkSemaphore> VulkanSyncObject::retirePresentSemaphores() {
+  std::vector<VkSemaphore> retired;
+  retired.swap(renderFinishedSemaphores);
+  return retired;
+}
+
+void VulkanSyncObject::cleanupSyncObjects() {
+  for (size_t i = 0; i < imageAvailableSemaphores.size(); i++) {
+    vkDestroySemaphore(device, imageAvailableSemaphores[i], nullptr);
+  }
+  imageAvailableSemaphores.clear();
+  frameTimelineValues.clear();
+}
+} // namespace VulkanStuff
@@ -0,0 +1,302 @@
+#include <vulkan_texture_streamer.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+namespace VulkanStuff {
+
+VulkanTextureStreamer::VulkanTextureStreamer(
+    VkDevice inputDevice, VulkanAllocator *inputAllocator,
+    VulkanImage *inputVulkanImage, VulkanUploader *inputUploader,
+    Utils::JobSystem *inputJobSystem, VulkanTextureTable *inputTextureTable,
+    uint32_t inputMaxDecodesInFlight, VkDeviceSize inputUploadBudget)
+    : device{inputDevice}, allocator{inputAllocator},
+      vulkanImage{inputVulkanImage}, uploader{inputUploader},
+      jobSystem{inputJobSystem}, textureTable{inputTextureTable},
+      maxDecodesInFlight{std::max(inputMaxDecodesInFlight, 1u)},
+      uploadBudget{inputUploadBudget} {
+  gpuMips = vulkanImage->supportsLinearBlit(VK_FORMAT_A8B8G8R8_UNORM_PACK32);
+  createPlaceholder();
+}
+
+VulkanTextureStreamer::~VulkanTextureStreamer() {
+  // Decode jobs write into this object, let them finish first
+  jobSystem->wait(decodeCounter);
+
+  // The owner waits for the device to go idle first
+  for (StreamedTexture &texture : textures) {
+    if (texture.view != VK_NULL_HANDLE) {
+      vkDestroyImageView(device, texture.view, nullptr);
+    }
+    if (texture.image != VK_NULL_HANDLE) {
+      allocator->destroyImage(texture.image, texture.memory);
+    }
+  }
+  vkDestroyImageView(device, placeholderView, nullptr);
+  allocator->destroyImage(placeholderImage, placeholderMemory);
+}
+
+void VulkanTextureStreamer::createPlaceholder() {
+  const uint32_t size = 8;
+  std::vector<uint8_t> pixels(size * size * 4);
+  for (uint32_t y = 0; y < size; y++) {
+    for (uint32_t x = 0; x < size; x++) {
+      uint8_t shade = ((x / 2 + y / 2) % 2) ? 96 : 160;
+      uint8_t *pixel = &pixels[(y * size + x) * 4];
+      pixel[0] = shade;
+      pixel[1] = shade;
+      pixel[2] = shade;
+      pixel[3] = 255;
+    }
+  }
+
+  vulkanImage->createImage(
+      size, size, 1, VK_FORMAT_A8B8G8R8_UNORM_PACK32, VK_IMAGE_TILING_OPTIMAL,
+      VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, placeholderImage, placeholderMemory,
+      false, VK_SAMPLE_COUNT_1_BIT);
+  uploader->uploadImage(placeholderImage, VK_FORMAT_A8B8G8R8_UNORM_PACK32, size,
+                        size, pixels.data(), pixels.size());
+  placeholderView =
+      Utils::createImageView(device, placeholderImage, VK_FORMAT_R8G8B8A8_SRGB,
+                             VK_IMAGE_ASPECT_COLOR_BIT);
+  placeholderIndex = textureTable->add(placeholderView);
+}
+
+TextureHandle VulkanTextureStreamer::request(const std::string &path,
+                                             int32_t priority) {
+  TextureHandle handle = static_cast<TextureHandle>(textures.size());
+  StreamedTexture texture;
+  texture.path = path;
+  texture.priority = priority;
+  textures.push_back(texture);
+
+  requestQueue.push(LoadRequest{priority, requestSequence++, handle});
+  return handle;
+}
+
+void VulkanTextureStreamer::setPriority(TextureHandle handle,
+                                        int32_t priority) {
+  StreamedTexture &texture = textures[handle];
+  if (texture.state != TextureState::Queued || texture.priority == priority) {
+    return;
+  }
+  // The old entry stays in the queue and is skipped once it comes up
+  texture.priority = priority;
+  requestQueue.push(LoadRequest{priority, requestSequence++, handle});
+}
+
+bool VulkanTextureStreamer::isResident(TextureHandle handle) const {
+  return textures[handle].state == TextureState::Resident;
+}
+
+VkImageView VulkanTextureStreamer::getImageView(TextureHandle handle) const {
+  return isResident(handle) ? textures[handle].view : placeholderView;
+}
+
+uint32_t VulkanTextureStreamer::getTextureIndex(TextureHandle handle) const {
+  return isResident(handle) ? textures[handle].textureIndex : placeholderIndex;
+}
+
+void VulkanTextureStreamer::startDecode(TextureHandle handle) {
+  textures[handle].state = TextureState::Decoding;
+  decodesInFlight++;
+
+  // Decode jobs only see their own copy of the path, textures may grow
+  // while they run
+  std::string path = textures[handle].path;
+  bool buildMips = !gpuMips;
+  jobSystem->run(decodeCounter, [this, handle, path, buildMips] {
+    PROFILE_ZONE("decode texture");
+    DecodedTexture decoded{};
+    decoded.handle = handle;
+    if (Utils::isKtx2Path(path)) {
+      decodeKtx2(path, decoded);
+    } else {
+      decodeImage(path, buildMips, decoded);
+    }
+
+    std::lock_guard<std::mutex> lock(decodedMutex);
+    decodedTextures.push_back(std::move(decoded));
+  });
+}
+
+void VulkanTextureStreamer::decodeImage(const std::string &path,
+                                        bool buildMips,
+                                        DecodedTexture &decoded) {
+  int texWidth, texHeight, texChannels;
+  stbi_uc *pixels = stbi_load(path.c_str(), &texWidth, &texHeight,
+                              &texChannels, STBI_rgb_alpha);
+  if (pixels == nullptr) {
+    return;
+  }
+
+  decoded.width = static_cast<uint32_t>(texWidth);
+  decoded.height = static_cast<uint32_t>(texHeight);
+  decoded.mipLevels = Utils::mipLevelCount(decoded.width, decoded.height);
+  decoded.decodedLevels = buildMips ? decoded.mipLevels : 1;
+  decoded.format = VK_FORMAT_A8B8G8R8_UNORM_PACK32;
+  decoded.viewFormat = VK_FORMAT_R8G8B8A8_SRGB;
+
+  // Room for the whole chain, level 0 goes first
+  size_t baseSize = static_cast<size_t>(decoded.width) * decoded.height * 4;
+  decoded.pixels.resize(static_cast<size_t>(Utils::mipChainSize(
+      decoded.width, decoded.height, decoded.decodedLevels)));
+  memcpy(decoded.pixels.data(), pixels, baseSize);
+  stbi_image_free(pixels);
+
+  if (buildMips) {
+    PROFILE_ZONE("build mip chain");
+    Utils::generateMipChainRGBA8(decoded.pixels.data(), decoded.width,
+                                 decoded.height, decoded.mipLevels);
+  }
+}
+
+void VulkanTextureStreamer::decodeKtx2(const std::string &path,
+                                       DecodedTexture &decoded) {
+  Utils::Ktx2Texture ktx;
+  try {
+    ktx = Utils::loadKtx2(path);
+  } catch (const std::exception &e) {
+    decoded.error = e.what();
+    return;
+  }
+
+  decoded.width = ktx.width;
+  decoded.height = ktx.height;
+  decoded.mipLevels = ktx.mipLevels;
+  decoded.decodedLevels = ktx.mipLevels;
+
+  // Format properties are safe to query from any thread
+  if (vulkanImage->supportsSampling(ktx.format)) {
+    decoded.format = ktx.format;
+    decoded.viewFormat = ktx.format;
+    decoded.pixels = std::move(ktx.data);
+    return;
+  }
+  if (!Utils::canDecodeToRGBA8(ktx.format)) {
+    decoded.error = "the device can't sample its format";
+    return;
+  }
+
+  // Four to eight times the memory, but it shows up
+  PROFILE_ZONE("transcode texture");
+  decoded.format = VK_FORMAT_A8B8G8R8_UNORM_PACK32;
+  decoded.viewFormat = Utils::isSrgbFormat(ktx.format)
+                           ? VK_FORMAT_R8G8B8A8_SRGB
+                           : VK_FORMAT_R8G8B8A8_UNORM;
+  decoded.pixels.resize(static_cast<size_t>(
+      Utils::mipChainSize(ktx.width, ktx.height, ktx.mipLevels)));
+  size_t offset = 0;
+  for (uint32_t level = 0; level < ktx.mipLevels; level++) {
+    uint32_t levelWidth = std::max(ktx.width >> level, 1u);
+    uint32_t levelHeight = std::max(ktx.height >> level, 1u);
+    Utils::decodeToRGBA8(ktx.format, ktx.data.data() + ktx.levelOffsets[level],
+                         levelWidth, levelHeight,
+                         decoded.pixels.data() + offset);
+    offset += static_cast<size_t>(levelWidth) * levelHeight * 4;
+  }
+}
+
+void VulkanTextureStreamer::uploadTexture(const DecodedTexture &decoded) {
+  StreamedTexture &texture = textures[decoded.handle];
+  decodesInFlight--;
+
+  if (decoded.pixels.empty()) {
+    texture.state = TextureState::Failed;
+    std::cout << "Failed to load texture " << texture.path;
+    if (!decoded.error.empty()) {
+      std::cout << ", " << decoded.error;
+    }
+    std::cout << "\n";
+    return;
+  }
+
+  texture.width = decoded.width;
+  texture.height = decoded.height;
+  texture.mipLevels = decoded.mipLevels;
+  texture.format = decoded.format;
+  VkDeviceSize imageSize = decoded.pixels.size();
+  bool blitMips = decoded.decodedLevels < texture.mipLevels;
+
+  VkImageUsageFlags usage =
+      VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+  if (blitMips) {
+    usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+  }
+  vulkanImage->createImage(texture.width, texture.height, texture.mipLevels,
+                           texture.format, VK_IMAGE_TILING_OPTIMAL, usage,
+                           VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, texture.image,
+                           texture.memory, false, VK_SAMPLE_COUNT_1_BIT);
+
+  // Pixels are copied into the staging ring right away, the copy and both
+  // layout transitions go out with the next upload batch
+  uploader->uploadImage(texture.image, texture.format, texture.width,
+                        texture.height, decoded.pixels.data(), imageSize,
+                        texture.mipLevels, decoded.decodedLevels);
+  if (blitMips) {
+    // Recorded on the graphics side of the same batch, after the upload is
+    // visible there
+    vulkanImage->generateMipmaps(texture.image, texture.width, texture.height,
+                                 texture.mipLevels);
+  }
+
+  texture.view = Utils::createImageView(device, texture.image,
+                                        decoded.viewFormat,
+                                        VK_IMAGE_ASPECT_COLOR_BIT,
+                                        texture.mipLevels);
+  // Only frames recorded from now on can pick the slot, so none of the
+  // pending ones reads it while it's written
+  texture.textureIndex = textureTable->add(texture.view);
+  texture.state = TextureState::Resident;
+
+  residentCount++;
+  streamedBytes += imageSize;
+}
+
+void VulkanTextureStreamer::update() {
+  PROFILE_FUNCTION();
+  {
+    std::lock_guard<std::mutex> lock(decodedMutex);
+    readyTextures.insert(readyTextures.end(),
+                         std::make_move_iterator(decodedTextures.begin()),
+                         std::make_move_iterator(decodedTextures.end()));
+    decodedTextures.clear();
+  }
+
+  // Highest priority uploads first, the budget may cut off the rest
+  std::stable_sort(readyTextures.begin(), readyTextures.end(),
+                   [&](const DecodedTexture &a, const DecodedTexture &b) {
+                     return textures[a.handle].priority >
+                            textures[b.handle].priority;
+                   });
+
+  VkDeviceSize spent = 0;
+  size_t uploaded = 0;
+  while (uploaded < readyTextures.size()) {
+    const DecodedTexture &decoded = readyTextures[uploaded];
+    VkDeviceSize imageSize = decoded.pixels.size();
+    if (uploaded > 0 && spent + imageSize > uploadBudget) {
+      break;
+    }
+    uploadTexture(decoded);
+    spent += imageSize;
+    uploaded++;
+  }
+  readyTextures.erase(readyTextures.begin(),
+                      readyTextures.begin() + uploaded);
+
+  while (decodesInFlight < maxDecodesInFlight && !requestQueue.empty()) {
+    LoadRequest request = requestQueue.top();
+    requestQueue.pop();
+
+    // Left behind by setPriority
+    const StreamedTexture &texture = textures[request.handle];
+    if (texture.state != TextureState::Queued ||
+        texture.priority != request.priority) {
+      continue;
+    }
+    startDecode(request.handle);
+  }
+}
+} // namespace VulkanStuff
@@ -0,0 +1,119 @@
+#include <vulkan_texture_table.hpp>
+
+namespace VulkanStuff {
+VulkanTextureTable::VulkanTextureTable(VkPhysicalDevice inputPhysicalDevice,
+                                       VkDevice inputDevice,
+                                       VkSampler inputSampler)
+    : physicalDevice{inputPhysicalDevice}, device{inputDevice},
+      sampler{inputSampler} {
+  // Update after bind descriptors count against limits of their own
+  VkPhysicalDeviceDescriptorIndexingProperties indexingProperties{};
+  indexingProperties.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+
+  VkPhysicalDeviceProperties2 properties2{};
+  properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+  properties2.pNext = &indexingProperties;
+  vkGetPhysicalDeviceProperties2(physicalDevice, &properties2);
+
+  if (indexingProperties.maxPerStageDescriptorUpdateAfterBindSamplers <
+          MAX_TEXTURES ||
+      indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages <
+          MAX_TEXTURES ||
+      indexingProperties.maxDescriptorSetUpdateAfterBindSamplers <
+          MAX_TEXTURES ||
+      indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages <
+          MAX_TEXTURES) {
+    throw std::runtime_error("texture table is larger than the device allows!");
+  }
+
+  VkDescriptorSetLayoutBinding textureBinding{};
+  textureBinding.binding = 0;
+  textureBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  textureBinding.descriptorCount = MAX_TEXTURES;
+  textureBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+  textureBinding.pImmutableSamplers = nullptr;
+
+  // Slots nobody wrote yet are fine as long as no draw indexes them
+  VkDescriptorBindingFlags bindingFlags =
+      VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+      VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+      VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+
+  VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+  bindingFlagsInfo.sType =
+      VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+  bindingFlagsInfo.bindingCount = 1;
+  bindingFlagsInfo.pBindingFlags = &bindingFlags;
+
+  VkDescriptorSetLayoutCreateInfo layoutInfo{};
+  layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layoutInfo.pNext = &bindingFlagsInfo;
+  layoutInfo.flags =
+      VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+  layoutInfo.bindingCount = 1;
+  layoutInfo.pBindings = &textureBinding;
+
+  if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr,
+                                  &descriptorSetLayout) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create texture table layout!");
+  }
+
+  VkDescriptorPoolSize poolSize{};
+  poolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  poolSize.descriptorCount = MAX_TEXTURES;
+
+  VkDescriptorPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+  poolInfo.poolSizeCount = 1;
+  poolInfo.pPoolSizes = &poolSize;
+  poolInfo.maxSets = 1;
+
+  if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create texture table pool!");
+  }
+
+  VkDescriptorSetAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocInfo.descriptorPool = descriptorPool;
+  allocInfo.descriptorSetCount = 1;
+  allocInfo.pSetLayouts = &descriptorSetLayout;
+
+  if (vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to allocate texture table!");
+  }
+}
+
+VulkanTextureTable::~VulkanTextureTable() {
+  // The set goes with its pool
+  vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+  vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+}
+
+uint32_t VulkanTextureTable::add(VkImageView imageView) {
+  if (slotCount == MAX_TEXTURES) {
+    throw std::runtime_error("texture table is full!");
+  }
+  uint32_t slot = slotCount++;
+
+  VkDescriptorImageInfo imageInfo{};
+  imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  imageInfo.imageView = imageView;
+  imageInfo.sampler = sampler;
+
+  VkWriteDescriptorSet descriptorWrite{};
+  descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  descriptorWrite.dstSet = descriptorSet;
+  descriptorWrite.dstBinding = 0;
+  descriptorWrite.dstArrayElement = slot;
+  descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  descriptorWrite.descriptorCount = 1;
+  descriptorWrite.pImageInfo = &imageInfo;
+
+  vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
+  return slot;
+}
+} // namespace VulkanStuff
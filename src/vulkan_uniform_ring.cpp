@@ -0,0 +1,46 @@
+#include <vulkan_uniform_ring.hpp>
+
+namespace VulkanStuff {
+VulkanUniformRing::VulkanUniformRing(VkPhysicalDevice inputPhysicalDevice,
+                                     VkDevice inputDevice,
+                                     VulkanAllocator *inputAllocator,
+                                     uint32_t inputRegionCount,
+                                     VkDeviceSize bytesPerRegion)
+    : physicalDevice{inputPhysicalDevice}, device{inputDevice},
+      allocator{inputAllocator}, regionCount{inputRegionCount} {
+  VkPhysicalDeviceProperties deviceProperties;
+  vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+  alignment = std::max<VkDeviceSize>(
+      deviceProperties.limits.minUniformBufferOffsetAlignment, 16);
+
+  // Regions start aligned, so every aligned allocation inside one is too
+  regionSize = alignUp(bytesPerRegion);
+
+  bufferMemory = allocator->createBuffer(
+      regionSize * regionCount, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+      buffer);
+  mapped = static_cast<uint8_t *>(bufferMemory.mapped);
+}
+
+VulkanUniformRing::~VulkanUniformRing() {
+  allocator->destroyBuffer(buffer, bufferMemory);
+}
+
+void VulkanUniformRing::beginFrame(uint32_t frameIndex) {
+  currentRegion = frameIndex;
+  head.store(0, std::memory_order_relaxed);
+}
+
+VulkanUniformRing::Allocation VulkanUniformRing::allocate(VkDeviceSize size) {
+  VkDeviceSize alignedSize = alignUp(size);
+  VkDeviceSize offset = head.fetch_add(alignedSize, std::memory_order_relaxed);
+  if (offset + alignedSize > regionSize) {
+    throw std::runtime_error("uniform ring region is full!");
+  }
+
+  VkDeviceSize bufferOffset = currentRegion * regionSize + offset;
+  return {static_cast<uint32_t>(bufferOffset), mapped + bufferOffset};
+}
+} // namespace VulkanStuff
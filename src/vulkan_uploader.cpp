@@ -0,0 +1,495 @@
+#include <vulkan_uploader.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+#include <texture_formats.hpp>
+
+namespace VulkanStuff {
+
+// Covers the offset rules of both buffer copies (none) and buffer to image
+// copies (multiple of 4 and of the texel block size, 16 for BC7)
+static constexpr VkDeviceSize STAGING_ALIGNMENT = 16;
+
+// One pool per command buffer, so a batch resets with a single call
+static void createBatchCommandBuffer(VkDevice device, uint32_t queueFamily,
+                                     VkCommandPool &commandPool,
+                                     VkCommandBuffer &commandBuffer) {
+  VkCommandPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+  poolInfo.queueFamilyIndex = queueFamily;
+  if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create upload command pool!");
+  }
+
+  VkCommandBufferAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  allocInfo.commandPool = commandPool;
+  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocInfo.commandBufferCount = 1;
+  if (vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to allocate upload command buffer!");
+  }
+}
+
+VulkanUploader::VulkanUploader(VkDevice inputDevice, VkQueue inputGraphicsQueue,
+                               uint32_t inputGraphicsFamily,
+                               VkQueue inputTransferQueue,
+                               uint32_t inputTransferFamily,
+                               VulkanAllocator *inputAllocator,
+                               VulkanTimeline *inputGraphicsTimeline,
+                               VulkanTimeline *inputTransferTimeline,
+                               VkDeviceSize inputStagingSize)
+    : device{inputDevice}, graphicsQueue{inputGraphicsQueue},
+      graphicsFamily{inputGraphicsFamily}, transferQueue{inputTransferQueue},
+      transferFamily{inputTransferFamily}, allocator{inputAllocator},
+      graphicsTimeline{inputGraphicsTimeline},
+      transferTimeline{inputTransferTimeline},
+      separateQueue{inputTransferQueue != inputGraphicsQueue},
+      stagingSize{inputStagingSize} {
+  stagingMemory = allocator->createBuffer(
+      stagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+      stagingBuffer);
+}
+
+VulkanUploader::~VulkanUploader() {
+  // The owner waits for the device to go idle first, so every batch is done
+  // and one that was never submitted can simply be dropped
+  if (currentBatch != nullptr) {
+    inFlightBatches.push_back(currentBatch);
+  }
+  if (closedBatch != nullptr) {
+    inFlightBatches.push_back(closedBatch);
+  }
+  for (Batch *batch : inFlightBatches) {
+    freeBatches.push_back(batch);
+  }
+  for (Batch *batch : freeBatches) {
+    for (size_t i = 0; i < batch->tempBuffers.size(); i++) {
+      allocator->destroyBuffer(batch->tempBuffers[i], batch->tempMemory[i]);
+    }
+    vkDestroyCommandPool(device, batch->commandPool, nullptr);
+    if (batch->transferCommandPool != VK_NULL_HANDLE) {
+      vkDestroyCommandPool(device, batch->transferCommandPool, nullptr);
+    }
+    delete batch;
+  }
+  allocator->destroyBuffer(stagingBuffer, stagingMemory);
+}
+
+VulkanUploader::Batch *VulkanUploader::beginBatch() {
+  if (currentBatch != nullptr) {
+    return currentBatch;
+  }
+
+  retireBatches();
+  Batch *batch;
+  if (!freeBatches.empty()) {
+    batch = freeBatches.back();
+    freeBatches.pop_back();
+  } else {
+    batch = new Batch();
+    createBatchCommandBuffer(device, graphicsFamily, batch->commandPool,
+                             batch->commandBuffer);
+    if (separateQueue) {
+      createBatchCommandBuffer(device, transferFamily,
+                               batch->transferCommandPool,
+                               batch->transferCommandBuffer);
+    } else {
+      batch->transferCommandBuffer = batch->commandBuffer;
+    }
+  }
+
+  VkCommandBufferBeginInfo beginInfo{};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  vkBeginCommandBuffer(batch->commandBuffer, &beginInfo);
+  if (separateQueue) {
+    vkBeginCommandBuffer(batch->transferCommandBuffer, &beginInfo);
+  }
+
+  batch->hasCopies = false;
+  batch->stagingStart = stagingHead;
+  currentBatch = batch;
+  return batch;
+}
+
+void VulkanUploader::emitVisibleBarriers(Batch *batch) {
+  if (!visibleBufferBarriers.empty() || !visibleImageBarriers.empty()) {
+    // Across queues the semaphore wait at the consumer stages already
+    // ordered the copies, the acquire only has to chain onto it
+    VkPipelineStageFlags srcStage =
+        separateQueue ? visibleStages : VK_PIPELINE_STAGE_TRANSFER_BIT;
+    vkCmdPipelineBarrier(
+        batch->commandBuffer, srcStage, visibleStages, 0, 0, nullptr,
+        static_cast<uint32_t>(visibleBufferBarriers.size()),
+        visibleBufferBarriers.data(),
+        static_cast<uint32_t>(visibleImageBarriers.size()),
+        visibleImageBarriers.data());
+  }
+  visibleBufferBarriers.clear();
+  visibleImageBarriers.clear();
+  visibleStages = 0;
+}
+
+VulkanUploader::FrameUploads VulkanUploader::closeBatch(Batch *batch) {
+  FrameUploads uploads;
+
+  if (separateQueue) {
+    if (!releaseBufferBarriers.empty() || !releaseImageBarriers.empty()) {
+      vkCmdPipelineBarrier(
+          batch->transferCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+          VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr,
+          static_cast<uint32_t>(releaseBufferBarriers.size()),
+          releaseBufferBarriers.data(),
+          static_cast<uint32_t>(releaseImageBarriers.size()),
+          releaseImageBarriers.data());
+    }
+    releaseBufferBarriers.clear();
+    releaseImageBarriers.clear();
+
+    if (vkEndCommandBuffer(batch->transferCommandBuffer) != VK_SUCCESS) {
+      throw std::runtime_error("failed to record upload command buffer!");
+    }
+
+    if (batch->hasCopies) {
+      uint64_t transferValue = transferTimeline->nextValue();
+
+      VkCommandBufferSubmitInfoKHR commandBufferInfo{};
+      commandBufferInfo.sType =
+          VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO_KHR;
+      commandBufferInfo.commandBuffer = batch->transferCommandBuffer;
+
+      VkSemaphoreSubmitInfoKHR signalInfo{};
+      signalInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO_KHR;
+      signalInfo.semaphore = transferTimeline->semaphore;
+      signalInfo.value = transferValue;
+      signalInfo.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT_KHR;
+
+      VkSubmitInfo2KHR submitInfo{};
+      submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2_KHR;
+      submitInfo.commandBufferInfoCount = 1;
+      submitInfo.pCommandBufferInfos = &commandBufferInfo;
+      submitInfo.signalSemaphoreInfoCount = 1;
+      submitInfo.pSignalSemaphoreInfos = &signalInfo;
+
+      if (vkQueueSubmit2KHR(transferQueue, 1, &submitInfo, VK_NULL_HANDLE) !=
+          VK_SUCCESS) {
+        throw std::runtime_error("failed to submit upload copies!");
+      }
+
+      uploads.waitSemaphore = transferTimeline->semaphore;
+      uploads.waitValue = transferValue;
+      // The legacy stage bits have the same values in synchronization2
+      uploads.waitStages = static_cast<VkPipelineStageFlags2KHR>(consumerStages);
+    }
+  }
+  consumerStages = 0;
+
+  emitVisibleBarriers(batch);
+  if (vkEndCommandBuffer(batch->commandBuffer) != VK_SUCCESS) {
+    throw std::runtime_error("failed to record upload command buffer!");
+  }
+  uploads.commandBuffer = batch->commandBuffer;
+
+  batch->stagingEnd = stagingHead;
+  submittedBatches++;
+  return uploads;
+}
+
+VulkanUploader::FrameUploads VulkanUploader::endBatch() {
+  if (currentBatch == nullptr) {
+    return FrameUploads{};
+  }
+  FrameUploads uploads = closeBatch(currentBatch);
+  closedBatch = currentBatch;
+  currentBatch = nullptr;
+  return uploads;
+}
+
+void VulkanUploader::batchSubmitted(uint64_t timelineValue) {
+  if (closedBatch == nullptr) {
+    return;
+  }
+  closedBatch->timelineValue = timelineValue;
+  inFlightBatches.push_back(closedBatch);
+  closedBatch = nullptr;
+}
+
+uint64_t VulkanUploader::flush() {
+  if (currentBatch == nullptr) {
+    return graphicsTimeline->submittedValue;
+  }
+  Batch *batch = currentBatch;
+  currentBatch = nullptr;
+  FrameUploads uploads = closeBatch(batch);
+
+  batch->timelineValue = graphicsTimeline->nextValue();
+
+  VkCommandBufferSubmitInfoKHR commandBufferInfo{};
+  commandBufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO_KHR;
+  commandBufferInfo.commandBuffer = uploads.commandBuffer;
+
+  VkSemaphoreSubmitInfoKHR waitInfo{};
+  waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO_KHR;
+  waitInfo.semaphore = uploads.waitSemaphore;
+  waitInfo.value = uploads.waitValue;
+  waitInfo.stageMask = uploads.waitStages;
+
+  VkSemaphoreSubmitInfoKHR signalInfo{};
+  signalInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO_KHR;
+  signalInfo.semaphore = graphicsTimeline->semaphore;
+  signalInfo.value = batch->timelineValue;
+  signalInfo.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT_KHR;
+
+  VkSubmitInfo2KHR submitInfo{};
+  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2_KHR;
+  if (uploads.waitSemaphore != VK_NULL_HANDLE) {
+    submitInfo.waitSemaphoreInfoCount = 1;
+    submitInfo.pWaitSemaphoreInfos = &waitInfo;
+  }
+  submitInfo.commandBufferInfoCount = 1;
+  submitInfo.pCommandBufferInfos = &commandBufferInfo;
+  submitInfo.signalSemaphoreInfoCount = 1;
+  submitInfo.pSignalSemaphoreInfos = &signalInfo;
+
+  if (vkQueueSubmit2KHR(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to submit upload batch!");
+  }
+  inFlightBatches.push_back(batch);
+  return batch->timelineValue;
+}
+
+void VulkanUploader::retireBatches() {
+  while (!inFlightBatches.empty() &&
+         graphicsTimeline->isComplete(inFlightBatches.front()->timelineValue)) {
+    Batch *batch = inFlightBatches.front();
+    inFlightBatches.pop_front();
+
+    stagingTail = batch->stagingEnd;
+    for (size_t i = 0; i < batch->tempBuffers.size(); i++) {
+      allocator->destroyBuffer(batch->tempBuffers[i], batch->tempMemory[i]);
+    }
+    batch->tempBuffers.clear();
+    batch->tempMemory.clear();
+    vkResetCommandPool(device, batch->commandPool, 0);
+    if (batch->transferCommandPool != VK_NULL_HANDLE) {
+      vkResetCommandPool(device, batch->transferCommandPool, 0);
+    }
+    freeBatches.push_back(batch);
+  }
+  // Nothing left on the GPU, so the ring is empty
+  if (inFlightBatches.empty() && closedBatch == nullptr &&
+      currentBatch == nullptr) {
+    stagingTail = stagingHead;
+  }
+}
+
+void VulkanUploader::addHandoff(VkBufferMemoryBarrier *bufferBarrier,
+                                VkImageMemoryBarrier *imageBarrier,
+                                VkPipelineStageFlags dstStage,
+                                VkAccessFlags dstAccess) {
+  consumerStages |= dstStage;
+
+  if (!separateQueue) {
+    // One queue, a plain barrier after the copies does it
+    if (bufferBarrier != nullptr) {
+      bufferBarrier->dstAccessMask = dstAccess;
+      visibleBufferBarriers.push_back(*bufferBarrier);
+    }
+    if (imageBarrier != nullptr) {
+      imageBarrier->dstAccessMask = dstAccess;
+      visibleImageBarriers.push_back(*imageBarrier);
+    }
+    visibleStages |= dstStage;
+    return;
+  }
+
+  // Released at the end of the copies. Waiting on the transfer timeline
+  // already makes the writes visible, so the graphics queue only has to
+  // acquire when the resource changes queue family
+  bool ownershipTransfer = transferFamily != graphicsFamily;
+  uint32_t srcFamily =
+      ownershipTransfer ? transferFamily : VK_QUEUE_FAMILY_IGNORED;
+  uint32_t dstFamily =
+      ownershipTransfer ? graphicsFamily : VK_QUEUE_FAMILY_IGNORED;
+
+  if (bufferBarrier != nullptr) {
+    bufferBarrier->srcQueueFamilyIndex = srcFamily;
+    bufferBarrier->dstQueueFamilyIndex = dstFamily;
+    bufferBarrier->dstAccessMask = 0;
+    releaseBufferBarriers.push_back(*bufferBarrier);
+    if (ownershipTransfer) {
+      bufferBarrier->srcAccessMask = 0;
+      bufferBarrier->dstAccessMask = dstAccess;
+      visibleBufferBarriers.push_back(*bufferBarrier);
+    }
+  }
+  if (imageBarrier != nullptr) {
+    imageBarrier->srcQueueFamilyIndex = srcFamily;
+    imageBarrier->dstQueueFamilyIndex = dstFamily;
+    imageBarrier->dstAccessMask = 0;
+    releaseImageBarriers.push_back(*imageBarrier);
+    if (ownershipTransfer) {
+      imageBarrier->srcAccessMask = 0;
+      imageBarrier->dstAccessMask = dstAccess;
+      visibleImageBarriers.push_back(*imageBarrier);
+    }
+  }
+  if (ownershipTransfer) {
+    visibleStages |= dstStage;
+  }
+}
+
+void *VulkanUploader::allocateStaging(VkDeviceSize size,
+                                      VkDeviceSize alignment, VkBuffer &buffer,
+                                      VkDeviceSize &offset) {
+  Batch *batch = beginBatch();
+  batch->hasCopies = true;
+
+  if (size > stagingSize / 2) {
+    VkBuffer tempBuffer;
+    VulkanAllocation tempMemory = allocator->createBuffer(
+        size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        tempBuffer);
+    batch->tempBuffers.push_back(tempBuffer);
+    batch->tempMemory.push_back(tempMemory);
+    buffer = tempBuffer;
+    offset = 0;
+    return tempMemory.mapped;
+  }
+
+  while (true) {
+    uint64_t start = (stagingHead + alignment - 1) & ~(alignment - 1);
+    // Never let an allocation wrap around the end of the ring
+    if (start % stagingSize + size > stagingSize) {
+      start = (start / stagingSize + 1) * stagingSize;
+    }
+    if (start + size - stagingTail <= stagingSize) {
+      stagingHead = start + size;
+      buffer = stagingBuffer;
+      offset = start % stagingSize;
+      return static_cast<uint8_t *>(stagingMemory.mapped) + offset;
+    }
+
+    // Full. Wait for the oldest batch to finish, or if it is this batch
+    // that filled the ring, send it off first
+    PROFILE_ZONE("staging ring full");
+    if (inFlightBatches.empty()) {
+      if (stagingHead == batch->stagingStart) {
+        // Held by a batch handed to the frame but not submitted yet
+        throw std::runtime_error("staging ring exhausted!");
+      }
+      flush();
+      batch = beginBatch();
+      batch->hasCopies = true;
+    }
+    graphicsTimeline->wait(inFlightBatches.front()->timelineValue);
+    retireBatches();
+  }
+}
+
+void VulkanUploader::uploadBuffer(VkBuffer dst, VkDeviceSize dstOffset,
+                                  const void *data, VkDeviceSize size,
+                                  VkPipelineStageFlags dstStage,
+                                  VkAccessFlags dstAccess) {
+  VkBuffer srcBuffer;
+  VkDeviceSize srcOffset;
+  void *staging = allocateStaging(size, STAGING_ALIGNMENT, srcBuffer, srcOffset);
+  memcpy(staging, data, static_cast<size_t>(size));
+
+  VkBufferCopy copyRegion{};
+  copyRegion.srcOffset = srcOffset;
+  copyRegion.dstOffset = dstOffset;
+  copyRegion.size = size;
+  vkCmdCopyBuffer(currentBatch->transferCommandBuffer, srcBuffer, dst, 1,
+                  &copyRegion);
+
+  VkBufferMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.buffer = dst;
+  barrier.offset = dstOffset;
+  barrier.size = size;
+  addHandoff(&barrier, nullptr, dstStage, dstAccess);
+
+  uploadedBytes += size;
+}
+
+void VulkanUploader::uploadImage(VkImage image, VkFormat format,
+                                 uint32_t width, uint32_t height,
+                                 const void *data,
+                                 VkDeviceSize size, uint32_t mipLevels,
+                                 uint32_t uploadedLevels) {
+  VkBuffer srcBuffer;
+  VkDeviceSize srcOffset;
+  void *staging = allocateStaging(size, STAGING_ALIGNMENT, srcBuffer, srcOffset);
+  memcpy(staging, data, static_cast<size_t>(size));
+
+  VkImageMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = image;
+  barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  barrier.subresourceRange.baseMipLevel = 0;
+  barrier.subresourceRange.levelCount = mipLevels;
+  barrier.subresourceRange.baseArrayLayer = 0;
+  barrier.subresourceRange.layerCount = 1;
+
+  // Old contents are thrown away
+  barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barrier.srcAccessMask = 0;
+  barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  vkCmdPipelineBarrier(currentBatch->transferCommandBuffer,
+                       VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
+                       nullptr, 1, &barrier);
+
+  // Levels are packed one after another. Level sizes are whole blocks, so
+  // every level starts on a valid copy offset. Compressed copies may stop
+  // short of a block at the image's edges
+  std::vector<VkBufferImageCopy> regions(uploadedLevels);
+  VkDeviceSize levelOffset = srcOffset;
+  for (uint32_t level = 0; level < uploadedLevels; level++) {
+    uint32_t levelWidth = std::max(width >> level, 1u);
+    uint32_t levelHeight = std::max(height >> level, 1u);
+
+    VkBufferImageCopy &region = regions[level];
+    region.bufferOffset = levelOffset;
+    region.bufferRowLength = 0;
+    region.bufferImageHeight = 0;
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = level;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = 1;
+    region.imageOffset = {0, 0, 0};
+    region.imageExtent = {levelWidth, levelHeight, 1};
+
+    levelOffset += Utils::textureLevelSize(format, levelWidth, levelHeight);
+  }
+  vkCmdCopyBufferToImage(currentBatch->transferCommandBuffer, srcBuffer, image,
+                         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                         static_cast<uint32_t>(regions.size()),
+                         regions.data());
+
+  barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  addHandoff(nullptr, &barrier, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+             VK_ACCESS_SHADER_READ_BIT);
+
+  uploadedBytes += size;
+}
+} // namespace VulkanStuff